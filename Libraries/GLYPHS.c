@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////
+////                             GLYPHS.C                               ////
+////          Custom LCD characters cached in the HD44780 CGRAM         ////
+////                                                                    ////
+////  glyph_init()  Must be called after lcd_init().                    ////
+////                                                                    ////
+////  glyph(id)     Returns the character code (0 - 7) that displays    ////
+////                the glyph id, uploading it if it is not loaded.     ////
+////                                                                    ////
+////  glyph_bar(x,y,from,to)  Grows a horizontal bar drawn at x,y from  ////
+////                the length from to the length to, in fifths of a    ////
+////                character. Only the characters that change are      ////
+////                written.                                            ////
+////                                                                    ////
+////  An upload moves the LCD address counter to the CGRAM, so get the  ////
+////  codes before calling lcd_gotoxy(). Write the codes with           ////
+////  lcd_putc(); printf() stops at code 0. Needs HD44780.c.            ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// The controller has 8 CGRAM characters and there are more glyphs, so
+// the slots are kept in least recently used order. A glyph already in a
+// slot costs nothing, otherwise the least recently used slot is
+// replaced, costing 9 bytes on the LCD bus. glyph_uploads counts them.
+
+// Available glyphs
+enum Glyphs{
+   GlyphBar1,        // Bars of 1 to 4 columns, 255 is the full one
+   GlyphBar2,
+   GlyphBar3,
+   GlyphBar4,
+   GlyphArrowLeft,
+   GlyphArrowRight,
+   GlyphArrowUp,
+   GlyphArrowDown,
+   GlyphCursor,      // Underline
+   GlyphBell,
+   GLYPHS
+};
+
+#define GLYPH_SLOTS  8
+#define GLYPH_NONE   0xFF
+#define GLYPH_FULL   255    // Full block of the character ROM
+
+// Rows of every glyph, top first
+const BYTE glyph_rows[GLYPHS][8] = {
+   { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },
+   { 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00 },
+   { 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x00 },
+   { 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x00 },
+   { 0x00, 0x04, 0x08, 0x1F, 0x08, 0x04, 0x00, 0x00 },
+   { 0x00, 0x04, 0x02, 0x1F, 0x02, 0x04, 0x00, 0x00 },
+   { 0x04, 0x0E, 0x15, 0x04, 0x04, 0x04, 0x00, 0x00 },
+   { 0x04, 0x04, 0x04, 0x15, 0x0E, 0x04, 0x00, 0x00 },
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F },
+   { 0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00 }
+};
+
+// Global Variables
+BYTE glyph_loaded[GLYPH_SLOTS];   // Glyph in every slot
+BYTE glyph_order[GLYPH_SLOTS];    // Slots, most recently used first
+unsigned int16 glyph_uploads = 0;
+
+// Forgets every slot, their contents are unknown after lcd_init()
+void glyph_init( void ) {
+   for(BYTE i=0; i<GLYPH_SLOTS; i++) {
+      glyph_loaded[i] = GLYPH_NONE;
+      glyph_order[i] = i;
+   }
+}
+
+// Returns the code of the glyph, loading it in the least recent slot
+BYTE glyph(BYTE id) {
+   BYTE i, slot;
+
+   // Position of the glyph in the order, the last one if not loaded
+   for(i=0; i<GLYPH_SLOTS-1; i++) {
+      if(glyph_loaded[glyph_order[i]] == id) {
+         break;
+      }
+   }
+   slot = glyph_order[i];
+
+   if(glyph_loaded[slot] != id) {
+      lcd_command(LCD_CGRAM | (slot << 3));
+      for(BYTE row=0; row<8; row++) {
+         lcd_data(glyph_rows[id][row]);
+      }
+      glyph_loaded[slot] = id;
+      glyph_uploads++;
+   }
+
+   // Now the most recently used
+   for(; i>0; i--) {
+      glyph_order[i] = glyph_order[i-1];
+   }
+   glyph_order[0] = slot;
+
+   return slot;
+}
+
+// Grows a bar from 'from' to 'to' fifths, only redrawing the changed cells
+void glyph_bar(BYTE x, BYTE y, BYTE from, BYTE to) {
+   BYTE cell, fill, code;
+
+   for(cell=from/5; cell*5 < to; cell++) {
+      fill = to - cell*5;
+      if(fill >= 5) {
+         code = GLYPH_FULL;
+      } else {
+         code = glyph(GlyphBar1 + fill - 1);
+      }
+      lcd_gotoxy(x + cell,y);
+      lcd_putc(code);
+   }
+}
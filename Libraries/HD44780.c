@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////
+////                            HD44780.C                               ////
+////          HD44780 LCD driver waiting on the busy flag               ////
+////                                                                    ////
+////  lcd_init()    Must be called before any other function.           ////
+////                                                                    ////
+////  lcd_putc(c)   Will display c on the next position of the LCD.     ////
+////                The following have special meaning:                 ////
+////                     \f  Clear display                              ////
+////                     \n  Go to start of next line                   ////
+////                     \b  Move back one position                     ////
+////                                                                    ////
+////  lcd_gotoxy(x,y)  Set write position on LCD (upper left is 1,1)    ////
+////                                                                    ////
+////  lcd_getc(x,y)    Returns character at position x,y on LCD         ////
+////                                                                    ////
+////  lcd_command(c)   Sends an instruction byte to the controller      ////
+////                                                                    ////
+////  lcd_data(c)      Writes c to the RAM at the address counter,      ////
+////                   without the special characters of lcd_putc()     ////
+////                                                                    ////
+////  lcd_marquee(text)  Writes up to two lines of text, each in a      ////
+////                   whole 40 character line of the display RAM.      ////
+////                   Returns the length of the longest line.          ////
+////                                                                    ////
+////  lcd_scroll()     Scrolls the marquee one character to the left    ////
+////                                                                    ////
+////  Drop-in replacement of LCD420.c and LCD.c. Instead of waiting     ////
+////  the worst case time of every instruction, the driver reads the    ////
+////  busy flag and writes as soon as the controller is ready.          ////
+////                                                                    ////
+////  Define LCD_QUEUED to queue the writes instead, lcd_drain() must   ////
+////  then be called from a timer interrupt to send them. lcd_getc() is ////
+////  not available in this mode. Writes to a full queue are dropped    ////
+////  and counted in lcd_dropped, LCD_QUEUE (default 64) must hold the  ////
+////  longest burst the program writes.                                 ////
+////                                                                    ////
+////  Pins are those of LCD420.c, on port B unless LCD_USE_PORTD is     ////
+////  defined (those of LCD.c):                                         ////
+////        B0  enable       B4  D4                                     ////
+////        B1  rs           B5  D5                                     ////
+////        B2  rw           B6  D6                                     ////
+////                         B7  D7                                     ////
+////  LCD pins D0-D3 are not used. LCD_LINES and LCD_WIDTH (default 4   ////
+////  and 20) set the size of the display.                              ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// The busy flag is read as D7 of the first nibble of a status read.
+// Every wait is bounded by LCD_BUSY_POLLS reads, so a missing display
+// slows the program down instead of hanging it. A read takes at least the
+// 2 us of its enable pulses, so the bound covers the 1.52 ms of a clear or
+// home even when the code itself takes no time.
+//
+// A marquee is written once and then moved by the display shift
+// instruction, so every step costs one byte instead of a rewrite. The
+// shift moves every line and wraps around the 40 characters of the line
+// RAM; lcd_putc('\f') clears it. On 4 line displays lines 3 and 4 are
+// the second half of lines 1 and 2, so the marquee goes through both.
+//
+// In queued mode lcd_putc() and lcd_gotoxy() only store the bytes with
+// their RS value, and never wait: the main code must not hang on a
+// queue only the interrupt empties. Each lcd_drain() reads the busy flag
+// once per byte and sends up to LCD_DRAIN bytes while it is clear, so
+// the interrupt never polls. A byte usually keeps the controller busy
+// past the next read, so count on a byte per call: on the 10 ms tick,
+// 100 bytes per second and a full 4x20 screen in about a second.
+
+#ifdef LCD_USE_PORTD
+#define LCD_E      PIN_D0
+#define LCD_RS     PIN_D1
+#define LCD_RW     PIN_D2
+#byte lcd_port   = getenv("SFR:PORTD")
+#byte lcd_lat    = getenv("SFR:LATD")
+#byte lcd_tris   = getenv("SFR:TRISD")
+#else
+#define LCD_E      PIN_B0
+#define LCD_RS     PIN_B1
+#define LCD_RW     PIN_B2
+#byte lcd_port   = getenv("SFR:PORTB")
+#byte lcd_lat    = getenv("SFR:LATB")
+#byte lcd_tris   = getenv("SFR:TRISB")
+#endif
+
+#ifndef LCD_LINES
+#define LCD_LINES  4
+#endif
+
+#ifndef LCD_WIDTH
+#define LCD_WIDTH  20
+#endif
+
+#define LCD_ROW    40           // Characters in a line of the display RAM
+
+#define LCD_BUSY_POLLS  1000    // Busy flag reads before giving up
+#define LCD_BUSY        0x80
+
+// Instructions
+#define LCD_CLEAR       0x01
+#define LCD_HOME        0x02    // Also undoes the display shift
+#define LCD_ENTRY       0x06    // Increment, no shift
+#define LCD_DISPLAY_ON  0x0C    // Display on, cursor off
+#define LCD_SHIFT_LEFT  0x10    // Cursor moves left
+#define LCD_SCROLL_LEFT 0x18    // Display shifts left
+#define LCD_FUNCTION    0x28    // 4 bit interface, 2 lines, 5x8
+#define LCD_CGRAM       0x40
+#define LCD_DDRAM       0x80
+
+// DDRAM address of the first character of every line
+const BYTE lcd_line_address[4] = { 0x00, 0x40, 0x14, 0x54 };
+
+// Global Variables
+BYTE lcd_line = 1;      // Line of the write position
+
+#ifdef LCD_QUEUED
+#ifndef LCD_QUEUE
+#define LCD_QUEUE  64   // Queued bytes (power of 2)
+#endif
+#define LCD_DRAIN  16   // Most bytes sent by lcd_drain()
+
+BYTE lcd_queue[LCD_QUEUE];
+int1 lcd_queue_rs[LCD_QUEUE];
+BYTE lcd_head = 0;      // Written by lcd_putc()
+BYTE lcd_tail = 0;      // Read by lcd_drain()
+unsigned int16 lcd_dropped = 0;   // Bytes written to a full queue
+#endif
+
+// Writes a nibble on D4-D7 and pulses enable
+void lcd_send_nibble(BYTE n) {
+   lcd_lat = (lcd_lat & 0x0F) | (n << 4);
+   delay_cycles(1);
+   output_high(LCD_E);
+   delay_us(1);
+   output_low(LCD_E);
+}
+
+// Reads a byte, status if rs is 0 and data otherwise
+BYTE lcd_read_byte(int1 rs) {
+   BYTE high, low;
+
+   lcd_tris |= 0xF0;
+   output_bit(LCD_RS,rs);
+   output_high(LCD_RW);
+   delay_cycles(1);
+
+   output_high(LCD_E);
+   delay_us(1);
+   high = lcd_port & 0xF0;
+   output_low(LCD_E);
+   delay_cycles(1);
+   output_high(LCD_E);
+   delay_us(1);
+   low = lcd_port >> 4;
+   output_low(LCD_E);
+
+   output_low(LCD_RW);
+   lcd_tris &= 0x0F;
+   return high | low;
+}
+
+// Waits until the controller is ready, returns false if it stays busy
+int1 lcd_ready(int16 polls) {
+   while(polls-- != 0) {
+      if(!(lcd_read_byte(0) & LCD_BUSY)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+// Sends a byte once the controller is ready, an instruction if rs is 0
+void lcd_send_byte(int1 rs, BYTE n) {
+   lcd_ready(LCD_BUSY_POLLS);
+   output_bit(LCD_RS,rs);
+   lcd_send_nibble(n >> 4);
+   lcd_send_nibble(n & 0x0F);
+}
+
+#ifdef LCD_QUEUED
+
+// Queues a byte, drops it when the queue is full
+void lcd_write(int1 rs, BYTE n) {
+   BYTE next = (lcd_head + 1) & (LCD_QUEUE - 1);
+
+   if(next == lcd_tail) {
+      lcd_dropped++;
+      return;
+   }
+
+   lcd_queue[lcd_head] = n;
+   lcd_queue_rs[lcd_head] = rs;
+   lcd_head = next;
+}
+
+// Sends queued bytes while the controller is ready, call it from an ISR.
+// A single busy flag read per byte, the rest waits for the next call.
+void lcd_drain( void ) {
+   for(BYTE i=0; i<LCD_DRAIN && lcd_tail != lcd_head; i++) {
+      if(lcd_read_byte(0) & LCD_BUSY) {
+         return;
+      }
+      output_bit(LCD_RS,lcd_queue_rs[lcd_tail]);
+      lcd_send_nibble(lcd_queue[lcd_tail] >> 4);
+      lcd_send_nibble(lcd_queue[lcd_tail] & 0x0F);
+      lcd_tail = (lcd_tail + 1) & (LCD_QUEUE - 1);
+   }
+}
+
+#else
+#define lcd_write(rs,n)  lcd_send_byte(rs,n)
+#endif
+
+// Sends an instruction byte
+void lcd_command(BYTE c) {
+   lcd_write(0,c);
+}
+
+// Writes a byte to the display or character generator RAM
+void lcd_data(BYTE c) {
+   lcd_write(1,c);
+}
+
+// Initializes the controller in 4 bit mode
+void lcd_init( void ) {
+
+   output_low(LCD_E);
+   output_low(LCD_RS);
+   output_low(LCD_RW);
+   lcd_tris &= 0x0F;
+
+   // The busy flag can not be read until the interface is set
+   delay_ms(15);
+   for(BYTE i=0; i<3; i++) {
+      lcd_send_nibble(0x03);
+      delay_ms(5);
+   }
+   lcd_send_nibble(0x02);
+   delay_us(100);
+
+   lcd_send_byte(0,LCD_FUNCTION);
+   lcd_send_byte(0,LCD_DISPLAY_ON);
+   lcd_send_byte(0,LCD_CLEAR);
+   lcd_send_byte(0,LCD_ENTRY);
+   lcd_line = 1;
+}
+
+// Sets the write position (upper left is 1,1)
+void lcd_gotoxy(BYTE x, BYTE y) {
+   if(y < 1 || y > LCD_LINES) {
+      y = 1;
+   }
+   lcd_line = y;
+   lcd_write(0,LCD_DDRAM | (lcd_line_address[y - 1] + x - 1));
+}
+
+// Displays a character on the next position
+void lcd_putc(char c) {
+   switch(c) {
+      case '\f':
+         lcd_write(0,LCD_CLEAR);
+         lcd_line = 1;
+         break;
+      case '\n':
+         lcd_gotoxy(1,++lcd_line);
+         break;
+      case '\b':
+         lcd_write(0,LCD_SHIFT_LEFT);
+         break;
+      default:
+         lcd_write(1,c);
+         break;
+   }
+}
+
+// Writes the lines of text, padded to the whole line RAM, and puts the
+// display back in place. Returns the length of the longest line.
+BYTE lcd_marquee(char *text) {
+   BYTE longest = 0;
+   BYTE length;
+
+   lcd_write(0,LCD_HOME);
+
+   for(BYTE y=1; y<=2 && y<=LCD_LINES; y++) {
+      lcd_gotoxy(1,y);
+      for(length=0; *text != '\0' && *text != '\n'; text++) {
+         if(length < LCD_ROW) {
+            lcd_write(1,*text);
+            length++;
+         }
+      }
+      if(length > longest) {
+         longest = length;
+      }
+      for(BYTE i=length; i<LCD_ROW; i++) {
+         lcd_write(1,' ');
+      }
+      if(*text == '\n') {
+         text++;
+      }
+   }
+   return longest;
+}
+
+// Moves the marquee one character to the left
+void lcd_scroll( void ) {
+   lcd_write(0,LCD_SCROLL_LEFT);
+}
+
+#ifndef LCD_QUEUED
+
+// Returns the character at x,y
+char lcd_getc(BYTE x, BYTE y) {
+   lcd_gotoxy(x,y);
+   lcd_ready(LCD_BUSY_POLLS);
+   return lcd_read_byte(1);
+}
+
+#endif
@@ -15,6 +15,27 @@
 ////                                                                    ////
 ////  kp_def_tag(c)   Defines returned character when # is pressed      ////
 ////                                                                    ////
+////  kp_scan_raw()   Returns the index (row*4 + col) of the key down   ////
+////                  or NOKEYPRESS, without any edge detection         ////
+////                                                                    ////
+////  Define KP_ISR before including this driver to scan the keypad     ////
+////  from the Timer 2 interrupt instead of polling from kp_getc and    ////
+////  kp_getn. One row is scanned every millisecond, every key is       ////
+////  debounced and the presses and releases are queued as events,      ////
+////  so no key is lost while the main code is busy. kp_init() enables  ////
+////  INT_TIMER2, the main code enables GLOBAL when it is ready.        ////
+////                                                                    ////
+////  kp_get_event(event) Returns true and the oldest event if any      ////
+////                      (only with KP_ISR)                            ////
+////                                                                    ////
+////  kp_repeat_num(n,enable)  Enables/disables hold to repeat for the  ////
+////  kp_repeat_char(c,enable) key returning number n or character c.   ////
+////                           Repeats come out as new presses, slow    ////
+////                           at first and then faster and larger      ////
+////                           (only with KP_ISR)                       ////
+////                                                                    ////
+////  kp_step()   Magnitude (1, 10 or 100) of the last returned press   ////
+////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
 // As defined in the following structure the pin connection is as follows:
@@ -30,6 +51,12 @@
 
 #define NOKEYPRESS 255  // Standard assignation to key when not pressed
 
+// Profiling probes are empty unless PROFILE.c was included before
+#ifndef PROF_START
+#define PROF_START(probe)
+#define PROF_STOP(probe)
+#endif
+
 struct kp_pin_map {     // This structure is overlayed on to a I/O P
    int col : 4;         // to gain access to the keypad pins.
    int row : 4;         // The bits are allocated from lower to upper
@@ -42,9 +69,23 @@ struct kp_pin_map {     // This structure is overlayed on to a I/O P
 // Columns are inputs
 // Rows are outputs
 struct kp_pin_map const KP_READ = {0b1111,0b0000}; 
+
+// Rows are driven through the latch to avoid read-modify-write on PORTD
+#byte KP_LATD = getenv("SFR:LATD")
+
+// Port D value that drives a single row low (ROW1 is D7)
+const int8 kp_rows[4] = { 0x7F, 0xBF, 0xDF, 0xEF };
+
+// Column nibble to column index, NOKEYPRESS unless exactly one is low
+const int8 kp_cols[16] = {
+   NOKEYPRESS, NOKEYPRESS, NOKEYPRESS, NOKEYPRESS,
+   NOKEYPRESS, NOKEYPRESS, NOKEYPRESS, 0,
+   NOKEYPRESS, NOKEYPRESS, NOKEYPRESS, 1,
+   NOKEYPRESS, 2,          3,          NOKEYPRESS
+};
                              
 // Global Variables
-int8 saved_key = NOKEYPRESS;      //The saved key pressed in char
+int8 saved_key = NOKEYPRESS;      //The saved key index (row*4 + col)
 
 // Char Keys found on keypad
 char charkeys[16] = {
@@ -62,69 +103,259 @@ int8 numkeys[16] = {
    0xF,0x0,0xE,0xD
 };
 
-// Set port D for keypad configuration
-void kp_init( void ) {
-   set_tris_d(KP_READ);
-}
-
-char kp_getc( int1 keydown = true ) {
+// Scans the four rows reading each column nibble only once
+int8 kp_scan_raw( void ) {
    
    // Default assignment to keypad
    int8 key = NOKEYPRESS;
+   int8 col;
    
-   // Check all rows from keypad
    for(int8 row = 0; row < 4; row++){
+      KP_LATD = kp_rows[row];
+      delay_cycles(1);            // Let the column inputs settle
       
-      // Keypad assignment is done by shifting the 0 right 'row' times
-      kp.row = 0b11110111 >> row;
+      // Later rows win, as in the original nested scan
+      col = kp_cols[kp.col];
+      if(col != NOKEYPRESS) {
+         key = (row << 2) + col;
+      }
+   }
+   
+   return key;
+}
+
+#ifdef KP_ISR
+
+/*******      Interrupt driven scanner      *******/
+
+#define KP_DEBOUNCE 5   // Scans (4 ms each) a key must be stable
+#define KP_EVENTS   8   // Event FIFO size, must be a power of two
+
+// Timer 2 period for one row every millisecond (prescaler 16, postscaler 4)
+#define KP_TIMER_PR (getenv("CLOCK")/256000 - 1)
+
+// Hold to repeat timing (milliseconds), may be defined before including
+#ifndef KP_REPEAT_DELAY
+#define KP_REPEAT_DELAY 500   // Hold time before the first repeat
+#define KP_REPEAT_SLOW  200   // Repeat period of the first stage
+#define KP_REPEAT_FAST  60    // Repeat period of the next stages
+#define KP_REPEAT_STAGE 10    // Repeats before moving to the next stage
+#endif
+
+// Magnitude reported on each repeat stage
+const int8 kp_stage_step[4] = { 1, 1, 10, 100 };
+
+// Keypad Event Structure
+typedef struct kp_event{
+   int8  key;        // Key index (row*4 + col)
+   int1  pressed;    // true when pressed or repeated, false when released
+   int8  step;       // 1 on a press, 1/10/100 on an accelerated repeat
+   int16 time;       // Milliseconds tick when it was debounced
+} KpEvent;
+
+// Event FIFO, single producer (ISR) and single consumer (main code)
+KpEvent kp_fifo[KP_EVENTS];
+int8 kp_head = 0;                // Only written by the ISR
+int8 kp_tail = 0;                // Only written by the main code
+
+// Scanner state
+int8  kp_integrator[16] = {0};   // Debounce integrator of every key
+int16 kp_pressed = 0;            // Debounced state of every key
+int16 kp_ticks = 0;              // Milliseconds since kp_init
+int8  kp_row = 0;                // Row being driven
+
+// Hold to repeat state
+int16 kp_repeat = 0;             // Keys allowed to repeat
+int8  kp_rep_key = NOKEYPRESS;   // Key being held
+int16 kp_rep_timer = 0;          // Milliseconds to the next repeat
+int8  kp_rep_left = 0;           // Repeats left in the current stage
+int8  kp_rep_stage = 0;          // Current acceleration stage
+int8  kp_last_step = 1;          // Step of the last returned press
+
+// Queues an event, drops it if the FIFO is full
+void kp_push( int8 key, int1 pressed, int8 step ) {
+   int8 next = (kp_head + 1) & (KP_EVENTS - 1);
+   
+   if(next != kp_tail) {
+      kp_fifo[kp_head].key = key;
+      kp_fifo[kp_head].pressed = pressed;
+      kp_fifo[kp_head].step = step;
+      kp_fifo[kp_head].time = kp_ticks;
       
-      // Check all columns in each row
-      for(int8 col = 0; col < 4; col++){
+      // Publish the event only once it is complete
+      kp_head = next;
+   }
+}
+
+// Scans one row every tick
+#int_timer2
+void kp_scan( void )
+{
+   int8 cols;
+   int8 key;
+   
+   kp_ticks++;
+   
+   // Repeat the held key when its period elapses
+   if(kp_rep_key != NOKEYPRESS && --kp_rep_timer == 0) {
+      kp_push(kp_rep_key, true, kp_stage_step[kp_rep_stage]);
+      kp_rep_timer = (kp_rep_stage == 0) ? KP_REPEAT_SLOW : KP_REPEAT_FAST;
       
-         // If both zeros overlap save char found in that key
-         if( kp.col == (0b11110111 >> col) ){
-            key = charkeys[row*4 + col];
+      // Accelerate after a number of repeats
+      if(--kp_rep_left == 0) {
+         kp_rep_left = KP_REPEAT_STAGE;
+         if(kp_rep_stage < 3) {
+            kp_rep_stage++;
          }
       }
    }
    
-   // Return key when new key is pressed and keydown is true
-   if(keydown && saved_key != key){
-      saved_key = key;
-      return key;
+   // Columns of the row driven on the previous tick (already settled)
+   cols = kp.col;
+   
+   for(int8 col = 0; col < 4; col++) {
+      key = (kp_row << 2) + col;
+      
+      // Column is low when the key is down
+      if( !bit_test(cols, 3-col) ) {
+         if(kp_integrator[key] < KP_DEBOUNCE) {
+            kp_integrator[key]++;
+         }
+      } else if(kp_integrator[key] > 0) {
+         kp_integrator[key]--;
+      }
+      
+      // Accept the change only when the integrator saturates
+      if(kp_integrator[key] == KP_DEBOUNCE && !bit_test(kp_pressed, key)) {
+         bit_set(kp_pressed, key);
+         kp_push(key, true, 1);
+         
+         // Start repeating when allowed for this key
+         if(bit_test(kp_repeat, key)) {
+            kp_rep_key = key;
+            kp_rep_timer = KP_REPEAT_DELAY;
+            kp_rep_left = KP_REPEAT_STAGE;
+            kp_rep_stage = 0;
+         }
+      } else if(kp_integrator[key] == 0 && bit_test(kp_pressed, key)) {
+         bit_clear(kp_pressed, key);
+         kp_push(key, false, 0);
+         
+         // Stop repeating when the held key is released
+         if(key == kp_rep_key) {
+            kp_rep_key = NOKEYPRESS;
+         }
+      }
    }
-   // Return key when released and keydown is false
-   else if(key == NOKEYPRESS){
-      key = saved_key;
-      saved_key = NOKEYPRESS;
-      return key;
+   
+   // Drive next row
+   kp_row = (kp_row + 1) & 3;
+   KP_LATD = kp_rows[kp_row];
+}
+
+// Set port D for keypad configuration and start the scanner
+void kp_init( void ) {
+   set_tris_d(KP_READ);
+   KP_LATD = kp_rows[0];
+   setup_timer_2( T2_DIV_BY_16, KP_TIMER_PR, 4 );
+   enable_interrupts( INT_TIMER2 );
+}
+
+// Returns true and the oldest event when there is one
+int1 kp_get_event( KpEvent &event ) {
+   if(kp_tail == kp_head) {
+      return false;
    }
-   // Save key and return nothing when pressed and keydown is false
-   saved_key = key;
-   return NOKEYPRESS;
+   event = kp_fifo[kp_tail];
    
+   // Free the slot only after it was copied
+   kp_tail = (kp_tail + 1) & (KP_EVENTS - 1);
+   return true;
 }
 
-int8 kp_getn( int1 keydown = true ) {
+// Returns the index of the next press (keydown) or release event
+int8 kp_get_key( int1 keydown ) {
+   KpEvent event;
    
-   // Default assignment to keypad
-   int8 key = NOKEYPRESS;
+   while(kp_get_event(event)) {
+      if(event.pressed == keydown) {
+         kp_last_step = event.step;
+         return event.key;
+      }
+   }
+   return NOKEYPRESS;
+}
+
+// Magnitude of the last returned press
+int8 kp_step( void ) {
+   return kp_last_step;
+}
+
+// Enables or disables hold to repeat for a key index
+void kp_repeat_key( int8 key, int1 enable ) {
    
-   // Check all rows from keypad
-   for(int8 row = 0; row < 4; row++){
-      
-      // Keypad assignment is done by shifting the 0 right 'row' times
-      kp.row = 0b11110111 >> row;
-      
-      // Check all columns in each row
-      for(int8 col = 0; col < 4; col++){
-      
-         // If both zeros overlap save num found in that key
-         if( kp.col == (0b11110111 >> col) ){
-            key = numkeys[row*4 + col];
-         }
+   // The scanner reads these while they are changed
+   disable_interrupts( INT_TIMER2 );
+   if(enable) {
+      bit_set(kp_repeat, key);
+   } else {
+      bit_clear(kp_repeat, key);
+      if(kp_rep_key == key) {
+         kp_rep_key = NOKEYPRESS;
       }
    }
+   enable_interrupts( INT_TIMER2 );
+}
+
+// Enables or disables hold to repeat for the key returning number n
+void kp_repeat_num( int8 n, int1 enable ) {
+   for(int8 key = 0; key < 16; key++) {
+      if(numkeys[key] == n) {
+         kp_repeat_key(key, enable);
+      }
+   }
+}
+
+// Enables or disables hold to repeat for the key returning character c
+void kp_repeat_char( char c, int1 enable ) {
+   for(int8 key = 0; key < 16; key++) {
+      if(charkeys[key] == c) {
+         kp_repeat_key(key, enable);
+      }
+   }
+}
+
+char kp_getc( int1 keydown = true ) {
+   int8 key = kp_get_key(keydown);
+   return (key == NOKEYPRESS) ? NOKEYPRESS : charkeys[key];
+}
+
+int8 kp_getn( int1 keydown = true ) {
+   int8 key;
+   
+   PROF_START(ProbeKeypad);
+   key = kp_get_key(keydown);
+   PROF_STOP(ProbeKeypad);
+   
+   return (key == NOKEYPRESS) ? NOKEYPRESS : numkeys[key];
+}
+
+#else
+
+/*******           Polled scanner           *******/
+
+// Hold to repeat needs the interrupt scanner, every press is one step
+#define kp_repeat_num(n,enable)
+#define kp_repeat_char(c,enable)
+#define kp_step() 1
+
+// Set port D for keypad configuration
+void kp_init( void ) {
+   set_tris_d(KP_READ);
+}
+
+// Applies the pressed/released edge detection to a scanned key
+int8 kp_edge( int8 key, int1 keydown ) {
    
    // Return key when new key is pressed and keydown is true
    if(keydown && saved_key != key){
@@ -143,6 +374,23 @@ int8 kp_getn( int1 keydown = true ) {
    
 }
 
+char kp_getc( int1 keydown = true ) {
+   int8 key = kp_edge(kp_scan_raw(), keydown);
+   return (key == NOKEYPRESS) ? NOKEYPRESS : charkeys[key];
+}
+
+int8 kp_getn( int1 keydown = true ) {
+   int8 key;
+   
+   PROF_START(ProbeKeypad);
+   key = kp_edge(kp_scan_raw(), keydown);
+   PROF_STOP(ProbeKeypad);
+   
+   return (key == NOKEYPRESS) ? NOKEYPRESS : numkeys[key];
+}
+
+#endif
+
 void kp_def_ast( char c ) {
    charkeys[12] = c;
 }
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////
+////                            PROFILE.C                               ////
+////            Cycle count profiling probes using Timer 3              ////
+////                                                                    ////
+////  prof_init()   Must be called before any other function.           ////
+////                Starts Timer 3 free running.                        ////
+////                                                                    ////
+////  PROF_START(probe)   Marks the beginning of a measured section     ////
+////                                                                    ////
+////  PROF_STOP(probe)    Adds the ticks since PROF_START to the probe  ////
+////                                                                    ////
+////  prof_reset()  Clears the count, min, max and total of all probes  ////
+////                                                                    ////
+////  prof_dump()   Streams the probe table through RS232               ////
+////                                                                    ////
+////  The probes only exist when PROFILE is defined before including    ////
+////  this library, otherwise every macro compiles to nothing.          ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// Timer 3 counts one tick every PROF_PRESCALE instruction cycles, so a
+// single probe can measure up to 65535 ticks (419 ms at 5 MHz).
+//
+// The slaves answer DumpProfile. The RS232 of a master is its link to the
+// slave, so a master sends its table behind the MasterProfile command and
+// the slave reads it and drops it (see PROF_PROBE_BYTES). It is read on
+// the master TX line, by a serial adapter listening on it or the host
+// harness.
+//
+// ProbeLinkWait times the waits for a byte of the link, from the call of
+// getc() until the byte is there, so it also counts the 1 ms the byte
+// takes at 9600 baud. Longer waits than a probe can hold are not seen:
+// the slaves only call getc() once kbhit() says a command is there.
+//
+// prof_dump() output format (multi-byte values least significant first):
+//     PROF_PROBES      1 byte
+//     PROF_PRESCALE    1 byte
+//     For every probe:
+//        count         2 bytes
+//        min           2 bytes (ticks)
+//        max           2 bytes (ticks)
+//        total         4 bytes (ticks)
+//
+
+/*******            ENUMS             *******/
+// Available probes
+enum ProfileProbes{
+   ProbeKeypad,
+   ProbeReadProduct,
+   ProbeSendProduct,
+   ProbeReceiveProduct,
+   ProbeLcd,
+   ProbeIsrTick,
+   ProbeLinkWait,
+   PROF_PROBES
+};
+
+// Bytes of a probe in the prof_dump() table
+#define PROF_PROBE_BYTES  10
+
+#ifdef PROFILE
+
+#define PROF_PRESCALE 8
+
+// Probe Structure
+typedef struct probe{
+   unsigned int16 start;   // Timer 3 value at PROF_START
+   unsigned int16 count;   // Measured sections
+   unsigned int16 min;     // Shortest section (ticks)
+   unsigned int16 max;     // Longest section (ticks)
+   unsigned int32 total;   // Sum of all sections (ticks)
+} Probe;
+
+// Global Variables
+Probe probes[PROF_PROBES];
+
+#define PROF_START(probe)  probes[probe].start = get_timer3()
+#define PROF_STOP(probe)   prof_end(probe)
+
+// Clears every probe
+void prof_reset( void ) {
+   for(int8 i=0; i<PROF_PROBES; i++) {
+      probes[i].count = 0;
+      probes[i].min = 0xFFFF;
+      probes[i].max = 0;
+      probes[i].total = 0;
+   }
+}
+
+// Global interrupt enable, restored after copying a probe
+#bit prof_gie = getenv("BIT:GIE")
+
+// Start Timer 3 free running
+void prof_init( void ) {
+   prof_reset();
+   setup_timer_3( T3_INTERNAL | T3_DIV_BY_8 );
+}
+
+// Accumulates the ticks elapsed since the start of the probe
+// Inlined so the probes can be used both in the ISRs and the main code
+#inline
+void prof_end( int8 probe ) {
+
+   // Unsigned difference is correct across a single timer overflow
+   unsigned int16 ticks = get_timer3() - probes[probe].start;
+
+   probes[probe].count++;
+   probes[probe].total += ticks;
+   if(ticks < probes[probe].min) {
+      probes[probe].min = ticks;
+   }
+   if(ticks > probes[probe].max) {
+      probes[probe].max = ticks;
+   }
+}
+
+// Streams the probe table through RS232
+void prof_dump( void ) {
+   Probe copy;
+   int1 gie;
+
+   putc(PROF_PROBES);
+   putc(PROF_PRESCALE);
+
+   for(int8 i=0; i<PROF_PROBES; i++) {
+
+      // Probes used in an ISR change while they are sent, copy them whole
+      gie = prof_gie;
+      disable_interrupts( GLOBAL );
+      copy = probes[i];
+      if(gie) {
+         enable_interrupts( GLOBAL );
+      }
+
+      putc(make8(copy.count,0)); putc(make8(copy.count,1));
+      putc(make8(copy.min,0));   putc(make8(copy.min,1));
+      putc(make8(copy.max,0));   putc(make8(copy.max,1));
+      for(int8 b=0; b<4; b++) {
+         putc(make8(copy.total,b));
+      }
+   }
+}
+
+#else
+
+#define PROF_START(probe)
+#define PROF_STOP(probe)
+#define prof_init()
+#define prof_reset()
+#define prof_dump()
+
+#endif
@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////
+////                            SETTINGS.C                              ////
+////         Key/value settings store in the DS1307 battery RAM         ////
+////                                                                    ////
+////  settings_load()   Must be called before any other function.       ////
+////                    Returns false when the RAM lost its contents,   ////
+////                    leaving an empty store. A save cut short by a   ////
+////                    power loss is kept.                             ////
+////                                                                    ////
+////  settings_get(key,data,len)  Copies the value of key to data.      ////
+////                    Returns false if there is no value of len bytes ////
+////                                                                    ////
+////  settings_set(key,data,len)  Saves len bytes of data as key.       ////
+////                    Returns false if the store is full.             ////
+////                                                                    ////
+////  settings_get8(key,var) / settings_set8(key,var)                   ////
+////  settings_get16(key,var) / settings_set16(key,var)                 ////
+////  settings_get32(key,var) / settings_set32(key,var)                 ////
+////                    Same for int8, int16 and int32 variables        ////
+////                                                                    ////
+////  Keys are defined by the main program (0 - 0xFE). Needs DS1307.C.  ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// A copy of the whole store is kept in RAM, so reads never touch the
+// I2C bus and writes only send the bytes that changed plus the header.
+//
+// Store layout (RTC_NVRAM_SIZE bytes):
+//     checksum         1 byte, sum of the records area
+//     SETTINGS_MAGIC   1 byte, SETTINGS_DIRTY while a save is in progress
+//     records          key, len, len bytes of value ...
+//     SETTINGS_END     key of the first free byte
+//
+
+#define SETTINGS_MAGIC  0x5A
+#define SETTINGS_DIRTY  0xA5
+#define SETTINGS_END    0xFF
+#define SETTINGS_NONE   0xFF
+#define SETTINGS_FIRST  2       // First record
+
+#define settings_get8(key,var)    settings_get(key,(BYTE*)&var,1)
+#define settings_set8(key,var)    settings_set(key,(BYTE*)&var,1)
+#define settings_get16(key,var)   settings_get(key,(BYTE*)&var,2)
+#define settings_set16(key,var)   settings_set(key,(BYTE*)&var,2)
+#define settings_get32(key,var)   settings_get(key,(BYTE*)&var,4)
+#define settings_set32(key,var)   settings_set(key,(BYTE*)&var,4)
+
+// Global Variables
+BYTE settings[RTC_NVRAM_SIZE];
+
+// Sum of the records area
+BYTE settings_checksum( void ) {
+   BYTE sum = 0;
+
+   for(BYTE i=SETTINGS_FIRST; i<RTC_NVRAM_SIZE; i++) {
+      sum += settings[i];
+   }
+   return sum;
+}
+
+// Writes the checksum and then the magic, which marks the store valid
+void settings_seal( void ) {
+   settings[0] = settings_checksum();
+   settings[1] = SETTINGS_MAGIC;
+   rtc_write_nvram(0,settings,SETTINGS_FIRST);
+}
+
+// Writes the bytes from first to last to the RAM. The store is marked
+// dirty while they are written, so a save cut short is told apart from
+// a RAM that lost its contents.
+void settings_save(BYTE first, BYTE last) {
+   BYTE dirty = SETTINGS_DIRTY;
+
+   rtc_write_nvram(1,&dirty,1);
+   rtc_write_nvram(first,&settings[first],last - first + 1);
+   settings_seal();
+}
+
+// True when the records follow each other up to the end of the store
+int1 settings_chained( void ) {
+   int16 at = SETTINGS_FIRST;
+
+   while(at < RTC_NVRAM_SIZE && settings[at] != SETTINGS_END) {
+      if(at == RTC_NVRAM_SIZE - 1) {
+         return false;        // A key without its length
+      }
+      at += settings[at + 1] + 2;
+   }
+   return at <= RTC_NVRAM_SIZE;
+}
+
+// Returns the position of the record of key or SETTINGS_NONE
+// With SETTINGS_END returns the first free byte
+BYTE settings_find(BYTE key) {
+   BYTE at = SETTINGS_FIRST;
+
+   while(at < RTC_NVRAM_SIZE) {
+      if(settings[at] == key) {
+         return at;
+      }
+      if(settings[at] == SETTINGS_END) {
+         break;
+      }
+      at += settings[at + 1] + 2;
+   }
+   return SETTINGS_NONE;
+}
+
+// Reads the store, formats it when the contents are not valid
+int1 settings_load( void ) {
+
+   rtc_read_nvram(0,settings,RTC_NVRAM_SIZE);
+
+   if(settings[1] == SETTINGS_MAGIC && settings[0] == settings_checksum()) {
+      return true;
+   }
+
+   // A save was cut short, its records hold old and new values
+   if(settings[1] == SETTINGS_DIRTY && settings_chained()) {
+      settings_seal();
+      return true;
+   }
+
+   // Empty store
+   memset(settings,SETTINGS_END,RTC_NVRAM_SIZE);
+   settings_save(SETTINGS_FIRST,RTC_NVRAM_SIZE - 1);
+   return false;
+}
+
+// Copies the value of key, returns false if there is none of len bytes
+int1 settings_get(BYTE key, BYTE *data, BYTE len) {
+   BYTE at = settings_find(key);
+
+   if(at == SETTINGS_NONE || settings[at + 1] != len) {
+      return false;
+   }
+   memcpy(data,&settings[at + 2],len);
+   return true;
+}
+
+// Saves the value of key, returns false if the store is full
+int1 settings_set(BYTE key, BYTE *data, BYTE len) {
+   BYTE at = settings_find(key);
+   BYTE next;
+   BYTE first = SETTINGS_NONE;
+   BYTE last = 0;
+   BYTE i;
+
+   // A value of another size is removed, following records move back
+   if(at != SETTINGS_NONE && settings[at + 1] != len) {
+      next = at + settings[at + 1] + 2;
+      for(i=at; next<RTC_NVRAM_SIZE; i++, next++) {
+         settings[i] = settings[next];
+      }
+      memset(&settings[i],SETTINGS_END,RTC_NVRAM_SIZE - i);
+      first = at;
+      last = RTC_NVRAM_SIZE - 1;
+      at = SETTINGS_NONE;
+   }
+
+   // New records go to the first free byte
+   if(at == SETTINGS_NONE) {
+      at = settings_find(SETTINGS_END);
+      if(at == SETTINGS_NONE || at + len + 2 > RTC_NVRAM_SIZE) {
+         if(first != SETTINGS_NONE) {
+            settings_save(first,last);
+         }
+         return false;
+      }
+      settings[at] = key;
+      settings[at + 1] = len;
+      if(at < first) {
+         first = at;
+      }
+      if(at + 1 > last) {
+         last = at + 1;
+      }
+   }
+
+   // Only the bytes that changed are written
+   for(i=0; i<len; i++) {
+      if(settings[at + 2 + i] != data[i]) {
+         settings[at + 2 + i] = data[i];
+         if(at + 2 + i < first) {
+            first = at + 2 + i;
+         }
+         if(at + 2 + i > last) {
+            last = at + 2 + i;
+         }
+      }
+   }
+
+   if(first != SETTINGS_NONE) {
+      settings_save(first,last);
+   }
+   return true;
+}
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////
+////                              TICK.C                                ////
+////           Centisecond tick with cascaded time counters             ////
+////                                                                    ////
+////  tick_init()   Must be called before any other function.           ////
+////                Starts Timer 1 with a 10 ms interrupt.              ////
+////                                                                    ////
+////  tick_cs       Centiseconds (0 - 99)                               ////
+////  tick_sec      Seconds units (0 - 9)                               ////
+////  tick_sec10    Seconds tens (0 - 5)                                ////
+////  tick_min      Minutes (0 - 59)                                    ////
+////                                                                    ////
+////  Every counter is only incremented when the one below it wraps,    ////
+////  so the tick never divides. Define any of these hooks before       ////
+////  including the library to run code from the interrupt after the    ////
+////  counters are updated, in this order:                              ////
+////        TICK_ON_CS()        every 10 ms                             ////
+////        TICK_ON_SECOND()    every second                            ////
+////        TICK_ON_TEN()       every 10 seconds                        ////
+////        TICK_ON_MINUTE()    every minute                            ////
+////                                                                    ////
+////  TICK_INT is the interrupt of the tick and TICK_CYCLES the         ////
+////  instruction cycles in a tick. Timer 1 and CCP1 are used.          ////
+////                                                                    ////
+////  Define TICK_TIMER0 to run the tick on Timer 0 instead, reloaded   ////
+////  by the interrupt, when Timer 1 or CCP1 are needed elsewhere.      ////
+////                                                                    ////
+////  Define TICK_DRIFT to measure the tick against a 1 Hz reference,   ////
+////  such as the DS1307 square wave, on the CCP2 pin:                  ////
+////        tick_drift_ppm()    Frequency error of the tick (ppm),      ////
+////                            positive when the tick runs fast        ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// CCP1 compares Timer 1 with the tick period and its special event
+// trigger resets the timer in hardware. The timer is never reloaded by
+// code, so interrupt latency does not add up as drift and every tick
+// lasts exactly TICK_PERIOD timer counts.
+//
+// The prescaler is the smallest one that fits the period in 16 bits.
+// A clock that does not give a whole number of counts in 10 ms stops
+// the compilation instead of running slow.
+//
+// With TICK_TIMER0 the interrupt moves Timer 0 back a period, so the
+// counts it ran since the overflow are kept and latency does not add
+// up either. Only the cycles of the reload itself are lost, and with a
+// prescaler also the counts it held, as writing the timer clears it.
+
+#if getenv("CLOCK")/4/100 <= 65536
+#define TICK_DIV     1
+#define TICK_T1_DIV  T1_DIV_BY_1
+#define TICK_T0_DIV  T0_DIV_1
+#elif getenv("CLOCK")/4/2/100 <= 65536
+#define TICK_DIV     2
+#define TICK_T1_DIV  T1_DIV_BY_2
+#define TICK_T0_DIV  T0_DIV_2
+#elif getenv("CLOCK")/4/4/100 <= 65536
+#define TICK_DIV     4
+#define TICK_T1_DIV  T1_DIV_BY_4
+#define TICK_T0_DIV  T0_DIV_4
+#else
+#define TICK_DIV     8
+#define TICK_T1_DIV  T1_DIV_BY_8
+#define TICK_T0_DIV  T0_DIV_8
+#endif
+
+#if (getenv("CLOCK")/4/TICK_DIV) % 100 != 0
+#error The clock does not give an exact 10 ms tick
+#endif
+
+#define TICK_PERIOD  (getenv("CLOCK")/4/TICK_DIV/100)   // Timer counts
+#define TICK_CYCLES  (getenv("CLOCK")/4/100)            // Instruction cycles
+
+#ifdef TICK_TIMER0
+#define TICK_INT     INT_TIMER0
+#else
+#define TICK_INT     INT_CCP1
+#endif
+
+#if defined(TICK_TIMER0) && defined(TICK_DRIFT)
+#error TICK_DRIFT needs the tick on Timer 1
+#endif
+
+#ifndef TICK_ON_CS
+#define TICK_ON_CS()
+#endif
+
+#ifndef TICK_ON_SECOND
+#define TICK_ON_SECOND()
+#endif
+
+#ifndef TICK_ON_TEN
+#define TICK_ON_TEN()
+#endif
+
+#ifndef TICK_ON_MINUTE
+#define TICK_ON_MINUTE()
+#endif
+
+// Global Variables
+unsigned int8 tick_cs = 0;
+unsigned int8 tick_sec = 0;
+unsigned int8 tick_sec10 = 0;
+unsigned int8 tick_min = 0;
+
+#ifdef TICK_DRIFT
+unsigned int16 tick_count = 0;     // Free running ticks
+unsigned int16 tick_ref_ticks;     // Tick of the last reference edge
+unsigned int16 tick_ref_timer;     // Timer 1 at the last reference edge
+signed int32   tick_drift = 0;     // Timer 1 counts ahead of the reference
+unsigned int16 tick_drift_secs = 0;   // Reference seconds measured
+int1           tick_ref_seen = false;  // A reference edge was captured
+#endif
+
+// Tick interrupt, carries every counter into the next one
+#ifdef TICK_TIMER0
+#int_timer0
+#else
+#int_ccp1
+#endif
+void tick_isr( void )
+{
+#ifdef TICK_TIMER0
+   // Back a period from where it is now, 16 bit arithmetic wraps it
+   set_timer0( get_timer0() - TICK_PERIOD );
+#endif
+
+#ifdef TICK_DRIFT
+   tick_count++;
+#endif
+
+   if(++tick_cs == 100) {
+      tick_cs = 0;
+      if(++tick_sec == 10) {
+         tick_sec = 0;
+         if(++tick_sec10 == 6) {
+            tick_sec10 = 0;
+            if(++tick_min == 60) {
+               tick_min = 0;
+            }
+         }
+      }
+   }
+
+   // Hooks run once every counter is up to date
+   TICK_ON_CS();
+   if(tick_cs == 0) {
+      TICK_ON_SECOND();
+      if(tick_sec == 0) {
+         TICK_ON_TEN();
+         if(tick_sec10 == 0) {
+            TICK_ON_MINUTE();
+         }
+      }
+   }
+}
+
+#ifdef TICK_DRIFT
+
+// CCP2 captured Timer 1 on a reference edge, adds the error of the second
+#int_ccp2
+void tick_reference( void )
+{
+   unsigned int16 timer = CCP_2;
+   unsigned int16 ticks = tick_count;
+   signed int32 counts;
+
+   // Timer 1 was reset after the capture and the tick already counted it
+   if(timer > get_timer1() && !interrupt_active(TICK_INT)) {
+      ticks--;
+   }
+
+   // Timer 1 counts between both edges, against a second of ticks
+   if(tick_ref_seen) {
+      counts = (signed int32)(unsigned int16)(ticks - tick_ref_ticks) * TICK_PERIOD;
+      counts += (signed int32)timer - tick_ref_timer;
+      tick_drift += counts - (signed int32)TICK_PERIOD * 100;
+      tick_drift_secs++;
+   }
+
+   tick_ref_seen = true;
+   tick_ref_ticks = ticks;
+   tick_ref_timer = timer;
+}
+
+// Frequency error of the tick since tick_init() in ppm
+signed int32 tick_drift_ppm( void ) {
+   signed int32 drift;
+   signed int32 secs;
+
+   disable_interrupts( INT_CCP2 );
+   drift = tick_drift;
+   secs = tick_drift_secs;
+   enable_interrupts( INT_CCP2 );
+
+   if(secs == 0) {
+      return 0;
+   }
+
+   // Counts per second first, drift * 10000 overflows after a few hours
+   return (drift / secs * 10000 + drift % secs * 10000 / secs) / TICK_PERIOD;
+}
+
+#endif
+
+// Start Timer 1, reset by CCP1 every tick, or Timer 0
+void tick_init( void ) {
+#ifdef TICK_TIMER0
+   setup_timer_0( T0_INTERNAL | TICK_T0_DIV );
+   set_timer0( 0 - TICK_PERIOD );  // Overflows after a period
+#else
+   setup_timer_1( T1_INTERNAL | TICK_T1_DIV );
+   CCP_1 = TICK_PERIOD - 1;        // Timer 1 counts 0 to CCP_1
+   setup_ccp1( CCP_COMPARE_RESET_TIMER );
+   set_timer1( 0 );
+#endif
+   enable_interrupts( TICK_INT );
+
+#ifdef TICK_DRIFT
+   setup_ccp2( CCP_CAPTURE_FE );
+   enable_interrupts( INT_CCP2 );
+#endif
+
+   enable_interrupts( GLOBAL );
+}
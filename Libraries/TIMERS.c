@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////
+////                             TIMERS.C                               ////
+////            Software timers in a hashed timer wheel                 ////
+////                                                                    ////
+////  timer_init()   Must be called before any other function.          ////
+////                                                                    ////
+////  timer_start(id,ticks,period)  Starts a timer that expires after   ////
+////                 ticks (1 - 65535) and then every period ticks, or  ////
+////                 only once if period is 0. Restarts a running one.  ////
+////                                                                    ////
+////  timer_stop(id)     Stops a timer and clears its expired flag      ////
+////                                                                    ////
+////  timer_expired(id)  Returns true once per expiry of the timer      ////
+////                                                                    ////
+////  timer_running(id)  Returns true until a one shot timer expires    ////
+////                                                                    ////
+////  timer_tick()   Call it from the tick interrupt                    ////
+////                                                                    ////
+////  Timers can be started before interrupts are enabled, the global   ////
+////  interrupt enable is left as it was found.                         ////
+////                                                                    ////
+////  The main program may define TIMER_COUNT (timers) and TIMER_SLOTS  ////
+////  (slots of the wheel, a power of 2) before including the library.  ////
+////  Timers are identified by their index in the pool, an int8 up to   ////
+////  254 timers and an int16 above. Slots above 256 take int16 too.    ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// Every running timer hangs from the wheel slot of the tick it expires
+// on, modulo TIMER_SLOTS, and counts the turns of the wheel left before
+// that. A tick only walks the list of one slot, so starting, stopping
+// and expiring a timer never depend on how many timers are running.
+//
+// Expiries are reported with a flag read by timer_expired(), so the
+// work of a timer runs in the main loop instead of the interrupt. A
+// periodic timer that expires again before its flag is read only
+// reports one expiry.
+
+#ifndef TIMER_COUNT
+#define TIMER_COUNT    8
+#endif
+
+#ifndef TIMER_SLOTS
+#define TIMER_SLOTS    8
+#endif
+
+#define TIMER_MASK     (TIMER_SLOTS - 1)
+
+// Smallest types that hold a timer id, TIMER_NONE included, and a slot
+#if TIMER_COUNT > 254
+typedef unsigned int16 TimerId;
+#define TIMER_NONE     0xFFFF
+#else
+typedef unsigned int8 TimerId;
+#define TIMER_NONE     0xFF
+#endif
+
+#if TIMER_SLOTS > 256
+typedef unsigned int16 TimerSlot;
+#else
+typedef unsigned int8 TimerSlot;
+#endif
+
+// Timer flags
+#define TIMER_RUNNING  0x01
+#define TIMER_FIRED    0x02
+
+// Timer Structure
+typedef struct softtimer{
+   unsigned int16 rounds;   // Turns of the wheel left before it expires
+   unsigned int16 period;   // Ticks between expiries, 0 if one shot
+   TimerSlot slot;          // Wheel slot it hangs from
+   TimerId next;            // Timers of the same slot
+   TimerId prev;
+   unsigned int8 flags;
+} SoftTimer;
+
+// Global interrupt enable, restored after changing a timer
+#bit timer_gie = getenv("BIT:GIE")
+
+// Global Variables
+SoftTimer timer_pool[TIMER_COUNT];
+TimerId timer_wheel[TIMER_SLOTS];         // First timer of every slot
+TimerSlot timer_now = 0;                  // Slot of the current tick
+
+// Hangs a timer from the slot it expires on after ticks
+#inline
+void timer_link(TimerId id, unsigned int16 ticks) {
+   TimerSlot slot = (timer_now + ticks) & TIMER_MASK;
+
+   timer_pool[id].rounds = (ticks - 1) / TIMER_SLOTS;
+   timer_pool[id].slot = slot;
+   timer_pool[id].prev = TIMER_NONE;
+   timer_pool[id].next = timer_wheel[slot];
+   if(timer_wheel[slot] != TIMER_NONE) {
+      timer_pool[timer_wheel[slot]].prev = id;
+   }
+   timer_wheel[slot] = id;
+}
+
+// Takes a timer out of its slot
+#inline
+void timer_unlink(TimerId id) {
+   TimerId next = timer_pool[id].next;
+   TimerId prev = timer_pool[id].prev;
+
+   if(prev == TIMER_NONE) {
+      timer_wheel[timer_pool[id].slot] = next;
+   } else {
+      timer_pool[prev].next = next;
+   }
+   if(next != TIMER_NONE) {
+      timer_pool[next].prev = prev;
+   }
+}
+
+// Empties the wheel and stops every timer
+void timer_init( void ) {
+   // TIMER_NONE has every bit set, whatever its size
+   memset(timer_wheel,0xFF,sizeof(timer_wheel));
+   for(TimerId i=0; i<TIMER_COUNT; i++) {
+      timer_pool[i].flags = 0;
+   }
+   timer_now = 0;
+}
+
+// Starts or restarts a timer
+void timer_start(TimerId id, unsigned int16 ticks, unsigned int16 period) {
+   int1 gie = timer_gie;
+
+   if(ticks == 0) {
+      ticks = 1;
+   }
+
+   disable_interrupts( GLOBAL );
+   if(timer_pool[id].flags & TIMER_RUNNING) {
+      timer_unlink(id);
+   }
+   timer_pool[id].period = period;
+   timer_pool[id].flags = TIMER_RUNNING;
+   timer_link(id,ticks);
+   if(gie) {
+      enable_interrupts( GLOBAL );
+   }
+}
+
+// Stops a timer, a pending expiry is forgotten
+void timer_stop(TimerId id) {
+   int1 gie = timer_gie;
+
+   disable_interrupts( GLOBAL );
+   if(timer_pool[id].flags & TIMER_RUNNING) {
+      timer_unlink(id);
+   }
+   timer_pool[id].flags = 0;
+   if(gie) {
+      enable_interrupts( GLOBAL );
+   }
+}
+
+// Returns true if the timer expired since the last call
+int1 timer_expired(TimerId id) {
+   int1 fired = false;
+   int1 gie = timer_gie;
+
+   disable_interrupts( GLOBAL );
+   if(timer_pool[id].flags & TIMER_FIRED) {
+      timer_pool[id].flags &= ~TIMER_FIRED;
+      fired = true;
+   }
+   if(gie) {
+      enable_interrupts( GLOBAL );
+   }
+   return fired;
+}
+
+// Returns true while the timer is waiting to expire
+int1 timer_running(TimerId id) {
+   return (timer_pool[id].flags & TIMER_RUNNING) != 0;
+}
+
+// Advances the wheel one slot, expiring the timers due now
+void timer_tick( void ) {
+   TimerId id;
+   TimerId next;
+
+   timer_now = (timer_now + 1) & TIMER_MASK;
+
+   for(id=timer_wheel[timer_now]; id!=TIMER_NONE; id=next) {
+      next = timer_pool[id].next;
+
+      // Due in a later turn of the wheel
+      if(timer_pool[id].rounds != 0) {
+         timer_pool[id].rounds--;
+         continue;
+      }
+
+      timer_pool[id].flags |= TIMER_FIRED;
+
+      // A periodic timer is due again a period from now
+      if(timer_pool[id].period == 0) {
+         timer_unlink(id);
+         timer_pool[id].flags &= ~TIMER_RUNNING;
+      } else if((timer_pool[id].period & TIMER_MASK) == 0) {
+         timer_pool[id].rounds = (timer_pool[id].period - 1) / TIMER_SLOTS;
+      } else {
+         timer_unlink(id);
+         timer_link(id,timer_pool[id].period);
+      }
+   }
+}
@@ -20,39 +20,47 @@
 #include <../POS_COMMUNICATION.c>
 
 /*******  Include Peripherical Libraries  *******/
-#include <LCD420.c>
+#include <../../Libraries/HD44780.c>
 
 /*******  Include Custom Libraries  *******/
+#define KP_ISR    // Debounced keypad with hold to repeat
 #include <../../Libraries/KP4X4.c>
 #include <../../Libraries/RGBLED.c>
+#include <../../Libraries/GLYPHS.c>
+
+// Software timers on the 10 ms tick
+enum PosTimers{
+   TimerRender       // Screen renders
+};
+#define TIMER_COUNT  1
+
+// 10 ms tick that runs the timers and makes data blink
+void pos_tick( void );
+#define TICK_ON_CS()  pos_tick()
+#include <../../Libraries/TIMERS.c>
+#include <../../Libraries/TICK.c>
+
+#define RENDER_TICKS 5   // Ticks between screen renders
+#define SYNC_BAR     20  // Characters of the catalog download progress bar
 
 /*******  Global Variables  *******/
-int1 render = false;
 int1 blink = false;
-unsigned int8 rendercont = 0;
 
-/*******  Timer0 interrupt function  *******/
-// Renders screen
-#int_timer0
-void rendering( void )
-{
-   rendercont++;
-   if(rendercont > 3){
-      rendercont = 0;
-      render = true;
-   }
-   set_timer0( 200 );
-   clear_interrupt( INT_TIMER0 );
-}
+/*******  Catalog Snapshot  *******/
+// Up to CATALOG_SIZE products, as many as the slave holds
+Product catalog[CATALOG_SIZE];    // Copy of the slave products
+unsigned int8 catalog_num = 0;    // Number of products in the copy
+unsigned int8 catalog_gen = 0;    // Slave generation of the copy
+int1 catalog_valid = false;       // False until a download succeeds
 
-/*******  Timer0 interrupt function  *******/
-// Makes adjusting data blink
-#int_timer1
-void cursor_blink( void )
+/*******  Tick function  *******/
+// Runs the render timer and makes adjusting data blink, every tick
+void pos_tick( void )
 {
-   blink = (blink + 1) % 2;
-   set_timer1( 220 );
-   clear_interrupt( INT_TIMER1 );
+   PROF_START(ProbeIsrTick);
+   timer_tick();
+   blink = tick_cs >= 50;
+   PROF_STOP(ProbeIsrTick);
 }
 
 /*******          FUNCTIONS          *******/
@@ -63,47 +71,61 @@ int1  save_Product( Product prod );
 int16 selectProducts( void );
 int1  payProducts( int16 );
 void  printProd( Product prod );
+void  sync_Catalog( void );
+void  catalog_Add( Product prod );
+#ifdef LINK_STATS
+void  printLinkStats( void );
+#endif
 
 /*******          MAIN CODE          *******/
 void main( void )
 {
    // Local Variable Declaration
    unsigned int8 key = 0;
+   unsigned int8 arrow;
    unsigned int8 position = 0;
    unsigned int16 total = 0;
    Product prod; 
    
    //Peripherical Initialization
    lcd_init();
+   glyph_init();
    kp_init();
+   prof_init();
    
-   //Timer configuration
-   enable_interrupts ( GLOBAL );
-   enable_interrupts ( INT_TIMER0 );
-   enable_interrupts ( INT_TIMER1 );
-   setup_timer_0( T0_INTERNAL | T0_DIV_256 | T0_8_BIT);
-   setup_timer_1( T1_INTERNAL | T1_DIV_BY_8 );
+   // Holding 'A' or 'B' keeps increasing or decreasing the values
+   kp_repeat_num(0x0A, true);
+   kp_repeat_num(0x0B, true);
+   
+   //Timers and tick configuration
+   timer_init();
+   timer_start(TimerRender,RENDER_TICKS,RENDER_TICKS);
+   tick_init();
    
    //Empty serial buffer
    while(kbhit())
       getc();   
    
+   // Download the product catalog from the slave
+   sync_Catalog();
+   
    // Endless Loop
    for(;;) {
    
-      // Only display messages when render is true    
-      if(render) {
+      // Only display messages when it is time to render
+      if(timer_expired(TimerRender)) {
+         PROF_START(ProbeLcd);
+         
          // Display Menu selection 
          printf(lcd_putc,"\f Electro-FruitStore\n");
          printf(lcd_putc,"1. New Product\n");
          printf(lcd_putc,"2. Purchase Mode");
          
          // Add Arrow to current option
-         lcd_gotoxy(18,position+2);
-         printf(lcd_putc,"<-");
-         
-         // Reset renderization
-         render = false;
+         arrow = glyph(GlyphArrowLeft);
+         lcd_gotoxy(19,position+2);
+         lcd_putc(arrow);
+         PROF_STOP(ProbeLcd);
       }
       
       // Get key from key pad
@@ -142,8 +164,9 @@ void main( void )
                   
                   // Save product into database if validation was successful
                   case Valid:
-                     putc(SaveProd);
+                     send_command(SaveProd);
                      if(send_Product(prod)){
+                        catalog_Add(prod);
                         printf(lcd_putc,"Successful Save");
                      } else {
                         printf(lcd_putc,"The Save Failed");
@@ -153,6 +176,7 @@ void main( void )
                   case InvalidPrice:   printf(lcd_putc,"Invalid  Price"); break;
                   case InvalidSKU:     printf(lcd_putc," Existing SKU "); break;
                   case InvalidName:    printf(lcd_putc,"Existing  Name"); break;
+                  case CatalogFull:    printf(lcd_putc," Catalog Full "); break;
                   default :            printf(lcd_putc," Check Failed "); break;
                }
             }
@@ -182,13 +206,29 @@ void main( void )
             }
             
             // Display Come Back Soon in other screen 
-            putc(PrintMessage);
-            printf("Come Back Soon%c%c",0,13);
+            send_command(PrintMessage);
+            printf(link_putc,"Come Back Soon%c%c",0,13);
             
             // Clear screen after 2 seconds
             delay_ms(2000);
-            putc(ClearScreen);
+            send_command(ClearScreen);
             break;
+            
+#ifdef LINK_STATS
+         // Display link statistics for 2 seconds
+         case 0x0C: 
+            printLinkStats();
+            delay_ms(2000);
+            break;
+#endif
+
+#ifdef PROFILE
+         // Stream the probe table on the link, the slave drops it
+         case 0x00: 
+            send_command(MasterProfile);
+            prof_dump();
+            break;
+#endif
       }
       
    }
@@ -201,13 +241,14 @@ Product createNewProduct() {
    //Variable declaration
    unsigned int8 key = 0;
    unsigned int16 letter = 'A';
+   unsigned int8 cursor;
    unsigned int8 position = 0;
    unsigned int8 attribute = 1;
    Product prod;
    
-   // Ask database for total products
-   putc(ProdNum);
-   key = getc();
+   // Total products from the catalog snapshot
+   sync_Catalog();
+   key = catalog_num;
    
    // Clear Screen
    lcd_putc('\f');
@@ -386,14 +427,14 @@ Product createNewProduct() {
                // If no key press do nothing
                case NOKEYPRESS: break;
                
-               // If 'A' is pressed increase price
+               // If 'A' is pressed increase price (faster when held)
                case 0x0A: 
-                  prod.price = (prod.price + 1) % 10000; 
+                  prod.price = (prod.price + kp_step()) % 10000; 
                   break;
                   
-               // If 'B' is pressed decrease price
+               // If 'B' is pressed decrease price (faster when held)
                case 0x0B: 
-                  prod.price = (prod.price + 9999) % 10000; 
+                  prod.price = (prod.price + 10000 - kp_step()) % 10000; 
                   break;
                   
                // If 'C' is pressed clear price and go to previous attribute
@@ -414,8 +455,8 @@ Product createNewProduct() {
             break;
       }
       
-      // Render only when true
-      if(render) {
+      // Render only when it is time
+      if(timer_expired(TimerRender)) {
       
          // Print current product on display
          printProd(prod);
@@ -431,8 +472,9 @@ Product createNewProduct() {
                   
                // Makes Name blink 
                case 1: 
+                  cursor = glyph(GlyphCursor);
                   lcd_gotoxy(9+position,2); 
-                  printf(lcd_putc,"%c",255); 
+                  lcd_putc(cursor); 
                   break;
                   
                // Makes Price blink
@@ -445,9 +487,6 @@ Product createNewProduct() {
                default: attribute = 0;
             }
          }
-         
-         // Resets render to false
-         render = false;
       }
    }
 }
@@ -458,46 +497,32 @@ int8 check_Product( Product prod ) {
 
    // Local Variable Declaration
    int8 numprod;
-   int8 max;
-   Product comp;
    
-   // Get number of products in database
-   putc(ProdNum);
-   max = getc();
+   // Make sure the catalog snapshot is up to date
+   sync_Catalog();
    
    // If the price is 0 return 
    if(prod.price == 0){
          return InvalidPrice;
    }
+   
+   // The slave refuses products past its last record
+   if(catalog_num >= CATALOG_SIZE) {
+      return CatalogFull;
+   }
     
    // Check with every product from database
-   for(numprod = 0; numprod<max; numprod++) {
-      
-      // Set Communication interval to 100 ms
-      delay_ms(10);
-      
-      // Get Product from database
-      putc(SendProd);
-      putc(numprod);
-      receive_Product(comp);
+   for(numprod = 0; numprod<catalog_num; numprod++) {
       
       // Compare SKU
-      if(strcmp(prod.sku,comp.sku) == 0) {
+      if(strcmp(prod.sku,catalog[numprod].sku) == 0) {
          return InvalidSKU;
       }
          
       // Compare Name
-      if(strcmp(prod.name,comp.name) == 0) {
+      if(strcmp(prod.name,catalog[numprod].name) == 0) {
          return InvalidName;
       }
-         
-      // Display Checking message to let user know device is working 
-      if( numprod % 50 == 0 ) {
-         lcd_putc('\f'); lcd_gotoxy(4,2);
-         printf(lcd_putc,"Checking ");
-      } else if ( numprod % 10 == 0 ) {
-         lcd_putc('.');
-      }
    }
    
    // Return valid if product is unique
@@ -515,9 +540,9 @@ int16 selectProducts() {
    int16 total = 0;
    Product product;
    
-   // Get number of products in database
-   putc(ProdNum);
-   prodnum = getc();
+   // Get number of products from the catalog snapshot
+   sync_Catalog();
+   prodnum = catalog_num;
    
    for(;;) {
    
@@ -553,8 +578,8 @@ int16 selectProducts() {
                total -=  product.price * prodquan;
                
                // Display subtraction message to client
-               putc(PrintMessage);
-               printf(" -%02u %s\n -$  %lu.00%c%c", prodquan,product.name,(product.price*prodquan),0,13);
+               send_command(PrintMessage);
+               printf(link_putc," -%02u %s\n -$  %lu.00%c%c", prodquan,product.name,(product.price*prodquan),0,13);
             }
             prodquan=0; 
             break;
@@ -566,8 +591,8 @@ int16 selectProducts() {
                total +=  product.price * prodquan;
                
                // Display addition message to client
-               putc(PrintMessage);
-               printf(" %02u %s\n $  %lu.00%c%c", prodquan,product.name, (product.price*prodquan),0,13);
+               send_command(PrintMessage);
+               printf(link_putc," %02u %s\n $  %lu.00%c%c", prodquan,product.name, (product.price*prodquan),0,13);
             }
             prodquan=0; 
             break;
@@ -584,16 +609,13 @@ int16 selectProducts() {
             }
       }
       
-      // Only display products when render is true
-      if(render) {
+      // Only display products when it is time to render
+      if(timer_expired(TimerRender)) {
       
-         // Get product from database when it has changed
+         // Get product from the catalog when it has changed
          if(prevnum != num) {
             prevnum = num;
-            delay_us(100);
-            putc(SendProd);
-            putc(num);
-            receive_Product(product);
+            product = catalog[num];
          }
          
          // DISPLAY SALE INFORMATION
@@ -601,7 +623,6 @@ int16 selectProducts() {
          printf(lcd_putc,"PRICE: $ %lu.00\n",product.price);
          printf(lcd_putc,"QUANTITY: %u\n",prodquan);
          printf(lcd_putc,"TOTAL:  $ %lu.00\n",total);
-         render = false;
       }
    }
 }
@@ -612,6 +633,7 @@ int1 payProducts( int16 total) {
    // Local Variable Declaration
    unsigned int8 key = 0;
    unsigned int16 paid = 0;
+   unsigned int8 step;     // Amount added or taken by A and B
    int16 change = null;
    
    // Endless Loop
@@ -626,11 +648,14 @@ int1 payProducts( int16 total) {
          // If nothing is pressed do nothing
          case NOKEYPRESS: break;
          
-         // If 'A' increase amount
-         case 0x0A: paid++; break;
+         // If 'A' increase amount (faster when held)
+         case 0x0A: paid += kp_step(); break;
          
-         // If 'B' decrease amount
-         case 0x0B: paid--; break;
+         // If 'B' decrease amount (faster when held), never below zero
+         case 0x0B: 
+            step = kp_step();
+            paid = (paid > step)? paid - step: 0;
+            break;
          
          // If 'C' clear amount
          case 0x0C: paid = 0; break;
@@ -653,22 +678,21 @@ int1 payProducts( int16 total) {
          
       }
       
-      // Only display message when render
-      if(render) {
+      // Only display message when it is time to render
+      if(timer_expired(TimerRender)) {
       
          // Set Client message
-         putc(PrintMessage);
+         send_command(PrintMessage);
          if(change==0){
-            printf("TOTAL: $ %lu.00\nPAY:   $ %lu.00%c%c",total,paid,0,13);
+            printf(link_putc,"TOTAL: $ %lu.00\nPAY:   $ %lu.00%c%c",total,paid,0,13);
          } else{
-            printf("PAY:  $ %lu.00\nCHNG: $ %lu.00%c%c",paid,change,0,13);
+            printf(link_putc,"PAY:  $ %lu.00\nCHNG: $ %lu.00%c%c",paid,change,0,13);
          }
          
          // Set Selller Message
          printf(lcd_putc,"\fTOTAL:  $ %lu.00\n",total);
          printf(lcd_putc,"PAY:   $ %lu.00\n",paid);
          printf(lcd_putc,"CHANGE: $ %ld.00\n",change);
-         render = false;
       }
    }
    
@@ -676,7 +700,95 @@ int1 payProducts( int16 total) {
 
 // DISPLAYS PRODUCT INFORMATION ON LCD
 void printProd(Product prod) {
+   PROF_START(ProbeLcd);
    printf(lcd_putc,"\fSKU:   %s\n",prod.sku);
    printf(lcd_putc,"NAME:  %s \n",prod.name);
    printf(lcd_putc,"PRICE: $ %04lu.00\n",prod.price);
+   PROF_STOP(ProbeLcd);
+}
+
+#ifdef LINK_STATS
+// DISPLAYS LINK AND SLAVE EEPROM COUNTERS ON LCD
+void printLinkStats( void ) {
+
+   // Local Variable Declaration
+   unsigned int32 slave_tx, slave_rx, reads, writes;
+   
+   // Ask slave for its counters
+   send_command(LinkStats);
+   slave_tx = receive_int32();
+   slave_rx = receive_int32();
+   reads = receive_int32();
+   writes = receive_int32();
+   
+   // tx,rx,trips of master and slave, and EEPROM cycles
+   printf(lcd_putc,"\fM %lu,%lu,%lu\n",link_stats.tx,link_stats.rx,link_stats.trips);
+   printf(lcd_putc,"S %lu,%lu\n",slave_tx,slave_rx);
+   printf(lcd_putc,"EE %lu,%lu",reads,writes);
+}
+#endif
+
+// DOWNLOADS THE CATALOG ONLY WHEN THE SLAVE GENERATION CHANGED
+void sync_Catalog( void ) {
+
+   // Local Variable Declaration
+   unsigned int8 gen;
+   unsigned int8 num;
+   unsigned int8 bar = 0;   // Progress bar length (fifths of a character)
+   unsigned int8 next;
+   
+   // Ask slave for its catalog generation
+   send_command(CatalogGen);
+   gen = link_getc();
+   
+   // The snapshot is still valid
+   if(catalog_valid && gen == catalog_gen) {
+      return;
+   }
+   
+   // Get number of products in database
+   send_command(ProdNum);
+   catalog_num = link_getc();
+   if(catalog_num > CATALOG_SIZE) {
+      catalog_num = CATALOG_SIZE;
+   }
+   
+   // Display Loading message to let user know device is working
+   lcd_putc('\f'); lcd_gotoxy(3,2);
+   printf(lcd_putc,"Loading Catalog");
+   
+   // Download every product
+   catalog_valid = true;
+   for(num = 0; num < catalog_num; num++) {
+   
+      // Set Communication interval to 10 ms
+      delay_ms(10);
+      
+      send_command(SendProd);
+      link_putc(num);
+      
+      // Retry on next sync if any product failed
+      if(!receive_Product(catalog[num])) {
+         catalog_valid = false;
+      }
+      
+      // Progress bar across the third line, only its end is redrawn
+      next = (int16)(num + 1) * (SYNC_BAR * 5) / catalog_num;
+      glyph_bar(1,3,bar,next);
+      bar = next;
+   }
+   catalog_gen = gen;
+}
+
+// ADDS A PRODUCT SAVED ON THE SLAVE TO THE SNAPSHOT
+// The slave increases its generation once per saved product, so the
+// snapshot stays valid without downloading it again
+void catalog_Add( Product prod ) {
+
+   if(catalog_num < CATALOG_SIZE) {
+      catalog[catalog_num++] = prod;
+      catalog_gen++;
+   } else {
+      catalog_valid = false;
+   }
 }
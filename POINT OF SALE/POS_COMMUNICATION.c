@@ -8,14 +8,28 @@
 ////  struct Product { sku, name, price }                               ////
 ////                                                                    ////
 ////  enum CommunicationComands { ProdNum, SendProd, ReceiveProd,       ////
-////           SaveProd, PrintMessage, ClearScreen }                    ////
+////           SaveProd, PrintMessage, ClearScreen, LinkStats,          ////
+////           DumpProfile, CatalogGen, MasterProfile }                 ////
+////                                                                    ////
+////  struct LinkStats { tx, rx, trips }   (only with LINK_STATS)       ////
 ////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 ////                             Functions                              ////
 ////                                                                    ////
 ////  int1 send_product(Product)    - Sends product to master/slave     ////
 ////                                                                    ////
-////  int1 receive_product(Product) - Receives product to master/slave  ////
+////  int1 receive_product(Product,accept) - Receives product to        ////
+////           master/slave, acknowledges false unless accept is true   ////
+////                                                                    ////
+////  void send_command(cmd)        - Starts a command round trip       ////
+////                                                                    ////
+////  void link_putc(c) / link_getc() - Counted putc/getc on the link   ////
+////  void link_gets(s,max)         - Counted gets, up to max bytes     ////
+////  void skip_profile()           - Drops a probe table of the master ////
+////                                                                    ////
+////  Define LINK_STATS to count the bytes moved on the link, the       ////
+////  command round trips and the slave's EEPROM cycles. The master     ////
+////  requests the slave counters with the LinkStats command.           ////
 ////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
@@ -24,7 +38,14 @@
 #use delay( clock = 5000000 )
 #use rs232( baud=9600 , xmit=pin_c6 , rcv=pin_c7 , parity=N , bits=8 , stop=1 )
 
+// Uncomment to count the traffic on the master/slave link
+//#define LINK_STATS
+
+// Uncomment to enable the cycle count probes (see PROFILE.c)
+//#define PROFILE
+
 #include <string.h>
+#include <../../Libraries/PROFILE.c>
 
 /*******        Common Structures          *******/
 
@@ -35,6 +56,10 @@ typedef struct product{
    int16 price;
 } Product;
 
+// Products the slave 24LC04B holds, 20 bytes each after the count and
+// below the catalog generation byte at 0x1FF
+#define CATALOG_SIZE 25
+
 /*******            ENUMS             *******/
 // Master - Slave Communication Commands
 enum CommunicationCommands{
@@ -43,7 +68,11 @@ enum CommunicationCommands{
    ReceiveProd,
    SaveProd,
    PrintMessage,
-   ClearScreen
+   ClearScreen,
+   LinkStats,
+   DumpProfile,
+   CatalogGen,
+   MasterProfile
 };
 
 
@@ -52,47 +81,157 @@ enum CheckCodes{
    Valid,
    InvalidSKU,
    InvalidName,
-   InvalidPrice
+   InvalidPrice,
+   CatalogFull
 };
 
+/*******         Link Statistics          *******/
+#ifdef LINK_STATS
+
+// Link Statistics Structure
+typedef struct linkstats{
+   unsigned int32 tx;      // Bytes sent through the link
+   unsigned int32 rx;      // Bytes received from the link
+   unsigned int32 trips;   // Commands started by this side
+} LinkStats;
+
+LinkStats link_stats = {0,0,0};
+
+#define link_tx(n)   link_stats.tx += (n)
+#define link_rx(n)   link_stats.rx += (n)
+#define link_trip()  link_stats.trips++
+
+// Sends a counter least significant byte first
+void send_int32(unsigned int32 value) {
+   for(int8 i=0; i<4; i++) {
+      putc(make8(value,i));
+      link_tx(1);
+   }
+}
+
+// Receives a counter least significant byte first
+unsigned int32 receive_int32( void ) {
+   int8 b0 = getc();
+   int8 b1 = getc();
+   int8 b2 = getc();
+   int8 b3 = getc();
+   link_rx(4);
+   return make32(b3,b2,b1,b0);
+}
+
+#else
+
+#define link_tx(n)
+#define link_rx(n)
+#define link_trip()
+
+#endif
+
 /*******          FUNCTIONS           *******/
 
+/*** Counted single byte transfers ***/
+void link_putc(char c) {
+   putc(c);
+   link_tx(1);
+}
+
+char link_getc( void ) {
+   char c;
+   
+   PROF_START(ProbeLinkWait);
+   c = getc();
+   PROF_STOP(ProbeLinkWait);
+   link_rx(1);
+   return c;
+}
+
+/*** Counted gets, reads up to the return (13) value ***/
+// Stores at most max bytes, zero terminated if there is room left
+void link_gets(char *s, int8 max) {
+
+   // Local Variable Declaration
+   char c;
+   int8 n = 0;
+   
+   while((c = link_getc()) != 13) {
+      if(n < max) {
+         s[n++] = c;
+      }
+   }
+   
+   if(n < max) {
+      s[n] = 0;
+   }
+}
+
+/*** Reads the prof_dump() table a master sends with MasterProfile ***/
+void skip_profile( void ) {
+
+   // Local Variable Declaration
+   int16 n = (int16)link_getc() * PROF_PROBE_BYTES + 1;
+   
+   // Prescaler, then every probe
+   while(n--) {
+      link_getc();
+   }
+}
+
+/*** Starts a command round trip with master/slave ***/
+void send_command(int8 cmd) {
+   link_putc(cmd);
+   link_trip();
+}
+
 /*** Send Product between master/slave ***/
 // Returns true if communication was successful
 int1 send_product(Product prod) {
 
+   // Local Variable Declaration
+   int1 done;
+   
+   PROF_START(ProbeSendProduct);
+   
    // Starts communication
-   getc();
+   link_getc();
    
    // Send Product values separated by zeros - end with return (13) value
-   printf("%s%c%s%c%c%c%c",prod.sku,0,prod.name,0,prod.price,(prod.price)>>8,13);
+   printf(link_putc,"%s%c%s%c%c%c%c",prod.sku,0,prod.name,0,prod.price,(prod.price)>>8,13);
    
    // End Communication
-   return getc();
+   done = link_getc();
+   PROF_STOP(ProbeSendProduct);
+   return done;
 }
 
 /*** Recieve Product between master/slave ***/
-// Returns true if communication was successful
-int1 receive_product(Product &prod) {
+// Returns true if communication was successful, a product that is not
+// accepted is read and acknowledged as failed
+int1 receive_product(Product &prod, int1 accept = true) {
 
+   PROF_START(ProbeReceiveProduct);
+   
    // Start Communication
-   putc(true);
+   link_putc(true);
    
-   // Receive Product values 
-   gets(prod.sku);
+   // Receive Product values, SKU and name are zero separated, then
+   // price and return (13) value
+   link_gets((char*)&prod,sizeof(Product));
    
    // Validate if product was received correctly
-   if( strlen(prod.sku)==6 && 
+   if( accept &&
+       strlen(prod.sku)==6 && 
        strlen(prod.name)==10 && 
        prod.price > 0 && 
        prod.price < 10000 ) 
    {
       // End Communication
-      putc(true);
+      link_putc(true);
+      PROF_STOP(ProbeReceiveProduct);
       return true;
    }
    
    // Communication was unsuccessful
-   putc(false);
+   link_putc(false);
+   PROF_STOP(ProbeReceiveProduct);
    return false;
 }
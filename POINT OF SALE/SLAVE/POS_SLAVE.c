@@ -8,6 +8,7 @@
 ////                                                                    ////
 ////  The board with this microcontroller also includes a LCD that      ////
 ////  displays product information and messages from the master.        ////
+////  Messages with lines longer than the 2x16 LCD scroll along it.     ////
 ////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
@@ -24,9 +25,31 @@
 #define EEPROM_SCL  PIN_B1
 
 /*******  Include Peripherical Libraries  *******/
-#include <LCD.c>
+#define LCD_USE_PORTD
+#define LCD_LINES  2
+#define LCD_WIDTH  16
+#include <../../Libraries/HD44780.c>
 #include <../../Libraries/2404.c>
 
+/*******  Include Custom Libraries  *******/
+// Software timers on the 10 ms tick, pacing the scrolling messages
+enum SlaveTimers{
+   TimerScroll       // Marquee steps
+};
+#define TIMER_COUNT  1
+#define TICK_ON_CS()  timer_tick()
+#include <../../Libraries/TIMERS.c>
+#include <../../Libraries/TICK.c>
+
+#define SCROLL_TICKS 25   // Ticks between marquee steps
+
+/*******      External EEPROM Layout       *******/
+// 0x000       Number of products
+// 0x001       Products, 20 bytes each (sku, name, price), CATALOG_SIZE
+//             of them so the last one ends before the generation byte
+// 0x1FF       Catalog generation, increases on every saved product
+#define CATALOG_GEN_ADDR 0x1FF
+
 /*******   Save Default Products in ROM    *******/
 #ROM int8 getenv("EEPROM_ADDRESS") = { 
    10, // Fist value stores number of items
@@ -43,6 +66,9 @@
 }
 
 
+/*******  Global Variables  *******/
+int1 marquee = false;     // A message is scrolling
+
 /*******          FUNCTIONS          *******/
 void load_products( void );
 Product read_Product( int8 num );
@@ -59,6 +85,10 @@ void main( void )
    // Peripherical Initialization
    lcd_init();
    init_ext_eeprom();
+   prof_init();
+   timer_init();
+   timer_start(TimerScroll,SCROLL_TICKS,SCROLL_TICKS);
+   tick_init();
    
    // Empty serial buffer
    while(kbhit()) {
@@ -76,49 +106,85 @@ void main( void )
    // Endless Loop
    for(;;) {
    
+      // Scroll a long message one character, a single LCD instruction
+      if(timer_expired(TimerScroll)) {
+         if(marquee) {
+            lcd_scroll();
+         }
+      }
+   
       // Received command from Master
       if(kbhit()) {
       
          // Command Processes
-         switch(getc()) {
+         switch(link_getc()) {
          
             // Return number of products to master
             case ProdNum: 
-               putc(read_ext_eeprom(0x00)); 
+               link_putc(read_ext_eeprom(0x00)); 
+               break;
+            
+            // Return the catalog generation to master
+            case CatalogGen: 
+               link_putc(read_ext_eeprom(CATALOG_GEN_ADDR)); 
                break;
             
             // Return the specified product to master
             case SendProd: 
-               prod = read_Product(getc());
+               prod = read_Product(link_getc());
                send_Product(prod);
                break;
                
             // Receive and display product on LCD
             case ReceiveProd: 
                if(receive_Product(prod)) {
+                  marquee = false;
                   print_product(prod);
                }
                break;
             
-            // Receive and save product on EEPROM
+            // Receive and save product on EEPROM, refused when full
             case SaveProd: 
-               if(receive_Product(prod)){
+               if(receive_Product(prod,read_ext_eeprom(0x00) < CATALOG_SIZE)){
                   save_Product(prod);
+                  marquee = false;
                   print_product(prod);
                }
                break;
                
-            // Print specified message on LCD
+            // Print specified message on LCD, scrolling if it does not fit
             case PrintMessage: 
-               gets(message);
-               printf(lcd_putc,"\f%s",message);
+               link_gets(message,sizeof(message) - 1);
+               message[sizeof(message) - 1] = 0;
+               marquee = lcd_marquee(message) > LCD_WIDTH;
                break;
                
             // Clear LCD
             case ClearScreen: 
+               marquee = false;
                lcd_putc('\f'); 
                break;
                
+#ifdef LINK_STATS
+            // Return link and EEPROM counters (tx, rx, reads, writes)
+            case LinkStats: 
+               send_int32(link_stats.tx);
+               send_int32(link_stats.rx);
+               send_int32(ext_eeprom_reads);
+               send_int32(ext_eeprom_writes);
+               break;
+#endif
+
+            // Stream the probe table to master
+            case DumpProfile: 
+               prof_dump(); 
+               break;
+               
+            // Probe table of the master, only read from the link
+            case MasterProfile: 
+               skip_profile(); 
+               break;
+               
             default:
          }
       }
@@ -164,6 +230,8 @@ Product read_product( int8 num ) {
    Product prod;
    int8 i;
    
+   PROF_START(ProbeReadProduct);
+   
    // Read product SKU from EEPROM
    for(i=0; i<7; i++) {
       prod.sku[i] = read_ext_eeprom(0x01+i+num*20);
@@ -178,6 +246,8 @@ Product read_product( int8 num ) {
    prod.price = (read_ext_eeprom(0x13+num*20)<<8) 
                    + read_ext_eeprom(0x14+num*20);
    
+   PROF_STOP(ProbeReadProduct);
+   
    // Return obtained product
    return prod;
 }
@@ -189,6 +259,11 @@ int1 save_product( Product prod ) {
    int8 max = read_ext_eeprom(0x00);
    int8 i;
    
+   // A record past the last one would overwrite the generation byte
+   if(max >= CATALOG_SIZE) {
+      return false;
+   }
+   
    // Save product SKU on EEPROM
    for(i=0; i<7; i++) {
       write_ext_eeprom(0x01+i+max*20,prod.sku[i]);
@@ -206,11 +281,16 @@ int1 save_product( Product prod ) {
    // Increase number of saved items 
    write_ext_eeprom(0x00,max+1);
    
+   // Let the master know the catalog changed
+   write_ext_eeprom(CATALOG_GEN_ADDR,read_ext_eeprom(CATALOG_GEN_ADDR)+1);
+   
    // Saved Successfully
    return true;
 }
 
 // Display product information on LCD
 void print_product(Product prod) {
+   PROF_START(ProbeLcd);
    printf(lcd_putc,"\f%s %s\n$ %04lu",prod.sku,prod.name,prod.price);
+   PROF_STOP(ProbeLcd);
 }
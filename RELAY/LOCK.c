@@ -10,45 +10,161 @@
 ////  before the lock stays locked indefinitely.                        ////
 ////                                                                    ////
 ////  The first time the program runs in the device, it will ask the    ////
-////  user to enter a 20 character long password. After this, the       ////
-////  password wont be able to change any more.                         ////
+////  user to enter a 20 character long password, the master password.  ////
+////  When the relay was opened with it more passwords can be added by  ////
+////  pressing A, entering the new password and a digit that selects    ////
+////  how long it keeps the relay open (see hold_times). The relay      ////
+////  closes while a password is added.                                 ////
+////                                                                    ////
+////  The passwords are kept as hashes in a 24LC08B (see                ////
+////  CREDENTIALS.c) that is not on the board schematic, it must be     ////
+////  added:                                                            ////
+////        pin 1-4  A0, A1, A2, VSS  GND                               ////
+////        pin 5    SDA              C1 and 4.7k pull-up               ////
+////        pin 6    SCL              C2 and 4.7k pull-up               ////
+////        pin 7    WP               GND                               ////
+////        pin 8    VCC              +5V                               ////
+////                                                                    ////
+////  Every unlock, invalid password, lockout and added password is     ////
+////  logged with the seconds since power up (see EVENTLOG.c). Sending  ////
+////  an L through RS232 streams the log.                               ////
+////                                                                    ////
+////  Older versions kept a single password in the internal EEPROM, it  ////
+////  is moved to the credential table the first time the lock starts.  ////
+////                                                                    ////
+////  The lock is a state machine driven by key presses and software    ////
+////  timers (see TIMERS.c) on a 10 ms tick, it never waits in a delay. ////
+////  Messages, the validating animation, the lockout countdown and     ////
+////  the relay hold time are expiries of the state timer, so the       ////
+////  keypad and the LCD keep working while they run. The relay closes  ////
+////  after the hold time of the password or when a key is pressed.     ////
 ////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
 #include <18F4550.h>
 #Fuses HS
 #use delay( clock = 20M )
+#use rs232( baud=9600 , xmit=pin_c6 , rcv=pin_c7 , parity=N , bits=8 , stop=1 )
 
 // Include Peripherical Drivers
 #include <LCD420.c>
 #include <stdlib.h>
+#include <string.h>
 
 // Include Custom Drivers
+#define KP_ISR    // Keys pressed in any state are queued
 #include <../Libraries/RGBLED.c>
 #include <../Libraries/KP4X4.c>
 
+// Credential table and log in the external EEPROM
+#define EEPROM_SDA     PIN_C1
+#define EEPROM_SCL     PIN_C2
+#define EEPROM_SIZE    1024
+#include <../Libraries/2404.c>
+#include <../Libraries/CREDENTIALS.c>
+
+#define LOG_BASE       CRED_BYTES   // Log right after the table
+#define LOG_ENTRIES    16
+#define LOG_HEAD_ADDR  0xFF
+#include <../Libraries/EVENTLOG.c>
+
+// Software timers on the 10 ms tick
+enum LockTimers{
+   TimerState,       // Timeout of the current state
+   TimerSecond       // Uptime
+};
+#define TIMER_COUNT    2
+#define TICK_ON_CS()   timer_tick()
+#include <../Libraries/TIMERS.c>
+#include <../Libraries/TICK.c>
+
+// Internal EEPROM byte 0 once the credential table is in use
+#define CRED_READY   0x00
+
+// Internal EEPROM byte with the slot of the master password
+#define MASTER_ADDR  0x01
+
+// Tick of the timers
+#define TICK_MS      10
+#define MS(ms)       ((ms)/TICK_MS)    // Milliseconds to ticks
+
+// Timeouts (ms)
+#define TITLE_TIME     500    // Title and saved password messages
+#define MESSAGE_TIME   500    // Invalid password message
+#define DOT_TIME       200    // Validating animation step
+#define ENROLL_TIME    15000  // Adding a password without pressing keys
+
+// Relay open time (sec) of every hold time index, A selects index 0-9
+const int8 hold_times[16] = {
+   5, 1, 2, 3, 10, 15, 20, 30, 60, 120, 5, 5, 5, 5, 5, 5
+};
+
+// RS232 command that streams the log
+#define LOG_DUMP     'L'
+
+// Logged events, data is the credential slot or the try number
+enum LockEvents{
+   LogOpen,          // Correct password
+   LogInvalid,       // Invalid password
+   LogLockout,       // Lockout started
+   LogBlocked,       // Locked indefinitely
+   LogEnrolled       // Password added
+};
+
+// Lock States
+enum LockStates{
+   StateTitle,       // Title is shown
+   StateCreate,      // User enters a new password
+   StateSaved,       // New password is shown
+   StateEnter,       // User enters the password
+   StateValidating,  // Validating animation
+   StateInvalid,     // Invalid password message
+   StateLockout,     // Countdown until the next try
+   StateOpen,        // Relay open
+   StateEnroll,      // User enters a password to add
+   StateHold,        // User selects the hold time of the new password
+   StateEnrolled,    // Result of adding the password is shown
+   StateBlocked      // Locked indefinitely
+};
+
+// Global Variables
+unsigned int16 uptime = 0; // Seconds since power up
+enum LockStates state;
+
+char saved_pass[21] = {'\0'};
+char pass[21] = {'\0'};
+int8 length = 0;   // Keys entered
+int8 try = 0;      // Number of tries
+int16 seg = 0;     // Seconds to wait if incorrect password is entered
+int8 dots = 0;     // Validating animation step
+int8 hold = 0;     // Hold time index of the password
+int8 opener;       // Credential slot of the password that opened
+int8 new_hold;     // Hold time index of the password being added
+int8 result;       // Result of adding a password
+int1 done = 0;     // Blocks the lock after many attempts
+
 // Function Declaration
 void display_title( void );
-void enter_password(char pass[21]);
-void save_password(char pass[21]);
+int1 enter_key(char key, char buffer[21]);
 void get_password(char pass[21]);
-signed int8 strcmp(unsigned char *s1, unsigned char *s2);
+void forget_password( void );
+void lock_enter(enum LockStates next);
+void lock_key(char key);
+void lock_timeout( void );
 
 // Main Code
 void main ( void )
 {
    // Local Variable Declaration
-   char saved_pass[21] = {'\0'};
-   char pass[21] = {'\0'};
-   
-   int8 try = 0;  // Number of tries
-   int8 seg = 0;  // Seconds to wait if incorrect password is entered
-   int1 done = 0; // Finishes process after many attempts 
+   char key;
    
    // Peripherical Configuration
    lcd_init();
    led_init();
    kp_init();
+   init_ext_eeprom();
+   cred_init();
+   log_init();
    set_tris_c(0b11111110); // Configure Relay in Port C
    srand(get_rtcc());      // Seed for random numbers
    
@@ -57,60 +173,245 @@ void main ( void )
    kp_def_ast('\b');    // Change '*' to delete 
    kp_def_tag('\0');    // Change '#' to empty
    output_low(PIN_C0);  // Close Relay
-      
-   // Display title for half second
-   led_setcolor(BLUE);
-   display_title();
-   delay_ms(500);
    
-   // Clear LCD
-   lcd_putc('\f');
+   // Timers and tick configuration
+   timer_init();
+   timer_start(TimerSecond,MS(1000),MS(1000));
+   tick_init();
    
-   // Enter Password if EEPROM is empty
-   if( read_eeprom(0x00) == 0xFF ) {
+   lock_enter(StateTitle);
    
-      led_setcolor(PURPLE);
-      printf(lcd_putc,"\nCreate New Password:\n");
-      enter_password(saved_pass);
-      save_password(saved_pass);
+   //Main Loop
+   for(;;)
+   {
+      // Advance the uptime and the state
+      if(timer_expired(TimerSecond)) {
+         uptime++;
+      }
+      if(timer_expired(TimerState)) {
+         lock_timeout();
+      }
       
-      // Display Complete Saved Password for half a second
-      printf(lcd_putc,"\f\nSaved Password:\n");
-      printf(lcd_putc,"%s",saved_pass);
-      delay_ms(500);
+      // Stream the log when requested through RS232
+      if(kbhit() && getc() == LOG_DUMP) {
+         log_dump();
+      }
       
+      // Handle pressed keys
+      key = kp_getc();
+      if(key != NOKEYPRESS) {
+         lock_key(key);
+      }
    }
-   // Get previously saved password from EEPROM 
-   else {
-      get_password(saved_pass);
-   }
+}
+
+// Enters a state, showing its message and starting its timer
+void lock_enter(enum LockStates next) {
+
+   state = next;
+   timer_stop(TimerState);
    
+   switch(state) {
    
-   //Main Loop
-   while(!done)
-   {
-      // User tries to enter password
-      led_setcolor(CYAN);
-      enter_password(pass);
-      try++;
-            
-      // Simulate validating process
-      printf(lcd_putc,"\f\n   Validating");
-      delay_ms(200);
-      for( int8 i=0 ; i<5 ; i++) {
-         lcd_putc('.');
-         delay_ms(200);
-      }
+      // Display title for half second
+      case StateTitle: 
+         led_setcolor(BLUE);
+         display_title();
+         timer_start(TimerState,MS(TITLE_TIME),0);
+         break;
+      
+      // Ask for a new password
+      case StateCreate: 
+         led_setcolor(PURPLE);
+         printf(lcd_putc,"\f\nCreate New Password:\n");
+         length = 0;
+         break;
       
-      // Invalid Password
-      if(strcmp(saved_pass,pass) != 0) {
+      // Display Complete Saved Password for half a second
+      case StateSaved: 
+         printf(lcd_putc,"\f\nSaved Password:\n");
+         printf(lcd_putc,"%s",saved_pass);
+         timer_start(TimerState,MS(TITLE_TIME),0);
+         break;
+      
+      // User tries to enter password, staged log entries are written now
+      case StateEnter: 
+         log_idle();
+         led_setcolor(CYAN);
+         lcd_putc('\f');
+         lcd_gotoxy(1,3);
+         memset(pass,'\0',sizeof(pass));
+         length = 0;
+         break;
+      
+      // Simulate validating process, a dot every step
+      case StateValidating: 
+         printf(lcd_putc,"\f\n   Validating");
+         dots = 0;
+         timer_start(TimerState,MS(DOT_TIME),MS(DOT_TIME));
+         break;
       
-         // Display Incorrect Password Message
+      // Display Incorrect Password Message
+      case StateInvalid: 
          led_setcolor(RED);
          printf(lcd_putc,"\f\nInvalid Password\n");
-         delay_ms(500);
-         
-         // Set for how long the user has to wait to try again
+         timer_start(TimerState,MS(MESSAGE_TIME),0);
+         break;
+      
+      // Wait until time has elapsed, once a second
+      case StateLockout: 
+         lcd_gotoxy(1,3);
+         printf(lcd_putc,"Try again in %3lus",seg);
+         timer_start(TimerState,MS(1000),0);
+         break;
+      
+      // Open Relay until key is pressed or hold time elapses
+      case StateOpen: 
+         led_setcolor(GREEN);
+         printf(lcd_putc,"\f\nCorrect Password");
+         output_high(PIN_C0);
+         timer_start(TimerState,(unsigned int16)hold_times[hold] * MS(1000),0);
+         break;
+      
+      // Close Relay and ask for the password to add
+      case StateEnroll: 
+         output_low(PIN_C0);
+         led_setcolor(PURPLE);
+         printf(lcd_putc,"\f\nAdd Password:\n");
+         memset(pass,'\0',sizeof(pass));
+         length = 0;
+         timer_start(TimerState,MS(ENROLL_TIME),0);
+         break;
+      
+      // Ask for the hold time index
+      case StateHold: 
+         printf(lcd_putc,"\f\nHold Time (0-9):\n");
+         timer_start(TimerState,MS(ENROLL_TIME),0);
+         break;
+      
+      // Display the result for half a second
+      case StateEnrolled: 
+         lcd_gotoxy(1,4);
+         switch(result) {
+            case CRED_OK:     printf(lcd_putc,"Saved %us",hold_times[new_hold]); break;
+            case CRED_EXISTS: printf(lcd_putc,"Already Saved"); break;
+            case CRED_FULL:   printf(lcd_putc,"No Space Left"); break;
+         }
+         timer_start(TimerState,MS(MESSAGE_TIME),0);
+         break;
+      
+      // Nothing else happens
+      case StateBlocked: 
+         lcd_gotoxy(1,3);
+         printf(lcd_putc,"Blocked            ");
+         break;
+   }
+}
+
+// Handles a key pressed in the current state
+void lock_key(char key) {
+
+   switch(state) {
+   
+      // Save the new password once entered
+      case StateCreate: 
+         if(enter_key(key,saved_pass)) {
+            cred_add(saved_pass,0);
+            write_eeprom(MASTER_ADDR,cred_index);
+            write_eeprom(0x00,CRED_READY);
+            lock_enter(StateSaved);
+         }
+         break;
+      
+      // Validate the password once entered
+      case StateEnter: 
+         if(enter_key(key,pass)) {
+            try++;
+            lock_enter(StateValidating);
+         }
+         break;
+      
+      // A adds a password if the master password opened, other keys
+      // close Relay and reset tries
+      case StateOpen: 
+         if(key == 'A' && opener == read_eeprom(MASTER_ADDR)) {
+            lock_enter(StateEnroll);
+            break;
+         }
+         output_low(PIN_C0);
+         try = 0;
+         lock_enter(StateEnter);
+         break;
+      
+      // Ask for the hold time once the password is entered
+      case StateEnroll: 
+         if(enter_key(key,pass)) {
+            lock_enter(StateHold);
+         } else {
+            timer_start(TimerState,MS(ENROLL_TIME),0);
+         }
+         break;
+      
+      // Save the password with the selected hold time
+      case StateHold: 
+         if(key >= '0' && key <= '9') {
+            new_hold = key - '0';
+            result = cred_add(pass,new_hold);
+            if(result == CRED_OK) {
+               log_add(uptime,LogEnrolled,cred_index);
+            }
+            lock_enter(StateEnrolled);
+         }
+         break;
+      
+      // Keys are ignored in the other states
+   }
+}
+
+// Handles the end of the state timer
+void lock_timeout( void ) {
+
+   switch(state) {
+   
+      // Enter Password if EEPROM is empty
+      case StateTitle: 
+         if( read_eeprom(0x00) == 0xFF ) {
+            lock_enter(StateCreate);
+            break;
+         }
+         // Move the password of older versions to the credential table
+         if( read_eeprom(0x00) != CRED_READY ) {
+            get_password(saved_pass);
+            cred_add(saved_pass,0);
+            forget_password();
+            write_eeprom(MASTER_ADDR,cred_index);
+         }
+         lock_enter(StateEnter);
+         break;
+      
+      case StateSaved: 
+         lock_enter(StateEnter);
+         break;
+      
+      // Animation step, then check the password
+      case StateValidating: 
+         if(dots < 5) {
+            lcd_putc('.');
+            dots++;
+         }
+         else if((hold = cred_find(pass)) == CRED_NONE) {
+            log_add(uptime,LogInvalid,try);
+            lock_enter(StateInvalid);
+         }
+         else {
+            opener = cred_index;
+            log_add(uptime,LogOpen,opener);
+            lock_enter(StateOpen);
+         }
+         break;
+      
+      // Set for how long the user has to wait to try again
+      case StateInvalid: 
          switch(try) {
             case 3: seg = 30; break;
             case 5: seg = 60; break;
@@ -118,34 +419,44 @@ void main ( void )
             
             case 15: 
                done = 1; 
-               printf(lcd_putc,"Blocked");
                seg = rand() % 180 + 120;
                break;
                
             default: seg = 0;
          }
          
-         // Wait until time has elapsed
-         while(seg != 0) {
-            printf(lcd_putc,"Try again in %3us",seg);
-            delay_ms(1000);
-            seg--;
+         if(done) {
+            log_add(uptime,LogBlocked,try);
          }
-      }
-      // Correct Password
-      else {
-         // Display Correct Password Message
-         led_setcolor(GREEN);
-         printf(lcd_putc,"\f\nCorrect Password");
-         
-         // Open Relay until key is pressed
-         output_high(PIN_C0);
-         while(kp_getc() != NOKEYPRESS);
+         if(seg != 0) {
+            log_add(uptime,LogLockout,try);
+            lock_enter(StateLockout);
+         } else {
+            lock_enter(StateEnter);
+         }
+         break;
+      
+      // Count down the lockout
+      case StateLockout: 
+         if(--seg != 0) {
+            lock_enter(StateLockout);
+         } else if(done) {
+            lock_enter(StateBlocked);
+         } else {
+            lock_enter(StateEnter);
+         }
+         break;
+      
+      // Close Relay and reset number of tries, also when a password
+      // is not added in time
+      case StateOpen: 
+      case StateEnroll: 
+      case StateHold: 
+      case StateEnrolled: 
          output_low(PIN_C0);
-         
-         // Reset number of tries
-         try=0;
-      } 
+         try = 0;
+         lock_enter(StateEnter);
+         break;
    }
 }
 
@@ -161,47 +472,54 @@ void display_title( void ){
    printf(lcd_putc,"********************\n");
 }
 
-// Ask user for password
-void enter_password(char pass[21]) {
-   
-   // Local Variable Declaration
-   char key = NOKEYPRESS;
+// Adds a key to the password being entered
+// Returns true when the password is complete
+int1 enter_key(char key, char buffer[21]) {
 
-   // Enter Password
-   for ( int8 i = 0; i < 20 && key != '\0'; i++){
+   // Clear password if delete is pressed
+   if( key == '\b') {
+      lcd_gotoxy(1,3);
+      printf(lcd_putc,"                    ");
+      lcd_gotoxy(1,3);
+      length = 0;
+      return false;
+   }
    
-      // Get Key from keypad
-      do key = kp_getc(); while(key == NOKEYPRESS);
-      
-      // Clear password if delete is pressed
-      if( key == '\b') {
-         lcd_gotoxy(1,3);
-         printf(lcd_putc,"                    ");
-         lcd_gotoxy(1,3);
-         i = -1;
-      }
-      // Display and save key
-      else {
-         lcd_putc(key);
-         pass[i] = key;
-      }
+   // Display and save key, '#' ends the password
+   if(key != '\0') {
+      lcd_putc(key);
+   }
+   buffer[length++] = key;
+   if(key == '\0' || length >= 20) {
+      buffer[length] = '\0';
+      return true;
    }
+   return false;
 }
 
-// Save the password to the EEPROM
-void save_password(char pass[21]) {
+// Get the password of older versions from the EEPROM
+void get_password(char pass[21]) {
 
-   for(int8 i = 0; pass[i] != '\0'; i++){
-      write_eeprom(0x00+i,pass[i]);
+   int8 i;
+   
+   for( i=0 ; i<20; i++) {
+      pass[i] = read_eeprom(0x00+i);
+      if(pass[i] == '\0' || pass[i] == 0xFF) {
+         break;
+      }
    }
-
+   pass[i] = '\0';
+   
 }
 
-// Get the password from the EEPROM
-void get_password(char pass[21]) {
+// Erase the password of older versions from the EEPROM
+void forget_password( void ) {
 
-   for( int8 i=0 ; pass[i] != '\0'; i++) {
-      pass[i] = read_eeprom(0x00+i);
+   for( int8 i=1 ; i<20; i++) {
+      if(read_eeprom(0x00+i) != 0xFF) {
+         write_eeprom(0x00+i,0xFF);
+      }
    }
+   write_eeprom(0x00,CRED_READY);
    
 }
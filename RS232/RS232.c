@@ -11,19 +11,33 @@
 ////  programm installed, so one board can control the other one.       ////
 ////                                                                    ////
 ////  The purpose of this software is controlling the other board by    ////
-////  sending a command when the keypad is pressed. The numbers 0-8     ////
+////  sending a command when the keypad is pressed. The numbers 0-7     ////
 ////  will change the other board's RGB LED color, and the 'A' key      ////
 ////  will toggle the other board's relay between open and closed.      ////
 ////                                                                    ////
-////  When the a key is pressed on the keypad from the other board,     ////
-////  this board will change its status depending on the key recieved   ////
-////  from the RS232 Serial Communication.                              ////
+////  Every message is a frame:                                         ////
+////        STX  LEN  CMD  DATA...  CHK                                 ////
+////  LEN counts CMD and DATA, CHK makes the sum of LEN, CMD, DATA and  ////
+////  CHK zero. Every command frame is answered with a CmdAck frame     ////
+////  holding an AckStatus.                                             ////
 ////                                                                    ////
 ////  The available commands are:                                       ////
-////           OFF    0            BLUE   4           Relay  A          ////
-////           RED    1            PURPLE 5                             ////
-////           GREEN  2            CYAN   6                             ////
-////           YELLOW 3            WHITE  7                             ////
+////        CmdSetLed      color   Colors:  OFF    0      BLUE   4      ////
+////        CmdSetRelay    0/1              RED    1      PURPLE 5      ////
+////        CmdPulseRelay  ticks            GREEN  2      CYAN   6      ////
+////        CmdReadState   -                YELLOW 3      WHITE  7      ////
+////        CmdBatch       commands with their data, run in order       ////
+////        CmdKeyEvent    key, tick (2 bytes)                          ////
+////  CmdReadState is answered with CmdState (color, relay). A tick is  ////
+////  10 ms.                                                            ////
+////                                                                    ////
+////  When a key is pressed on this board it goes out as a CmdKeyEvent. ////
+////  A board that receives a CmdKeyEvent of the numbers 0-7 changes    ////
+////  its RGB LED color, and the 'A' key toggles its relay.             ////
+////                                                                    ////
+////  Received bytes are stored by the RS232 interrupt in a ring        ////
+////  buffer and the keypad is scanned by Timer 2, so neither waits     ////
+////  for the other.                                                    ////
 ////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
@@ -38,14 +52,92 @@
 #include <LCD420.c>
 
 // Include Custom Drivers
+#define KP_ISR    // Keypad scanned by Timer 2
 #include <../Libraries/RGBLED.c>
 #include <../Libraries/KP4X4.c>
 
+// 10 ms tick, see TICK.c
+void tick( void );
+#define TICK_ON_CS()  tick()
+#include <../Libraries/TICK.c>
+
+// Frame definitions
+#define STX          0x02
+#define FRAME_MAX    16      // CMD and DATA bytes of a frame
+#define RX_SIZE      32      // Ring buffer size (power of 2)
+
+// Bridge Commands
+enum BridgeCommands{
+   CmdSetLed = 0x10,
+   CmdSetRelay,
+   CmdPulseRelay,
+   CmdReadState,
+   CmdBatch,
+   CmdKeyEvent,
+   CmdState = 0x20,
+   CmdAck
+};
+
+// Acknowledge status
+enum AckStatus{
+   AckOk,
+   AckChecksum,
+   AckUnknown,
+   AckLength
+};
+
+// Frame receiver states
+enum RxStates{
+   WaitStx,
+   WaitLen,
+   WaitData,
+   WaitChk
+};
+
+// Global Variables
+char rx_buffer[RX_SIZE];
+int8 rx_head = 0;          // Written by the RS232 interrupt
+int8 rx_tail = 0;          // Read by the main code
+
+unsigned int16 ticks = 0;  // Ticks since power up
+int8 pulse = 0;            // Ticks until the relay closes, 0 no pulse
+
+// Function Declaration
+void receive_frame(char c);
+void send_frame(int8 cmd, int8 *data, int8 len);
+int8 run_frame(int8 *frame, int8 len);
+int8 run_command(int8 *cmd, int8 len, int8 &used);
+
+// RS232 receive interrupt
+#int_rda
+void rx_byte( void )
+{
+   int8 next = (rx_head + 1) & (RX_SIZE - 1);
+   char c = getc();
+   
+   // Drop the byte when the buffer is full
+   if(next != rx_tail) {
+      rx_buffer[rx_head] = c;
+      rx_head = next;
+   }
+}
+
+// Runs from the tick interrupt, counts ticks and ends the relay pulses
+void tick( void )
+{
+   ticks++;
+   if(pulse != 0 && --pulse == 0) {
+      output_low(PIN_C0);
+   }
+}
+
 // Main Code
 void main ( void )
 {
    // Local Variables declaration
    int8 key = 0;
+   int8 event[3];
+   unsigned int16 now;
    
    // Peripherical Configuration
    lcd_init();
@@ -57,33 +149,194 @@ void main ( void )
    led_off();
    output_low(PIN_C0);  // Closes Relay
    
+   // Tick and RS232 interrupts
+   enable_interrupts( INT_RDA );
+   tick_init();
+   
    // Infinite Loop
    for(;;) {
    
       // Get number from the key pad
       key = kp_getn();
       
-      // Send through rs232 when pressed
+      // Send a timestamped key event when pressed
       if(key != NOKEYPRESS ) {
-         putc( key );
+      
+         // The tick may carry between both bytes, take them together
+         disable_interrupts( TICK_INT );
+         now = ticks;
+         enable_interrupts( TICK_INT );
+         
+         event[0] = key;
+         event[1] = make8(now,0);
+         event[2] = make8(now,1);
+         send_frame(CmdKeyEvent,event,3);
       }
       
-      // Check if something was recieved from rs232
-      if( kbhit() ) {
+      // Handle everything recieved from rs232
+      while(rx_tail != rx_head) {
+         receive_frame(rx_buffer[rx_tail]);
+         rx_tail = (rx_tail + 1) & (RX_SIZE - 1);
+      }
+   }
+}
+
+// Sends a frame with its length and checksum
+void send_frame(int8 cmd, int8 *data, int8 len) {
+
+   int8 sum = len + 1 + cmd;
+   
+   putc(STX);
+   putc(len + 1);
+   putc(cmd);
+   for(int8 i=0; i<len; i++) {
+      putc(data[i]);
+      sum += data[i];
+   }
+   putc(-sum);
+}
+
+// Builds frames byte by byte and runs them once complete
+void receive_frame(char c) {
+
+   static int8 state = WaitStx;
+   static int8 frame[FRAME_MAX];
+   static int8 len;
+   static int8 pos;
+   static int8 sum;
+   
+   int8 status;
+   
+   switch(state) {
+   
+      // Anything before STX is discarded
+      case WaitStx: 
+         if(c == STX) {
+            state = WaitLen;
+         }
+         break;
       
-         // Get key from RS232 serial buffer
-         key = getc();
-         
-         // Change LED color depending on recieved key
-         if(key < 8) {
-            led_setcolor(key);
+      case WaitLen: 
+         if(c == 0 || c > FRAME_MAX) {
+            state = WaitStx;
+            status = AckLength;
+            send_frame(CmdAck,&status,1);
+            break;
          }
-         // Open/close relay when 10 is recieved
-         else if(key == 0xA) {
-            output_toggle(PIN_C0);
+         len = c;
+         sum = c;
+         pos = 0;
+         state = WaitData;
+         break;
+      
+      case WaitData: 
+         frame[pos++] = c;
+         sum += c;
+         if(pos == len) {
+            state = WaitChk;
          }
+         break;
+      
+      // Run the frame and acknowledge it
+      case WaitChk: 
+         state = WaitStx;
          
+         // Replies are not acknowledged
+         if(frame[0] == CmdAck || frame[0] == CmdState) {
+            break;
+         }
+         if((int8)(sum + c) != 0) {
+            status = AckChecksum;
+         } else {
+            status = run_frame(frame,len);
+         }
+         send_frame(CmdAck,&status,1);
+         break;
+   }
+}
+
+// Runs a frame, a batch runs each of its commands in order
+int8 run_frame(int8 *frame, int8 len) {
+
+   int8 status;
+   int8 used;
+   int8 pos;
+   
+   if(frame[0] != CmdBatch) {
+      status = run_command(frame,len,used);
+      if(status == AckOk && used != len) {
+         status = AckLength;
+      }
+      return status;
+   }
+   
+   for(pos = 1; pos < len; pos += used) {
+      status = run_command(&frame[pos],len - pos,used);
+      if(status != AckOk) {
+         return status;
       }
    }
+   return AckOk;
 }
 
+// Runs the command at cmd with len bytes available
+// Sets used to the bytes of the command and its data
+int8 run_command(int8 *cmd, int8 len, int8 &used) {
+
+   int8 state[2];
+   
+   used = 1;
+   
+   switch(cmd[0]) {
+   
+      // Change LED color
+      case CmdSetLed: 
+         if(len < 2) return AckLength;
+         led_setcolor(cmd[1] & 0x07);
+         used = 2;
+         break;
+      
+      // Open or close relay
+      case CmdSetRelay: 
+         if(len < 2) return AckLength;
+         pulse = 0;
+         output_bit(PIN_C0,cmd[1] != 0);
+         used = 2;
+         break;
+      
+      // Open relay for a number of ticks
+      case CmdPulseRelay: 
+         if(len < 2) return AckLength;
+         output_high(PIN_C0);
+         pulse = cmd[1];
+         used = 2;
+         break;
+      
+      // Answer with LED color and relay state
+      case CmdReadState: 
+         state[0] = led_getcolrn() & 0x07;
+         state[1] = input_state(PIN_C0);
+         send_frame(CmdState,state,2);
+         break;
+      
+      // Key pressed on the other board, change LED color for 0-7
+      // and toggle relay for 'A'
+      case CmdKeyEvent: 
+         if(len < 4) return AckLength;
+         if(cmd[1] < 8) {
+            led_setcolor(cmd[1]);
+         }
+         else if(cmd[1] == 0xA) {
+            pulse = 0;
+            output_toggle(PIN_C0);
+         }
+         used = 4;
+         break;
+      
+      // Batches can not be nested
+      default: 
+         return AckUnknown;
+   }
+   
+   return AckOk;
+}
@@ -17,6 +17,16 @@
 ////        2 - Increase data       4 - Move cursor left                ////
 ////        8 - Decrease data       6 - Move cursor right               ////
 ////                                                                    ////
+////  The master keeps its own clock on the tick and only synchronizes  ////
+////  it with the time the slave pushes every SYNC_INTERVAL seconds.    ////
+////  The date and alarm are pushed when they change, the master only   ////
+////  requests them all (PushAll) when it starts or when changes are    ////
+////  canceled.                                                         ////
+////                                                                    ////
+////  The keypad adjusts the first alarm of the table kept by the       ////
+////  slave. Every alarm of the table rings (LED blinking) for its      ////
+////  duration on the days of the week it is set for.                   ////
+////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
 // Microcontroller used in this project
@@ -26,11 +36,20 @@
 #include <../RTC_COMMUNICATION.c>
 
 /*******  Include Peripherical Libraries  *******/
-#include <LCD420.c>
+#define LCD_QUEUED    // LCD writes are sent by the tick
+#define LCD_QUEUE 128  // A whole redraw, about 70 bytes, fits
+#include <../../Libraries/HD44780.c>
 
 /*******  Include Custom Libraries  *******/
+#define KP_ISR    // Debounced keypad with hold to repeat
 #include <../../Libraries/KP4X4.c>
 #include <../../Libraries/RGBLED.c>
+#include <../../Libraries/ALARMS.c>
+
+// 10 ms tick that runs the local clock, the blink and the LCD
+void clock_tick( void );
+#define TICK_ON_CS()  clock_tick()
+#include <../../Libraries/TICK.c>
 
 /*******            ENUMS             *******/
 
@@ -43,31 +62,77 @@ enum changes{
    SendChanges
 };
 
+// Fields drawn on the LCD
+enum fields{
+   FieldDow,
+   FieldDay,
+   FieldMth,
+   FieldYear,
+   FieldHour,
+   FieldMin,
+   FieldSec,
+   FieldAlarmHour,
+   FieldAlarmMin,
+   FieldAlarmSec,
+   FIELDS
+};
+
 /*******  Global Variables  *******/
-unsigned int16 count = 0;
-unsigned int16 count_length = 100;
 unsigned char  keypress = 0;
+int1           blink = false;     // Adjusted field hidden (set by the tick)
+
+/*******  LCD Fields  *******/
+// Position of every field, the text around them is drawn once
+const int8 field_x[FIELDS] = { 1, 5, 11, 18, 1, 4, 7, 9, 12, 15 };
+const int8 field_y[FIELDS] = { 1, 1, 1, 1, 2, 2, 2, 4, 4, 4 };
+
+int8 field_shown[FIELDS];         // Value on the LCD of every field
+unsigned int16 field_dirty = 0;   // Fields that must be drawn again
+unsigned int16 field_blank = 0;   // Fields hidden by the blink
+
+/*******  Local Clock  *******/
+#define CLOCK_TICKS   (getenv("CLOCK")/4)  // Instruction cycles per second
+#define SYNC_INTERVAL 60                    // Seconds between slave syncs
+
+unsigned int32 clock_phase = 0;    // Cycles into the current second
+unsigned int32 clock_period = CLOCK_TICKS;   // Ticks of the local second
+signed int32   clock_trim = 0;     // Frequency correction (ticks/second)
+unsigned int8  clock_seconds = 0;  // Seconds counted by the ISR
+unsigned int8  clock_counted = 0;  // Seconds already added to the clock
+unsigned int8  clock_dow = 0;      // Day of the week of the local clock
+int1           clock_synced = false;
 
-/*******  Timer0 interrupt function  *******/
+/*******  Tick function  *******/
 
-// Used to make adjusting data blink
-#int_timer0
-void cursor_blink( void )
+// The tick is reset by hardware, so interrupt latency does not
+// accumulate: every tick adds TICK_CYCLES to the current second.
+// Also used to make adjusting data blink and to send the LCD writes.
+void clock_tick( void )
 {
-   count++;
-   count %= count_length;
-   set_timer0( 220 );
-   clear_interrupt( INT_TIMER0 );
+   PROF_START(ProbeIsrTick);
+   clock_phase += TICK_CYCLES;
+   if(clock_phase >= clock_period) {
+      clock_phase -= clock_period;
+      clock_seconds++;
+   }
+   blink = tick_cs >= 40;
+   lcd_drain();
+   PROF_STOP(ProbeIsrTick);
 }
 
 /*******          FUNCTIONS          *******/
-void print_date(Date date);
-void print_time(Time time);
-void print_alarm(Time alarm);
+void draw_labels( void );
+void draw_fields(Date &date, Time &time, Time &alarm, int8 blinking);
+int8 blink_field(enum changes change, int8 cursor_position);
 void switchpos(int8 &cursor_position,int8 &var);
+int1 clock_update(Time &now);
+void clock_sync(Time remote, Time &now);
 enum changes change_date(Date &date, int8 &cursor_position);
 enum changes change_time(Time &time, int8 &cursor_position);
 enum changes change_alarm(Time &alarm, int8 &cursor_position);
+#ifdef LINK_STATS
+void print_link_stats( void );
+#endif
 
 
 /*******          MAIN CODE          *******/
@@ -76,66 +141,85 @@ void main ( void )
    // Adjustable Variable Data Declaration
    Date date; 
    Time alarm;
-   Time alarmend;
    Time time; 
+   Time now = {0,0,0};                // Local clock, set by the first sync
    
    // Adjustable Variable Helper Declaration
    int8 cursor_position = 0;     // Determines the current cursor position
-   int8 alarmduration = 30;      // Sets the alarm duration (sec)
+   int1 ringing = false;         // An alarm of the table is ringing
    enum changes change = ChangeNone;  // Determines which data is adjusted
+   int8 event;                        // Byte received through RS232
    
    // Peripherical Initialization
    lcd_init();
    kp_init();
+   kp_repeat_char('2', true);    // Holding up/down keeps adjusting
+   kp_repeat_char('8', true);
    led_init();
    led_off();
+   prof_init();
+   link_init();
+   
+   //Tick configuration, the LCD is only written once it runs
+   tick_init();
+   draw_labels();
+   
+   // Slave time is only needed to correct the local clock
+   send_command(PushInterval);
+   link_putc(SYNC_INTERVAL);
    
-   //Timer configuration
-   enable_interrupts ( GLOBAL | INT_TIMER0 );
-   setup_timer_0( T0_INTERNAL | T0_DIV_256 | T0_8_BIT);
+   // Ask the slave for the current date, time and alarm
+   send_command(PushAll);
 
    for(;;) {
+      // Receive everything the slave pushed
+      while(link_kbhit()) {
+         event = link_getc();
+         receive_push(event);
+      }
+      
+      // Correct the local clock with the slave time
+      if(pushed & PUSHED_TIME) {
+         clock_sync(pushed_time,now);
+         pushed &= ~PUSHED_TIME;
+      }
+      
+      // Find the next alarm again when the table changes
+      if(pushed & PUSHED_TABLE) {
+         alarm_schedule(alarm_table,week_seconds(clock_dow,now));
+         pushed &= ~PUSHED_TABLE;
+      }
+      
+      // Advance the local clock and the alarm scheduler
+      if(clock_update(now)) {
+         ringing = alarm_tick(alarm_table,week_seconds(clock_dow,now));
+         
+         // Show the new time unless it is being adjusted
+         if(change != ChangeTime && change != SendChanges) {
+            time = now;
+         }
+      }
+
       // Saves current pressed key
       keypress = kp_getc();
       
-      // Blinking condition when adjusting data
-      if(count>=count_length/2-10) {
-         // Creates blinking effect in current cursor position
-         // when something is being adjusted
-         printf(lcd_putc,"   ");
-      } 
-      else {
-         // Print Data
-         print_date(date);
-         print_time(time);
-         print_alarm(alarm);
-      }
+      // Draw the fields that changed, blinking the adjusted one
+      draw_fields(date,time,alarm,blink_field(change,cursor_position));
       
       //Do not update date, time and alarm when sending changes
       if(change != SendChanges) {
       
-         // Get RTC Date if it is not being adjusted
-         if(change != ChangeDate) {
-            putc(SendDate);
-            receive_date(date);
+         // Use the pushed RTC Date if it is not being adjusted
+         if(change != ChangeDate && (pushed & PUSHED_DATE)) {
+            date = pushed_date;
+            clock_dow = date.dow;
+            pushed &= ~PUSHED_DATE;
          }
          
-         // Get RTC Time if it is not being adjusted
-         if(change != ChangeTime) {
-            putc(SendTime);
-            receive_time(time);
-            print_time(time);
-         } 
-         
-         // Get alarm from EEPROM if it is not being adjusted
-         if(change != ChangeAlarm) {
-            putc(SendAlarm);
-            receive_time(alarm);
-            
-            // Update alarm end
-            alarmend.hour = alarm.hour;
-            alarmend.min = alarm.min;
-            alarmend.sec = alarm.sec + alarmduration;
+         // Use the pushed alarm if it is not being adjusted
+         if(change != ChangeAlarm && (pushed & PUSHED_ALARM)) {
+            alarm = pushed_alarm;
+            pushed &= ~PUSHED_ALARM;
          }
       }
       
@@ -150,7 +234,16 @@ void main ( void )
          case 'C': change = ChangeTime;  break; //Adjust Time
          case 'A': change = ChangeAlarm; break; //Adjust Alarm
          case '#': change = SendChanges; break; // Send changes to slave
-         case '*': change = ChangeNone;  break; //Cancel
+         case '*': change = ChangeNone;         //Cancel
+                   send_command(PushAll);  break; //and restore values
+#ifdef LINK_STATS
+         case 'B': print_link_stats();        //Show link statistics
+                   draw_labels();      break; //and draw everything again
+#endif
+#ifdef PROFILE
+         case '0': send_command(MasterProfile); //Stream the probe table,
+                   prof_dump();        break; //the slave drops it
+#endif
       }
       
       // If a change is being made adjust the data
@@ -173,25 +266,29 @@ void main ( void )
          
          // Sends the new information to the slave 
          case SendChanges: 
-            putc(ReceiveDate);
+            send_command(ReceiveDate);
             Send_date(date);
-            putc(ReceiveTime);
+            send_command(ReceiveTime);
             Send_time(time);
-            putc(ReceiveAlarm);
+            send_command(ReceiveAlarm);
             Send_time(alarm);
-            putc(SetRTC);
+            send_command(SetRTC);
+            
+            // The local clock starts again from the new time
+            clock_synced = false;
+            clock_sync(time,now);
+            clock_dow = date.dow;
 
          // Sets the state back to idle
          default: 
             change = ChangeNone; 
-            lcd_gotoxy(1,3);
       }
       
-      // Comparing times to turn on Alarm (Blinking LED)
-      if( !change && timecmp(alarm,time) >= 0 && timecmp(alarmend,time) < 0) {
+      // Blink the LED while an alarm rings
+      if( !change && ringing ) {
       
          // LED Blinking condition
-         if(count>=0 && count<=count_length/2) {
+         if(tick_cs <= 50) {
             led_setcolor(WHITE);
          } else {
             led_off();
@@ -205,22 +302,175 @@ void main ( void )
    }
 }
 
-// Prints the date (DOW DAY de MTH de YEAR) on the first line of the LCD
-void print_date(Date date) {
-   lcd_gotoxy(1,1);
-   printf(lcd_putc,"%3s %02u de %3s de %02u ",date.dows,date.day,date.mths,date.year);
+// Advances the local clock by the seconds counted in the ISR
+// Returns true if the time changed
+int1 clock_update(Time &now) {
+
+   int1 changed = false;
+   
+   while(clock_counted != clock_seconds) {
+      clock_counted++;
+      changed = true;
+      
+      // Carry seconds to minutes and hours
+      if(++now.sec >= 60) {
+         now.sec = 0;
+         if(++now.min >= 60) {
+            now.min = 0;
+            if(++now.hour >= 24) {
+               now.hour = 0;
+               clock_dow = (clock_dow + 1) % 7;
+            }
+         }
+      }
+   }
+   
+   return changed;
 }
 
-// Prints the time (HOUR:MIN:SEC) on the second line of the LCD
-void print_time(Time time) {
-   lcd_gotoxy(1,2);
-   printf(lcd_putc,"%02u:%02u:%02u ",time.hour,time.min,time.sec);
+// Compares the local clock with the slave time received at the start of
+// its second. Large errors are stepped, small ones are slewed away over
+// the next interval and the clock frequency is trimmed.
+void clock_sync(Time remote, Time &now) {
+
+   DaySecs local;
+   signed int32 offset;
+   signed int32 slew;
+   
+   disable_interrupts( TICK_INT );
+   
+   // Offset in seconds, positive when the local clock is ahead. Seconds
+   // the tick counted that clock_update() did not add yet are counted.
+   local = secs_add(time2secs(now),(int8)(clock_seconds - clock_counted));
+   offset = secs_diff(local,time2secs(remote));
+   
+   if(!clock_synced || offset > 1 || offset < -1) {
+      // Step to the slave time
+      now = remote;
+      clock_phase = 0;
+      clock_counted = clock_seconds;
+      clock_period = CLOCK_TICKS + clock_trim;
+      clock_synced = true;
+   } else {
+      offset = offset * CLOCK_TICKS + clock_phase;
+      
+      // Remove the offset during the next interval and trim the frequency
+      slew = offset / SYNC_INTERVAL;
+      clock_trim += slew;
+      
+      // Never trust more than 1% of frequency error
+      if(clock_trim > CLOCK_TICKS/100) clock_trim = CLOCK_TICKS/100;
+      if(clock_trim < -(CLOCK_TICKS/100)) clock_trim = -(CLOCK_TICKS/100);
+      
+      clock_period = CLOCK_TICKS + clock_trim + slew;
+   }
+   
+   enable_interrupts( TICK_INT );
 }
 
-// Prints the alarm (Alarma: HOUR:MIN:SEC) on the forth line of the LCD
-void print_alarm(Time alarm) {
+// Draws the text around the fields (DOW DAY de MTH de YEAR,
+// HOUR:MIN:SEC and Alarma: HOUR:MIN:SEC) and marks every field dirty
+void draw_labels( void ) {
+   lcd_putc('\f');
+   lcd_gotoxy(7,1);
+   printf(lcd_putc," de ");
+   lcd_gotoxy(14,1);
+   printf(lcd_putc," de ");
+   lcd_gotoxy(3,2);
+   lcd_putc(':');
+   lcd_gotoxy(6,2);
+   lcd_putc(':');
    lcd_gotoxy(1,4);
-   printf(lcd_putc,"Alarma: %02u:%02u:%02u ",alarm.hour,alarm.min,alarm.sec);
+   printf(lcd_putc,"Alarma: ");
+   lcd_gotoxy(11,4);
+   lcd_putc(':');
+   lcd_gotoxy(14,4);
+   lcd_putc(':');
+   
+   field_dirty = 0xFFFF;
+   field_blank = 0;
+}
+
+// Draws only the fields whose value changed since they were drawn.
+// While blink is set the blinking field is hidden instead.
+void draw_fields(Date &date, Time &time, Time &alarm, int8 blinking) {
+
+   int8 value[FIELDS];
+   int8 width;
+   
+   value[FieldDow] = date.dow;
+   value[FieldDay] = date.day;
+   value[FieldMth] = date.mth;
+   value[FieldYear] = date.year;
+   value[FieldHour] = time.hour;
+   value[FieldMin] = time.min;
+   value[FieldSec] = time.sec;
+   value[FieldAlarmHour] = alarm.hour;
+   value[FieldAlarmMin] = alarm.min;
+   value[FieldAlarmSec] = alarm.sec;
+   
+   for(int8 field=0; field<FIELDS; field++) {
+      
+      // Day of the week and month are 3 letters, the rest 2 digits
+      width = (field == FieldDow || field == FieldMth) ? 3 : 2;
+      
+      if(field == blinking && blink) {
+         // Hide the field once
+         if(bit_test(field_blank,field)) {
+            continue;
+         }
+         bit_set(field_blank,field);
+         PROF_START(ProbeLcd);
+         lcd_gotoxy(field_x[field],field_y[field]);
+         while(width--) {
+            lcd_putc(' ');
+         }
+         PROF_STOP(ProbeLcd);
+      }
+      else if(bit_test(field_dirty,field) || bit_test(field_blank,field) ||
+              value[field] != field_shown[field]) {
+         // Draw the new value, only the units when the tens are the same
+         PROF_START(ProbeLcd);
+         if(width == 2 && !bit_test(field_dirty,field) &&
+            !bit_test(field_blank,field) &&
+            value[field] / 10 == field_shown[field] / 10) {
+            lcd_gotoxy(field_x[field] + 1,field_y[field]);
+            lcd_putc('0' + value[field] % 10);
+         } else {
+            lcd_gotoxy(field_x[field],field_y[field]);
+            if(field == FieldDow) {
+               printf(lcd_putc,"%3s",date.dows);
+            } else if(field == FieldMth) {
+               printf(lcd_putc,"%3s",date.mths);
+            } else {
+               lcd_putc('0' + value[field] / 10);
+               lcd_putc('0' + value[field] % 10);
+            }
+         }
+         PROF_STOP(ProbeLcd);
+         bit_clear(field_dirty,field);
+         bit_clear(field_blank,field);
+         field_shown[field] = value[field];
+      }
+   }
+}
+
+// Field blinking while data is adjusted, FIELDS when there is none
+int8 blink_field(enum changes change, int8 cursor_position) {
+
+   switch(change) {
+      case ChangeDate: 
+         if(cursor_position < 4) return FieldDow + cursor_position;
+         break;
+      case ChangeTime: 
+         if(cursor_position < 3) return FieldHour + cursor_position;
+         break;
+      case ChangeAlarm: 
+         if(cursor_position < 3) return FieldAlarmHour + cursor_position;
+         break;
+   }
+   
+   return FIELDS;
 }
 
 // Changes the current position of the cursor or the variable
@@ -243,7 +493,6 @@ int8 change_date(Date &date,int8 &cursor_position) {
    
       // Cursor 0 adjusts day of the week
       case 0: 
-         lcd_gotoxy(1,1);
          switchpos(cursor_position,date.dow); 
          date.dow = (date.dow + 7) % 7;
          set_dow_str(date);
@@ -251,7 +500,6 @@ int8 change_date(Date &date,int8 &cursor_position) {
       
       // Cursor 1 adjusts day number
       case 1: 
-         lcd_gotoxy(4,1);
          switchpos(cursor_position,date.day);
          date.day = (date.day + 31) % 31;
          if(date.day == 0)
@@ -260,7 +508,6 @@ int8 change_date(Date &date,int8 &cursor_position) {
       
       // Cursor 2 adjusts month
       case 2: 
-         lcd_gotoxy(11,1);
          switchpos(cursor_position,date.mth);
          date.mth = (date.mth + 12) % 12;
          set_mth_str(date);
@@ -268,7 +515,6 @@ int8 change_date(Date &date,int8 &cursor_position) {
       
       // Cursor 3 adjusts year
       case 3: 
-         lcd_gotoxy(18,1);
          switchpos(cursor_position,date.year);
          date.year = (date.year + 100) % 100;
          break;
@@ -290,21 +536,18 @@ int8 change_time(Time &time,int8 &cursor_position) {
    
       // Cursor 0 adjusts hour
       case 0: 
-         lcd_gotoxy(1,2);
          switchpos(cursor_position,time.hour); 
          time.hour = (time.hour + 24) % 24;
          break;
          
       // Cursor 1 adjusts minutes
       case 1: 
-         lcd_gotoxy(4,2);
          switchpos(cursor_position,time.min); 
          time.min = (time.min + 60) % 60;
          break;
          
       // Cursor 2 adjusts seconds
       case 2: 
-         lcd_gotoxy(7,2);
          switchpos(cursor_position,time.sec);
          time.sec = (time.sec + 60) % 60;
          break;
@@ -326,21 +569,18 @@ int8 change_alarm(Time &time,int8 &cursor_position) {
    
       // Cursor 0 adjusts hour
       case 0: 
-         lcd_gotoxy(9,4);
          switchpos(cursor_position,time.hour); 
          time.hour = (time.hour + 24) % 24;
          break;
          
       // Cursor 1 adjusts minutes
       case 1: 
-         lcd_gotoxy(12,4);
          switchpos(cursor_position,time.min);
          time.min = (time.min + 60) % 60;
          break;
          
       // Cursor 2 adjusts seconds
       case 2: 
-         lcd_gotoxy(15,4);
          switchpos(cursor_position,time.sec);
          time.sec = (time.sec + 60) % 60;
          break;
@@ -354,3 +594,27 @@ int8 change_alarm(Time &time,int8 &cursor_position) {
    // Continue adjusting alarm if not done
    return ChangeAlarm;
 }
+
+#ifdef LINK_STATS
+// Prints the link and slave EEPROM counters for 2 seconds
+void print_link_stats( void ) {
+
+   // Local Variable Declaration
+   unsigned int32 slave_tx, slave_rx, reads, writes;
+   
+   // Ask slave for its counters
+   send_command(LinkStats);
+   link_ack();
+   slave_tx = receive_int32();
+   slave_rx = receive_int32();
+   reads = receive_int32();
+   writes = receive_int32();
+   
+   // tx,rx,trips of master and slave, and EEPROM cycles
+   printf(lcd_putc,"\fMASTER %lu,%lu,%lu\n",link_stats.tx,link_stats.rx,link_stats.trips);
+   printf(lcd_putc,"SLAVE  %lu,%lu\n",slave_tx,slave_rx);
+   printf(lcd_putc,"EEPROM %lu,%lu\n",reads,writes);
+   delay_ms(2000);
+   lcd_putc('\f');
+}
+#endif
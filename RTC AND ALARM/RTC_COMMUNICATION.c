@@ -9,8 +9,22 @@
 ////                                                                    ////
 ////  struct Time { dow, day, mth, year, dow_str, mth_str }             ////
 ////                                                                    ////
+////  struct AlarmEntry { hour, min, sec, duration, days }              ////
+////                                                                    ////
+////  DaySecs   - Seconds since midnight (0 - 86399)                    ////
+////                                                                    ////
+////  EpochSecs - Seconds since 1 Jan 2000 00:00:00 (up to 2099)        ////
+////                                                                    ////
 ////  enum CommunicationComands { SendDate, SendTime, SendAlarm,        ////
-////           ReceiveDate, ReceiveTime, ReceiveAlarm, SetRTC }         ////
+////           ReceiveDate, ReceiveTime, ReceiveAlarm, SetRTC,          ////
+////           LinkStats, DumpProfile, PushAll, SendDateTime,           ////
+////           PushInterval, ReceiveAlarmEntry, SendEpoch, SetEpoch,    ////
+////           MasterProfile }                                          ////
+////                                                                    ////
+////  enum PushEvents { TimeEvent, DateEvent, AlarmEvent,               ////
+////           AlarmEntryEvent }                                        ////
+////                                                                    ////
+////  struct LinkStats { tx, rx, trips }   (only with LINK_STATS)       ////
 ////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 ////                             Functions                              ////
@@ -23,16 +37,85 @@
 ////                                                                    ////
 ////  void recieve_time(Time) - Recieves time from master/slave         ////
 ////                                                                    ////
+////  int1 send_datetime(Date,Time)   - Sends date and time in a frame  ////
+////                                                                    ////
+////  void receive_datetime(Date,Time) - Receives date and time frame   ////
+////                                                                    ////
+////  DaySecs time2secs(Time) / secs2time(DaySecs,Time)                 ////
+////                          - Time to seconds since midnight and back ////
+////                                                                    ////
+////  DaySecs secs_add(DaySecs,secs) - Adds seconds around midnight     ////
+////                                to a time below DAY_SECONDS         ////
+////                                                                    ////
+////  signed int32 secs_diff(a,b) - a - b the closest way around        ////
+////                                midnight (-43200 - 43200)           ////
+////                                                                    ////
+////  EpochSecs date2epoch(Date,Time) / epoch2date(EpochSecs,Date,Time) ////
+////                          - Date and time to seconds since 2000     ////
+////                            and back. date2epoch returns            ////
+////                            EPOCH_INVALID for a month not 1 - 12    ////
+////                            or a day not 1 - 31                     ////
+////                                                                    ////
+////  int1 send_epoch(EpochSecs) / receive_epoch(EpochSecs)             ////
+////                          - Date and time as 4 bytes                ////
+////                                                                    ////
 ////  void set_dow_str(Date)  - Sets the day of the week string         ////
 ////                                                                    ////
 ////  void set_mth_str(Date)  - Sets the month string                   ////
 ////                                                                    ////
+////  void push_date(Date)    - Pushes the date to master               ////
+////                                                                    ////
+////  void push_time(ev,Time) - Pushes a time or alarm to master        ////
+////                                                                    ////
+////  int1 send_alarm_entry(i,AlarmEntry) - Sends an alarm table entry  ////
+////                                                                    ////
+////  int8 receive_alarm_entry(AlarmEntry) - Receives an entry, returns ////
+////                                         its index                  ////
+////                                                                    ////
+////  void push_alarm_entry(i,AlarmEntry) - Pushes an entry to master   ////
+////                                                                    ////
+////  void receive_push(ev)   - Stores a pushed value in pushed_date,   ////
+////                            pushed_time, pushed_alarm or            ////
+////                            alarm_table and sets its bit in pushed  ////
+////                            (master)                                ////
+////                                                                    ////
+////  The slave pushes the time every PushInterval seconds (1 by        ////
+////  default), and the date and alarm only when they change. Push      ////
+////  frames start with a PushEvents byte (0x80 and above) so they are  ////
+////  told apart from acknowledges, which are always below 0x80.        ////
+////                                                                    ////
+////  The alarm table holds ALARMS entries. pushed_alarm is the time of ////
+////  entry 0, the one adjusted from the keypad. PushAll also pushes    ////
+////  every entry of the table.                                         ////
+////                                                                    ////
+////  void send_command(cmd)  - Starts a command round trip             ////
+////                                                                    ////
+////  void link_putc(c) / link_getc() - Counted putc/getc on the link   ////
+////  int1 link_kbhit()             - True if a received byte waits     ////
+////  void skip_profile()           - Drops a probe table of the master ////
+////                                                                    ////
+////  Both sides receive in the RS232 interrupt into a ring buffer of   ////
+////  LINK_RX_SIZE bytes, so pushes are not lost while the program is   ////
+////  busy. Call link_init() and enable GLOBAL interrupts at boot.      ////
+////                                                                    ////
+////  Define LINK_STATS to count the bytes moved on the link, the       ////
+////  command round trips and the slave's EEPROM cycles. The master     ////
+////  requests the slave counters with the LinkStats command.           ////
+////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
 /*******      Communication standards      *******/
 #Fuses HS
 #use delay( clock = 5000000 )
-#use rs232( baud=9600 , xmit=pin_c6 , rcv=pin_c7 , parity=N , bits=8 , stop=1 )
+#use rs232( baud=9600 , xmit=pin_c6 , rcv=pin_c7 , parity=N , bits=8 , stop=1 , ERRORS )
+
+// Uncomment to count the traffic on the master/slave link
+//#define LINK_STATS
+
+// Uncomment to enable the cycle count probes (see PROFILE.c)
+//#define PROFILE
+
+#include <../../Libraries/PROFILE.c>
 
 /*******        Common Structures          *******/
 
@@ -53,6 +136,31 @@ typedef struct time{
    unsigned int8 sec;
 } Time;
 
+// Alarm Table Entry Structure
+typedef struct alarmentry{
+   unsigned int8 hour;        // ALARM_EMPTY when the entry is not used
+   unsigned int8 min;
+   unsigned int8 sec;
+   unsigned int8 duration;    // Seconds the alarm rings
+   unsigned int8 days;        // Bit n set rings on day of the week n
+} AlarmEntry;
+
+// Seconds since midnight and since 1 Jan 2000 00:00:00
+typedef unsigned int32 DaySecs;
+typedef unsigned int32 EpochSecs;
+
+#define DAY_SECONDS  86400
+#define EPOCH_INVALID  0xFFFFFFFF
+
+// Entries of the alarm table, can be defined before including this file.
+// The slave keeps the table in the settings store of the 56 byte DS1307
+// RAM (SETTINGS.c) next to the push interval, which leaves room for 9.
+#ifndef ALARMS
+#define ALARMS       8
+#endif
+#define ALARM_SIZE   5        // Bytes of an entry
+#define ALARM_EMPTY  0xFF
+
 /*******            ENUMS             *******/
 // Master - Slave Communication Commands
 enum CommunicationComands{
@@ -62,39 +170,433 @@ enum CommunicationComands{
    ReceiveDate,
    ReceiveTime,
    ReceiveAlarm,
-   SetRTC
+   SetRTC,
+   LinkStats,
+   DumpProfile,
+   PushAll,
+   SendDateTime,
+   PushInterval,
+   ReceiveAlarmEntry,
+   SendEpoch,
+   SetEpoch,
+   MasterProfile
+};
+
+// Slave to master pushed frames
+enum PushEvents{
+   TimeEvent = 0x80,
+   DateEvent,
+   AlarmEvent,
+   AlarmEntryEvent
 };
 
+// Bits set in pushed when a new value arrives
+#define PUSHED_TIME  0x01
+#define PUSHED_DATE  0x02
+#define PUSHED_ALARM 0x04
+#define PUSHED_TABLE 0x08
+
+/*******          Receive Buffer          *******/
+#define LINK_RX_SIZE  128     // Ring buffer size (power of 2)
+
+char link_buffer[LINK_RX_SIZE];
+int8 link_head = 0;           // Written by the RS232 interrupt
+int8 link_tail = 0;           // Read by link_read()
+
+// RS232 receive interrupt, the slave pushes frames at any time
+#int_rda
+void link_rx_byte( void )
+{
+   int8 next = (link_head + 1) & (LINK_RX_SIZE - 1);
+   char c = getc();
+   
+   // Drop the byte when the buffer is full
+   if(next != link_tail) {
+      link_buffer[link_head] = c;
+      link_head = next;
+   }
+}
+
+// Starts receiving in the interrupt
+void link_init( void ) {
+   enable_interrupts( INT_RDA );
+}
+
+// True if a received byte is waiting in the buffer
+#define link_kbhit()  (link_tail != link_head)
+
+// Waits for the next received byte
+char link_read( void ) {
+   char c;
+   
+   PROF_START(ProbeLinkWait);
+   while(link_tail == link_head);
+   PROF_STOP(ProbeLinkWait);
+   c = link_buffer[link_tail];
+   link_tail = (link_tail + 1) & (LINK_RX_SIZE - 1);
+   return c;
+}
+
+/*******         Link Statistics          *******/
+#ifdef LINK_STATS
+
+// Link Statistics Structure
+typedef struct linkstats{
+   unsigned int32 tx;      // Bytes sent through the link
+   unsigned int32 rx;      // Bytes received from the link
+   unsigned int32 trips;   // Commands started by this side
+} LinkStats;
+
+LinkStats link_stats = {0,0,0};
+
+#define link_tx(n)   link_stats.tx += (n)
+#define link_rx(n)   link_stats.rx += (n)
+#define link_trip()  link_stats.trips++
+
+// Sends a counter least significant byte first
+void send_int32(unsigned int32 value) {
+   for(int8 i=0; i<4; i++) {
+      putc(make8(value,i));
+      link_tx(1);
+   }
+}
+
+// Receives a counter least significant byte first
+unsigned int32 receive_int32( void ) {
+   int8 b0 = link_read();
+   int8 b1 = link_read();
+   int8 b2 = link_read();
+   int8 b3 = link_read();
+   link_rx(4);
+   return make32(b3,b2,b1,b0);
+}
+
+#else
+
+#define link_tx(n)
+#define link_rx(n)
+#define link_trip()
+
+#endif
+
 /*******          FUNCTIONS           *******/
+// Counted single byte transfers
+void link_putc(char c) {
+   putc(c);
+   link_tx(1);
+}
+
+char link_getc( void ) {
+   link_rx(1);
+   return link_read();
+}
+
+// Reads the prof_dump() table a master sends with MasterProfile
+void skip_profile( void ) {
+   int16 n = (int16)link_getc() * PROF_PROBE_BYTES + 1;
+   
+   // Prescaler, then every probe
+   while(n--) {
+      link_getc();
+   }
+}
+
+// Starts a command round trip with master/slave
+void send_command(int8 cmd) {
+   link_putc(cmd);
+   link_trip();
+}
+
+/*******          PUSHED VALUES          *******/
+// Latest values pushed by the slave (master side)
+Date pushed_date;
+Time pushed_time;
+Time pushed_alarm;
+
+// Alarm table, pushed by the slave (master side) or loaded from the
+// settings store (slave side)
+AlarmEntry alarm_table[ALARMS];
+unsigned int8 pushed = 0;
+
+void set_dow_str(Date &date);
+void set_mth_str(Date &date);
+
+// Pushes the date to the master
+void push_date(Date date) {
+   printf(link_putc,"%c%c%c%c%c",DateEvent,date.dow,date.day,date.mth,date.year);
+}
+
+// Pushes a TimeEvent or AlarmEvent to the master
+void push_time(int8 event, Time time) {
+   printf(link_putc,"%c%c%c%c",event,time.sec,time.min,time.hour);
+}
+
+// Pushes an entry of the alarm table to the master
+void push_alarm_entry(int8 index, AlarmEntry entry) {
+   printf(link_putc,"%c%c%c%c%c%c%c",AlarmEntryEvent,index,entry.hour,
+                              entry.min,entry.sec,entry.duration,entry.days);
+}
+
+// Receives the frame started by a pushed event byte
+void receive_push(int8 event) {
+
+   AlarmEntry entry;
+   int8 index;
+
+   switch(event) {
+      case TimeEvent: 
+         pushed_time.sec = link_getc();
+         pushed_time.min = link_getc();
+         pushed_time.hour = link_getc();
+         pushed |= PUSHED_TIME;
+         break;
+         
+      case DateEvent: 
+         pushed_date.dow = link_getc();
+         pushed_date.day = link_getc();
+         pushed_date.mth = link_getc();
+         pushed_date.year = link_getc();
+         set_dow_str(pushed_date);
+         set_mth_str(pushed_date);
+         pushed |= PUSHED_DATE;
+         break;
+         
+      case AlarmEvent: 
+         pushed_alarm.sec = link_getc();
+         pushed_alarm.min = link_getc();
+         pushed_alarm.hour = link_getc();
+         pushed |= PUSHED_ALARM;
+         break;
+         
+      case AlarmEntryEvent: 
+         index = link_getc();
+         entry.hour = link_getc();
+         entry.min = link_getc();
+         entry.sec = link_getc();
+         entry.duration = link_getc();
+         entry.days = link_getc();
+         if(index < ALARMS) {
+            alarm_table[index] = entry;
+            pushed |= PUSHED_TABLE;
+         }
+         break;
+   }
+}
+
+// Waits for an acknowledge, storing any value pushed in between
+int8 link_ack( void ) {
+   int8 c;
+   
+   while((c = link_getc()) >= TimeEvent) {
+      receive_push(c);
+   }
+   return c;
+}
+
 // Send Date value to master/slave
 // Returns true if communication was successful
 int1 send_date(Date date) {
-   printf("%c%c%c%c",date.dow,date.day,date.mth,date.year);
-   return getc();
+   printf(link_putc,"%c%c%c%c",date.dow,date.day,date.mth,date.year);
+   return link_ack();
 }
 
 // Send Time value to master/slave
 // Returns true if communication was successful
 int1 send_time(Time time) {
-   printf("%c%c%c",time.sec,time.min,time.hour);
-   return getc();
+   printf(link_putc,"%c%c%c",time.sec,time.min,time.hour);
+   return link_ack();
+}
+
+// Send Date and Time values of the same second in a single frame
+// Returns true if communication was successful
+int1 send_datetime(Date date, Time time) {
+   printf(link_putc,"%c%c%c%c%c%c%c",time.sec,time.min,time.hour,
+                                       date.dow,date.day,date.mth,date.year);
+   return link_ack();
+}
+
+// Send an alarm table entry to the slave
+// Returns true if communication was successful
+int1 send_alarm_entry(int8 index, AlarmEntry entry) {
+   printf(link_putc,"%c%c%c%c%c%c",index,entry.hour,entry.min,entry.sec,
+                                    entry.duration,entry.days);
+   return link_ack();
+}
+
+// Send seconds since 2000 as 4 bytes, least significant first
+// Returns true if communication was successful
+int1 send_epoch(EpochSecs epoch) {
+   printf(link_putc,"%c%c%c%c",make8(epoch,0),make8(epoch,1),
+                               make8(epoch,2),make8(epoch,3));
+   return link_ack();
 }
 
 // Recieve Date value from master/slave
 void receive_date(Date &date) {
-   date.dow = getc();
-   date.day = getc();
-   date.mth = getc();
-   date.year = getc();
-   putc('\0');
+   date.dow = link_getc();
+   date.day = link_getc();
+   date.mth = link_getc();
+   date.year = link_getc();
+   link_putc('\0');
 }
 
 // Recieve Time value between master/slave
 void receive_time(Time &time) {
-   time.sec = getc();
-   time.min = getc();
-   time.hour = getc();
-   putc('\0');
+   time.sec = link_getc();
+   time.min = link_getc();
+   time.hour = link_getc();
+   link_putc('\0');
+}
+
+// Recieve Date and Time frame from master/slave
+void receive_datetime(Date &date, Time &time) {
+   time.sec = link_getc();
+   time.min = link_getc();
+   time.hour = link_getc();
+   date.dow = link_getc();
+   date.day = link_getc();
+   date.mth = link_getc();
+   date.year = link_getc();
+   link_putc('\0');
+}
+
+// Recieve an alarm table entry from master, returns its index
+int8 receive_alarm_entry(AlarmEntry &entry) {
+   int8 index = link_getc();
+   entry.hour = link_getc();
+   entry.min = link_getc();
+   entry.sec = link_getc();
+   entry.duration = link_getc();
+   entry.days = link_getc();
+   link_putc('\0');
+   return index;
+}
+
+// Recieve seconds since 2000 from master/slave
+void receive_epoch(EpochSecs &epoch) {
+   int8 b0 = link_getc();
+   int8 b1 = link_getc();
+   int8 b2 = link_getc();
+   int8 b3 = link_getc();
+   epoch = make32(b3,b2,b1,b0);
+   link_putc('\0');
+}
+
+/*******        Seconds Conversion         *******/
+// Days of the year before the first of each month (not leap)
+const unsigned int16 days_before_mth[12] = {
+   0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+// Seconds since midnight of hours, minutes and seconds
+DaySecs hms2secs(unsigned int8 hour, unsigned int8 min, unsigned int8 sec) {
+   return (DaySecs)hour * 3600 + (unsigned int16)min * 60 + sec;
+}
+
+// Seconds since midnight of a time
+DaySecs time2secs(Time time) {
+   return hms2secs(time.hour,time.min,time.sec);
+}
+
+// Time of seconds since midnight
+void secs2time(DaySecs secs, Time &time) {
+
+   // Only one 32 bit division, the rest fits in 16 bits
+   unsigned int16 mins = secs / 60;
+   
+   time.sec = secs - (DaySecs)mins * 60;
+   time.hour = mins / 60;
+   time.min = mins - (unsigned int16)time.hour * 60;
+}
+
+// Adds seconds to a time, wrapping around midnight. Durations under a
+// day, as the once a second clock update, need no 32 bit division.
+DaySecs secs_add(DaySecs secs, unsigned int32 duration) {
+   if(duration >= DAY_SECONDS) {
+      duration %= DAY_SECONDS;
+   }
+   
+   // Less than two days, one subtraction wraps it
+   secs += duration;
+   if(secs >= DAY_SECONDS) {
+      secs -= DAY_SECONDS;
+   }
+   return secs;
+}
+
+// Seconds from b to a the closest way around midnight
+signed int32 secs_diff(DaySecs a, DaySecs b) {
+   signed int32 diff = (signed int32)a - (signed int32)b;
+   
+   if(diff > DAY_SECONDS/2) diff -= DAY_SECONDS;
+   if(diff < -(DAY_SECONDS/2)) diff += DAY_SECONDS;
+   return diff;
+}
+
+// Seconds since 1 Jan 2000 of a date (year 0 - 99) and time
+EpochSecs date2epoch(Date date, Time time) {
+
+   unsigned int16 days;
+   
+   // The month indexes days_before_mth, a DS1307 that was never set
+   // can read anything
+   if(date.mth < 1 || date.mth > 12 || date.day < 1 || date.day > 31) {
+      return EPOCH_INVALID;
+   }
+
+   // Every year before this one plus one day for each leap year
+   days = (unsigned int16)date.year * 365 + (date.year + 3) / 4;
+   
+   days += days_before_mth[date.mth - 1] + date.day - 1;
+   if((date.year & 3) == 0 && date.mth > 2) {
+      days++;
+   }
+   
+   return (EpochSecs)days * DAY_SECONDS + time2secs(time);
+}
+
+// Date and time of seconds since 1 Jan 2000
+void epoch2date(EpochSecs epoch, Date &date, Time &time) {
+
+   unsigned int16 days = epoch / DAY_SECONDS;
+   unsigned int16 left;
+   unsigned int16 start;
+   int8 mth;
+   int1 leap;
+   
+   secs2time(epoch - (EpochSecs)days * DAY_SECONDS,time);
+   
+   // 1 Jan 2000 was a Saturday
+   date.dow = (days + 6) % 7;
+   
+   // Groups of 4 years start with a leap year
+   date.year = (days / 1461) * 4;
+   left = days % 1461;
+   if(left >= 366) {
+      left -= 366;
+      date.year += 1 + left / 365;
+      left %= 365;
+   }
+   leap = (date.year & 3) == 0;
+   
+   // Last month starting before the day
+   for(mth = 11; mth > 0; mth--) {
+      start = days_before_mth[mth];
+      if(leap && mth >= 2) {
+         start++;
+      }
+      if(left >= start) {
+         break;
+      }
+   }
+   if(mth == 0) {
+      start = 0;
+   }
+   
+   date.mth = mth + 1;
+   date.day = left - start + 1;
+   set_dow_str(date);
+   set_mth_str(date);
 }
 
 // Set the day of the week string value to date.dows (Spanish)
@@ -138,6 +640,7 @@ void set_mth_str(Date &date) {
 // time1 > time2   1
 // equal           0
 // time1 < time2  -1
+// Field by field, cheaper than comparing two time2secs() results
 signed int8 timecmp(struct Time time1,struct Time time2) {
    
    if( time1.hour != time2.hour ){
@@ -6,6 +6,22 @@
 ////  EEPROM IC with I2C communication. And communicating by RS232      ////
 ////  with a master to send the data stored on the periphericals.       ////
 ////                                                                    ////
+////  The DS1307 1 Hz square wave output is connected to RB2 (INT2,     ////
+////  with a pull-up). On every falling edge the slave reads the RTC    ////
+////  and pushes the time to the master every PushInterval seconds and  ////
+////  the date only when it changed, so the master does not need to     ////
+////  poll.                                                             ////
+////                                                                    ////
+////  The alarm table and the push interval are kept in the DS1307      ////
+////  battery backed RAM (see SETTINGS.c), ALARM_SIZE bytes per entry:  ////
+////        hour, min, sec, duration, days                              ////
+////  Entry 0 is the alarm adjusted from the keypad. The table is       ////
+////  loaded to RAM at boot and requests are answered from RAM.         ////
+////                                                                    ////
+////  Older versions kept the table in the 2404, starting at address    ////
+////  0x00. It is only read when the DS1307 RAM lost its contents,      ////
+////  to move it to the settings store.                                 ////
+////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
 // Microcontroller used in this project
@@ -23,10 +39,35 @@
 /*******  Include Custom Libraries  *******/
 #include <../../Libraries/DS1307.c>
 #include <../../Libraries/2404.c>
+#include <../../Libraries/SETTINGS.c>
+
+/*******            ENUMS             *******/
+// Settings store keys
+enum SettingKeys{
+   KeyAlarms,
+   KeyPushInterval
+};
+
+/*******  Global Variables  *******/
+int1 second = false;    // Set by the DS1307 square wave every second
+int8 push_interval = 1; // Seconds between time pushes (set by master)
+
+/*******  External interrupt 2 function  *******/
+// DS1307 square wave falling edge (1 Hz)
+#int_ext2
+void rtc_second( void )
+{
+   second = true;
+}
 
 /*******          FUNCTIONS          *******/
+void init_alarms( void );
+void save_alarms( void );
 void get_alarm(Time &alarm);
 void set_alarm(Time alarm);
+void get_alarm_entry(int8 index, AlarmEntry &entry);
+void set_alarm_entry(int8 index, AlarmEntry entry);
+void push_changes(int1 all);
 
 /*******          MAIN CODE          *******/
 void main(void)
@@ -35,19 +76,32 @@ void main(void)
    Date date; 
    Time alarm;
    Time time;
+   AlarmEntry entry;
+   int8 index;
+   EpochSecs epoch;
    
    // Peripherical Initialization
    rtc_init();
    init_ext_eeprom();
+   settings_load();
+   settings_get8(KeyPushInterval,push_interval);
+   init_alarms();
+   prof_init();
+   link_init();
+   
+   // Square wave interrupt configuration
+   ext_int_edge( 2, H_TO_L );
+   enable_interrupts( INT_EXT2 );
+   enable_interrupts( GLOBAL );
    
    // Endless Loop
    for(;;) {
    
       // If the microcontroller receives something through RS232
-      if(kbhit()) {
+      if(link_kbhit()) {
       
          // Command Processes
-         switch(getc()) {
+         switch(link_getc()) {
          
             // Return the current date to the master
             case SendDate: 
@@ -61,6 +115,12 @@ void main(void)
                send_time(time); 
                break;
                
+            // Return the current date and time of the same second
+            case SendDateTime: 
+               rtc_get_datetime(date,time);
+               send_datetime(date,time); 
+               break;
+               
             // Return the saved alarm to the master
             case SendAlarm: 
                get_alarm(alarm);
@@ -77,41 +137,191 @@ void main(void)
                receive_time(time); 
                break;
                
-            // Get the alarm from the master and save it
+            // Get the alarm from the master, save it and push it back
             case ReceiveAlarm:
                receive_time(alarm); 
                set_alarm(alarm); 
+               push_time(AlarmEvent,alarm);
+               get_alarm_entry(0,entry);
+               push_alarm_entry(0,entry);
+               break;
+               
+            // Get an alarm table entry, save it and push it back
+            case ReceiveAlarmEntry:
+               index = receive_alarm_entry(entry);
+               if(index < ALARMS) {
+                  set_alarm_entry(index,entry);
+                  push_alarm_entry(index,entry);
+                  if(index == 0) {
+                     get_alarm(alarm);
+                     push_time(AlarmEvent,alarm);
+                  }
+               }
                break;
                
             // Save the date and time to the RTC
             case SetRTC: 
                rtc_set_date_time(date,time); 
                break;
+               
+            // Return the current date and time as seconds since 2000
+            case SendEpoch: 
+               send_epoch(rtc_get_epoch()); 
+               break;
+               
+            // Get seconds since 2000 from the master and save them to the RTC
+            case SetEpoch: 
+               receive_epoch(epoch); 
+               rtc_set_epoch(epoch); 
+               break;
+               
+            // Push date, time and alarm to the master
+            case PushAll: 
+               push_changes(true); 
+               break;
+               
+            // Set the seconds between time pushes
+            case PushInterval: 
+               push_interval = link_getc(); 
+               settings_set8(KeyPushInterval,push_interval);
+               break;
+               
+#ifdef LINK_STATS
+            // Acknowledge, then link and EEPROM counters (tx, rx, reads, writes)
+            case LinkStats: 
+               link_putc('\0');
+               send_int32(link_stats.tx);
+               send_int32(link_stats.rx);
+               send_int32(ext_eeprom_reads);
+               send_int32(ext_eeprom_writes);
+               break;
+#endif
+
+            // Stream the probe table to master
+            case DumpProfile: 
+               prof_dump(); 
+               break;
+               
+            // Probe table of the master, only read from the link
+            case MasterProfile: 
+               skip_profile(); 
+               break;
          }
       }
+      
+      // Push the new time once a second, commands are served first
+      else if(second) {
+         second = false;
+         push_changes(false);
+      }
    }
 }
 
-// Retrieve the alarm from the eeprom
-void get_alarm(Time &alarm) {
+// Push the time every push_interval seconds and the date when it
+// changed, or all values and the alarm table
+void push_changes(int1 all) {
+
+   // Last values pushed to the master
+   static Time sent_time = {0xFF,0xFF,0xFF};
+   static Date sent_date = {0xFF,0xFF,0xFF,0xFF};
+   static int8 elapsed = 0;
    
-   // If the external eeprom is empty then asign the default alarm to 8:00
-   if(read_ext_eeprom(0x00) == 0xFF) {
-      write_ext_eeprom(0x00,8);  // alarm hour
-      write_ext_eeprom(0x01,0);   // alarm min
-      write_ext_eeprom(0x02,0); // alarm sec
+   Time now_time;
+   Date now_date;
+   Time alarm;
+   AlarmEntry entry;
+   
+   // Both in one transaction so they cannot straddle a second rollover
+   rtc_get_datetime(now_date,now_time);
+   
+   // Only count seconds that really changed
+   if(now_time.sec != sent_time.sec || now_time.min != sent_time.min ||
+      now_time.hour != sent_time.hour) {
+      elapsed++;
+      sent_time = now_time;
+   }
+   
+   if(all || elapsed >= push_interval) {
+      push_time(TimeEvent,now_time);
+      elapsed = 0;
+   }
+   
+   if(all || now_date.day != sent_date.day || now_date.mth != sent_date.mth ||
+             now_date.year != sent_date.year || now_date.dow != sent_date.dow) {
+      push_date(now_date);
+      sent_date = now_date;
+   }
+   
+   if(all) {
+      get_alarm(alarm);
+      push_time(AlarmEvent,alarm);
+      
+      for(int8 i=0; i<ALARMS; i++) {
+         get_alarm_entry(i,entry);
+         push_alarm_entry(i,entry);
+      }
+   }
+}
+
+// Load the alarm table to RAM from the settings store, moving it from
+// the external eeprom when the store does not have it
+void init_alarms( void ) {
+
+   int8 *cache = (int8*)alarm_table;
+   
+   if(settings_get(KeyAlarms,cache,ALARMS*ALARM_SIZE)) {
+      return;
+   }
+   
+   // Entries were stored in the eeprom with the same layout as in RAM
+   for(int8 address=0; address<ALARMS*ALARM_SIZE; address++) {
+      cache[address] = read_ext_eeprom(address);
+   }
+
+   // Default alarm at 8:00
+   if(alarm_table[0].hour == 0xFF) {
+      alarm_table[0].hour = 8;
+      alarm_table[0].min = 0;
+      alarm_table[0].sec = 0;
    }
    
-   // Read the alarm values from the eeprom
-   alarm.hour = read_ext_eeprom(0x00);
-   alarm.min = read_ext_eeprom(0x01);
-   alarm.sec = read_ext_eeprom(0x02);
+   // Older versions only saved the time, ring 30 sec every day
+   if(alarm_table[0].days == 0xFF) {
+      alarm_table[0].duration = 30;
+      alarm_table[0].days = 0x7F;
+   }
    
+   save_alarms();
+}
+
+// Write the alarm table to the settings store, only the bytes that
+// changed are sent to the DS1307
+void save_alarms( void ) {
+   settings_set(KeyAlarms,(int8*)alarm_table,ALARMS*ALARM_SIZE);
 }
 
-// Set the alarm to the eeprom
+// Retrieve the alarm (entry 0) from RAM
+void get_alarm(Time &alarm) {
+   alarm.hour = alarm_table[0].hour;
+   alarm.min = alarm_table[0].min;
+   alarm.sec = alarm_table[0].sec;
+}
+
+// Set the alarm (entry 0)
 void set_alarm(Time alarm) {
-   write_ext_eeprom(0x00,alarm.hour);
-   write_ext_eeprom(0x01,alarm.min);
-   write_ext_eeprom(0x02,alarm.sec);
+   alarm_table[0].hour = alarm.hour;
+   alarm_table[0].min = alarm.min;
+   alarm_table[0].sec = alarm.sec;
+   save_alarms();
+}
+
+// Retrieve an entry of the alarm table from RAM
+void get_alarm_entry(int8 index, AlarmEntry &entry) {
+   entry = alarm_table[index];
+}
+
+// Set an entry of the alarm table
+void set_alarm_entry(int8 index, AlarmEntry entry) {
+   alarm_table[index] = entry;
+   save_alarms();
 }
@@ -5,7 +5,7 @@
 ////  This is a sample program to show how to configure and use a       ////
 ////  timer in a microcontroller.                                       ////
 ////                                                                    ////
-////  The program makes use of timer 0 to count how much time has       ////
+////  The program makes use of a timer to count how much time has       ////
 ////  elapsed since the microcontroller is turned on.                   ////
 ////                                                                    ////
 ////  Two things happen in the program:                                 ////
@@ -15,6 +15,13 @@
 ////        * Blue  - 10 seconds                                        ////
 ////        * Red   - 1 minute                                          ////
 ////                                                                    ////
+////  The timing is done by the TICK library, whose cascaded counters   ////
+////  give the minutes, seconds and centiseconds without dividing.      ////
+////  The sample keeps the tick on Timer 0 (TICK_TIMER0). The interrupt ////
+////  moves the timer back a period instead of loading a fixed value,   ////
+////  so the interrupt latency does not add up as drift. Remove         ////
+////  TICK_TIMER0 to run it on Timer 1 reset by CCP1 in hardware.       ////
+////                                                                    ////
 ////////////////////////////////////////////////////////////////////////////
 
 #include <18F4550.h>
@@ -25,45 +32,13 @@
 #include <LCD420.c>
 #include <../Libraries/RGBLED.c>
 
-//Global variables
-unsigned int16 count = 0;
-unsigned int8 min = 0;
-const int8 time = 206;
-
-//Timer0 interrupt function 
-#int_timer0
-void prendido_led( void )
-{
-   count++;
-   
-   // One minute count
-   if(count%6000==0) {
-      led_setcolor(RED);   // Blink Red
-      count = 0;           // Restart cont
-      min++;               // Increase minutes
-      if(min==60)
-         min=0;            // Restart minutes every hour
-   }
-   
-   // Ten seconds count
-   else if(count%1000==0){
-      led_setcolor(BLUE);  // Blink blue
-   }
-   
-   // One second count
-   else if(count%100==0) {
-      led_setcolor(GREEN); // Blink green
-   }
-   
-   // 30 ms after every second
-   // * makes LED blink
-   else if(count%100==30) {
-      led_off();           // Turn the LED off
-   }
-   
-   set_timer0( time );
-   clear_interrupt( INT_TIMER0 );
-}
+//Tick on Timer 0, hooks run from the tick interrupt
+#define TICK_TIMER0
+#define TICK_ON_CS()      if(tick_cs == 30) led_off()  // Turn the LED off
+#define TICK_ON_SECOND()  led_setcolor(GREEN)          // Blink green
+#define TICK_ON_TEN()     led_setcolor(BLUE)           // Blink blue
+#define TICK_ON_MINUTE()  led_setcolor(RED)            // Blink red
+#include <../Libraries/TICK.c>
 
 
 void main (void)
@@ -75,14 +50,13 @@ void main (void)
    led_init();
    
    //Timer configuration
-   enable_interrupts ( GLOBAL | INT_TIMER0 );
-   setup_timer_0( T0_INTERNAL | T0_DIV_256 | T0_8_BIT);
+   tick_init();
    
    //infinite loop
    for(;;)
    {
       // Display the time that has passed since the start
       lcd_gotoxy(2,2);
-      printf(lcd_putc,"Cont: %2u m %2lu.%2lu s",min,count/100,count%100);
+      printf(lcd_putc,"Cont: %2u m %u%u.%02u s",tick_min,tick_sec10,tick_sec,tick_cs);
    }
 }
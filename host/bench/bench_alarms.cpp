@@ -0,0 +1,84 @@
+// bench_alarms - Per tick cost of the ALARMS.c scheduler with 32 alarms
+//
+// Runs alarm_tick() every second of a week over a random table of 32
+// entries and counts the ticks that scan the table again. An ordinary
+// tick compares now with alarm_next once; a scan checks every day of
+// every entry. The same week is run with the table scanned on every
+// tick, as a scheduler without the precomputed fire time does, and both
+// are timed on the host.
+
+#define ALARMS 32
+
+#include <chrono>
+
+#include "ccs.h"
+#include "bench.h"
+
+#include "rtc_communication.c"
+#include "alarms.c"
+
+static AlarmEntry table[ALARMS];
+
+static double host_ns(std::chrono::steady_clock::time_point start) {
+   return std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+int main( void ) {
+   uint32_t seed = 1, now, scans = 0, ringing = 0, alarms = 0;
+   volatile uint32_t sink = 0;   // Keeps the timed loops
+   Json json;
+   int i;
+
+   for(i = 0; i < ALARMS; i++) {
+      seed = seed * 1103515245 + 12345;
+      table[i].hour = (seed >> 8) % 24;
+      table[i].min = (seed >> 12) % 60;
+      table[i].sec = (seed >> 4) % 60;
+      table[i].duration = 30;
+      table[i].days = (seed >> 24) & 0x7F;
+      for(int dow = 0; dow < 7; dow++) {
+         alarms += (table[i].days >> dow) & 1;
+      }
+   }
+
+   // Precomputed next fire time, counting the ticks that scan
+   alarm_schedule(table, 0);
+   for(now = 0; now < WEEK_SECONDS; now++) {
+      scans += now < alarm_last || now >= alarm_next;
+      ringing += alarm_tick(table, now);
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   for(now = 0; now < WEEK_SECONDS; now++) {
+      sink += alarm_tick(table, now);
+   }
+   double tick_ns = host_ns(start) / WEEK_SECONDS;
+
+   // Whole table every tick
+   start = std::chrono::steady_clock::now();
+   for(now = 0; now < WEEK_SECONDS; now++) {
+      alarm_schedule(table, now);
+      sink += now >= alarm_next;
+   }
+   double scan_ns = host_ns(start) / WEEK_SECONDS;
+
+   json.begin();
+   json.str("benchmark", "alarms");
+   json.num("entries", ALARMS);
+   json.num("alarms_a_week", alarms);
+   json.num("ticks", WEEK_SECONDS);
+   json.begin("precomputed");
+   json.num("scans", scans);
+   json.num("day_checks_per_tick", (double)scans * ALARMS * 7 / WEEK_SECONDS);
+   json.num("host_ns_per_tick", tick_ns);
+   json.end();
+   json.begin("scan_every_tick");
+   json.num("scans", WEEK_SECONDS);
+   json.num("day_checks_per_tick", ALARMS * 7);
+   json.num("host_ns_per_tick", scan_ns);
+   json.end();
+   json.num("ringing_seconds", ringing);
+   json.end();
+   return 0;
+}
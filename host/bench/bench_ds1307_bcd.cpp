@@ -0,0 +1,98 @@
+// bench_ds1307_bcd - Instruction cycles of the DS1307.c BCD conversions,
+// arithmetic against lookup tables
+//
+// Only bin2bcd() gains from its table. The shift and add of bcd2bin()
+// is cheaper than a table read behind a range test, on its own and for
+// the 7 registers of a burst, so DS1307.c keeps it on the read path; the
+// table columns of bcd2bin are what a table would cost.
+//
+// The host build does not run PIC code, so the cycles are estimated from
+// the PIC18 code CCS generates for each version, one cycle an
+// instruction and two for a taken branch, CALL, RETURN, MOVFF or TBLRD:
+//
+//    old bin2bcd     CALL/RETURN 4, MOVFF/CLRF 3, exit test 4, result 1,
+//                    then 12 a loop pass: zero test 3, >= 10 test 3 and
+//                    subtract 6 (tens) or add the rest 6 (ones)
+//    bcd2bin         CALL/RETURN 4, argument 1, shift and mask 4,
+//                    tens * 2 and add 5, ones 3
+//    table read      index 1, TBLPTR setup 5, TBLRD and TABLAT 3, CALL/
+//                    RETURN of the CCS stub 4, result 1
+//    table convert   CALL/RETURN 4, argument 1, range test 3, table read
+//    table burst     loop test 4, mask table read, AND 1, range test 3,
+//                    table read, store through FSR 4 a register
+//
+// The loop passes of the old bin2bcd are counted by a copy of its loop.
+// Its average is over 0-99, and for rtc_set_date_time() over the range
+// of every field. For a burst rtc_get_datetime() masks inline and calls
+// bcd2bin() per register.
+
+#include "ccs.h"
+#include "bench.h"
+
+#include "rtc_communication.c"
+#include "ds1307.c"
+
+#define CALL_RET      4
+#define TABLE_READ    14
+#define OLD_B2B_BASE  12
+#define OLD_B2B_PASS  12
+#define B2B_SEC       (CALL_RET + 1 + 4 + 5 + 3)
+#define NEW_CONVERT   (CALL_RET + 1 + 3 + TABLE_READ)
+#define NEW_REG       (4 + TABLE_READ + 1 + 3 + TABLE_READ + 4)
+
+// Loop passes of the repeated subtraction, as in the base revision
+static int old_bin2bcd_passes(BYTE v) {
+   int passes = 0;
+   BYTE temp = v;
+   while(temp > 0) {
+      temp = temp >= 10 ? temp - 10 : 0;
+      passes++;
+   }
+   return passes;
+}
+
+static double old_bin2bcd(BYTE v) {
+   return OLD_B2B_BASE + OLD_B2B_PASS * old_bin2bcd_passes(v);
+}
+
+int main( void ) {
+   Samples old_b2b, new_b2b;
+   Json json;
+   int v;
+
+   for(v = 0; v < 100; v++) {
+      old_b2b.add(old_bin2bcd(v));
+      new_b2b.add(NEW_CONVERT);
+   }
+
+   json.begin();
+   json.str("benchmark", "ds1307_bcd");
+   json.str("cycles", "estimated, PIC18");
+   json.begin("bin2bcd");
+   json.num("old_mean", old_b2b.mean());
+   json.num("old_max", old_b2b.max());
+   json.num("old_min", old_b2b.min());
+   json.num("table", NEW_CONVERT);
+   json.end();
+   json.begin("bcd2bin");
+   json.num("shift_add", B2B_SEC);
+   json.num("table", NEW_CONVERT);
+   json.end();
+   json.begin("burst_7_registers");
+   json.num("shift_add", 7 * (B2B_SEC + 1));
+   json.num("table", CALL_RET + 1 + 7 * NEW_REG);
+   json.end();
+   json.begin("rtc_set_date_time_7_fields");
+   double old_set = 0;
+   for(v = 0; v < 60; v++) old_set += 2 * old_bin2bcd(v) / 60;     // sec, min
+   for(v = 0; v < 24; v++) old_set += old_bin2bcd(v) / 24;          // hour
+   for(v = 1; v <= 7; v++) old_set += old_bin2bcd(v) / 7;           // dow
+   for(v = 1; v <= 31; v++) old_set += old_bin2bcd(v) / 31;         // day
+   for(v = 1; v <= 12; v++) old_set += old_bin2bcd(v) / 12;         // mth
+   for(v = 0; v < 100; v++) old_set += old_bin2bcd(v) / 100;        // year
+   json.num("old_mean", old_set);
+   json.num("table", 7 * NEW_CONVERT);
+   json.end();
+   json.end();
+   return 0;
+}
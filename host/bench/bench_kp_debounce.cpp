@@ -0,0 +1,112 @@
+// bench_kp_debounce - Polled against interrupt driven keypad scanning
+//
+// The same 200 scripted presses, with up to 10 ms of contact bounce, are
+// read by a main loop that asks the driver for a press and then is busy
+// for a while, with the polled scanner of KP4X4.c and with the KP_ISR
+// one. For every busy time it reports the presses read, the missed ones,
+// the extra ones (bounces read as presses) and the worst delay from a
+// press to the call that returned it.
+
+#include "ccs.h"
+#include "bench.h"
+#include "kp_script.h"
+
+#define KP_ISR
+namespace kp_isr {
+#include "kp4x4.c"
+}
+
+namespace kp_polled {
+void kp_init( void );
+uint8_t kp_getn( bool keydown );
+}
+
+#define PRESSES 200
+
+struct Result {
+   int read = 0, missed = 0, extra = 0;
+   Samples delay_ms;
+   uint64_t interrupts = 0;
+   double seconds;
+};
+
+// Matches the keys read with the script, in order
+static void score(Result &r, const Keypad &pad,
+                  const std::vector<std::pair<int,SimTime>> &keys) {
+   size_t k = 0;
+   r.read = keys.size();
+   for(const Keypad::Press &p : pad.presses) {
+      size_t j = k;
+      while(j < keys.size() && (keys[j].first != p.key || keys[j].second < p.down)) {
+         j++;
+      }
+      if(j == keys.size() || keys[j].second > p.up + 500 * SIM_MS) {
+         r.missed++;
+         continue;
+      }
+      r.delay_ms.add((keys[j].second - p.down) / (double)SIM_MS);
+      r.extra += j - k;
+      k = j + 1;
+   }
+   r.extra += keys.size() - k;
+}
+
+static Result run(bool isr, unsigned busy_ms) {
+   Result r;
+   Cpu board;
+   Keypad pad;
+   KpScript script(30);
+   std::vector<std::pair<int,SimTime>> keys;
+   CpuScope scope(board);
+
+   board.pin_devices.push_back(&pad);
+   board.program = isr ? 0 : 1;
+   SimTime end = script.presses(pad, PRESSES, 10 * SIM_MS, 10) + SIM_SEC;
+
+   if(isr) {
+      kp_isr::kp_init();
+      enable_interrupts(GLOBAL);
+   } else {
+      kp_polled::kp_init();
+   }
+   while(board.now < end) {
+      uint8_t key = isr ? kp_isr::kp_get_key(true) : kp_polled::kp_getn(true);
+      if(key != NOKEYPRESS) {
+         keys.push_back({ isr ? key : (int)(std::find(kp_isr::numkeys,
+                          kp_isr::numkeys + 16, key) - kp_isr::numkeys), board.now });
+      }
+      delay_ms(busy_ms);
+   }
+   score(r, pad, keys);
+   r.interrupts = board.isr_calls[INT_TIMER2];
+   r.seconds = board.now / (double)SIM_SEC;
+   return r;
+}
+
+int main( void ) {
+   static const unsigned busy[] = { 1, 10, 50, 100, 200 };
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "kp_debounce");
+   json.num("presses", PRESSES);
+   json.array("main_loops");
+   for(unsigned b : busy) {
+      json.begin();
+      json.num("busy_ms", b);
+      for(int isr = 0; isr < 2; isr++) {
+         Result r = run(isr, b);
+         json.begin(isr ? "isr" : "polled");
+         json.num("read", r.read);
+         json.num("missed", r.missed);
+         json.num("extra", r.extra);
+         json.num("max_delay_ms", r.delay_ms.max());
+         json.num("interrupts_per_s", r.interrupts / r.seconds);
+         json.end();
+      }
+      json.end();
+   }
+   json.end_array();
+   json.end();
+   return 0;
+}
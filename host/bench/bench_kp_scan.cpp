@@ -0,0 +1,128 @@
+// bench_kp_scan - PORTD traffic and cycles of the nested and the table
+// driven scan
+//
+// Scans the keypad with no key, every key and every pair of keys down,
+// with kp_scan_raw() and with the nested scan it replaced, and reports
+// the PORTD reads and LATD writes per scan and the scans that disagree.
+//
+// The host build does not run PIC code, so the cycles are estimated from
+// the PIC18 code CCS generates for each scan, one cycle an instruction
+// and two for a taken branch, CALL, RETURN, GOTO or TBLRD:
+//
+//    scan call       CALL/RETURN 4, key = NOKEYPRESS 2, result 1
+//    loop pass       increment 1, test and branch 3, GOTO 2
+//    table row       kp_rows[] table read 14, LATD 1, settle NOP 1, kp.col
+//                    read and mask 2, kp_cols[] table read 14, col 1,
+//                    NOKEYPRESS test 3
+//    nested row      0b11110111 >> row 5 and 5 a shifted bit, nibble to
+//                    the upper half and read-modify-write of PORTD 7
+//    nested column   0b11110111 >> col 5 and 5 a shifted bit, PORTD read
+//                    and mask 2, pattern mask 1, compare 3
+//    key found       (row << 2) + col or row * 4 + col 5
+//
+// Both scans find a key in the rows with exactly one key down.
+
+#include "ccs.h"
+#include "bench.h"
+#include "kp_old_scan.h"
+
+namespace kp_polled {
+#include "kp4x4.c"
+}
+
+#define SCAN_CALL    (4 + 2 + 1)
+#define LOOP_PASS    (1 + 3 + 2)
+#define TABLE_READ   14
+#define TABLE_ROW    (TABLE_READ + 1 + 1 + 2 + TABLE_READ + 1 + 3)
+#define SHIFT        5
+#define SHIFT_BIT    5
+#define NESTED_ROW   (SHIFT + 7)
+#define NESTED_COL   (SHIFT + 2 + 1 + 3)
+#define KEY_FOUND    5
+
+struct Result {
+   uint64_t scans = 0, reads = 0, writes = 0, cycles = 0;
+};
+
+static unsigned table_cycles(int found) {
+   return SCAN_CALL + 4 * (LOOP_PASS + TABLE_ROW) + found * KEY_FOUND;
+}
+
+static unsigned nested_cycles(int found) {
+   unsigned cycles = SCAN_CALL + found * KEY_FOUND;
+   for(int row = 0; row < 4; row++) {
+      cycles += LOOP_PASS + NESTED_ROW + SHIFT_BIT * row;
+      for(int col = 0; col < 4; col++) {
+         cycles += LOOP_PASS + NESTED_COL + SHIFT_BIT * col;
+      }
+   }
+   return cycles;
+}
+
+// Rows with exactly one of a and b down
+static int rows_found(int a, int b) {
+   if(a < 0) {
+      return 0;
+   }
+   if(b <= a) {
+      return 1;
+   }
+   return a / 4 == b / 4 ? 0 : 2;
+}
+
+int main( void ) {
+   Cpu board;
+   Keypad pad;
+   Result table, nested;
+   int differ = 0;
+   CpuScope scope(board);
+
+   board.pin_devices.push_back(&pad);
+   kp_polled::kp_init();
+
+   // a and b down, -1 for none
+   for(int a = -1; a < 16; a++) {
+      for(int b = (a < 0) ? a : a + 1; b < 16; b++) {
+         pad.presses.clear();
+         if(a >= 0) {
+            pad.press(a, board.now, SIM_MS);
+         }
+         if(b > a) {
+            pad.press(b, board.now, SIM_MS);
+         }
+
+         board.port_reads[3] = board.lat_writes[3] = 0;
+         uint8_t key = kp_polled::kp_scan_raw();
+         table.scans++;
+         table.reads += board.port_reads[3];
+         table.writes += board.lat_writes[3];
+         table.cycles += table_cycles(rows_found(a, b));
+
+         board.port_reads[3] = board.lat_writes[3] = 0;
+         differ += key != kp_old_scan();
+         nested.scans++;
+         nested.reads += board.port_reads[3];
+         nested.writes += board.lat_writes[3];
+         nested.cycles += nested_cycles(rows_found(a, b));
+      }
+   }
+
+   Json json;
+   json.begin();
+   json.str("benchmark", "kp_scan");
+   json.num("key_states", table.scans);
+   json.num("different_keys", differ);
+   json.str("cycles", "estimated, PIC18");
+   json.begin("nested");
+   json.num("portd_reads_per_scan", nested.reads / (double)nested.scans);
+   json.num("latd_writes_per_scan", nested.writes / (double)nested.scans);
+   json.num("cycles_per_scan", nested.cycles / (double)nested.scans);
+   json.end();
+   json.begin("table");
+   json.num("portd_reads_per_scan", table.reads / (double)table.scans);
+   json.num("latd_writes_per_scan", table.writes / (double)table.scans);
+   json.num("cycles_per_scan", table.cycles / (double)table.scans);
+   json.end();
+   json.end();
+   return 0;
+}
@@ -0,0 +1,185 @@
+// bench_lcd_cps - Characters per second of the HD44780 drivers on the
+// controller model
+//
+// The stock LCD420.c (include/LCD420.c) waits a fixed 50 us after every
+// byte and 2 ms after a clear, HD44780.c reads the busy flag and sends
+// the next byte as soon as the controller takes it, and HD44780.c with
+// LCD_QUEUED leaves the bytes to lcd_drain() on the 10 ms tick, with the
+// 128 byte queue of the RTC master. Each one runs on a 5 MHz board and
+// writes:
+//
+//    stream    100 screens of 4 lines of 20 characters, each line after
+//              an lcd_gotoxy()
+//    redraw    100 times '\f' and the same screen
+//
+// The queued driver drops what does not fit in the queue, so the main
+// code waits for it to empty after every screen, as a program that
+// redraws a whole screen has to; the wait is not counted as time in the
+// calls.
+//
+// Reports the characters per second the controller receives until the
+// last byte is done, the time the main code spends in the calls, the
+// most busy flag reads of an lcd_drain() and the dropped bytes, and
+// checks no byte reached the controller while it was busy and the last
+// screen is on the LCD.
+
+#define HOST_CLOCK 5000000
+
+#include "ccs.h"
+#include "bench.h"
+
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 0
+namespace fixed {
+#include "LCD420.c"
+}
+
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 1
+namespace busy {
+#include "hd44780.c"
+}
+
+static void drain_tick( void );
+
+#undef lcd_write
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 2
+#define LCD_QUEUED
+#define LCD_QUEUE  128
+namespace queued {
+#include "hd44780.c"
+#define TICK_ON_CS()  drain_tick()
+#include "tick.c"
+}
+
+#define SCREENS  100
+
+struct Driver {
+   const char *name;
+   int program;
+   void (*init)( void );
+   void (*gotoxy)(BYTE, BYTE);
+   void (*putc)(char);
+   bool queued;
+};
+
+static const Driver drivers[] = {
+   { "lcd420", 0, fixed::lcd_init, fixed::lcd_gotoxy, fixed::lcd_putc, false },
+   { "busy_flag", 1, busy::lcd_init, busy::lcd_gotoxy, busy::lcd_putc, false },
+   { "queued", 2, queued::lcd_init, queued::lcd_gotoxy, queued::lcd_putc, true },
+};
+
+struct Result {
+   double chars_per_s, bytes_per_s, main_ms, total_ms;
+   uint64_t busy_writes, drain_reads, dropped;
+   bool screen_ok;
+};
+
+static Hd44780 *model;
+static uint64_t most_reads;     // Status reads of the busiest lcd_drain()
+
+static void drain_tick( void ) {
+   uint64_t reads = model->status_reads;
+   queued::lcd_drain();
+   most_reads = std::max(most_reads, model->status_reads - reads);
+}
+
+// Until the queue is sent, returns the time waited
+static SimTime wait_queue(const Driver &d) {
+   SimTime start = cpu->now;
+   while(d.queued && queued::lcd_tail != queued::lcd_head) {
+      cpu->wait(SIM_MS);
+   }
+   return cpu->now - start;
+}
+
+static char text(int screen, int y, int x) {
+   return 'A' + (screen + y * 3 + x) % 26;
+}
+
+static Result run(const Driver &d, bool clear) {
+   Cpu board;
+   CpuScope scope(board);
+   Hd44780 lcd{1, 4, 20};
+   Result r;
+   SimTime start, waited = 0;
+   int s, y, x;
+
+   board.program = d.program;
+   board.clock = HOST_CLOCK;
+   board.pin_devices.push_back(&lcd);
+   model = &lcd;
+   d.init();
+   if(d.queued) {
+      queued::lcd_dropped = 0;
+      queued::tick_init();
+   }
+   board.wait(10 * SIM_MS);
+   lcd.reset_counters();
+   most_reads = 0;
+
+   start = board.now;
+   for(s = 0; s < SCREENS; s++) {
+      if(clear) {
+         d.putc('\f');
+      }
+      for(y = 1; y <= 4; y++) {
+         d.gotoxy(1, y);
+         for(x = 0; x < 20; x++) {
+            d.putc(text(s, y, x));
+         }
+      }
+      waited += wait_queue(d);
+   }
+
+   // Until the last instruction is done
+   board.advance(std::max(board.now, lcd.busy_until));
+
+   double seconds = (board.now - start) / (double)SIM_SEC;
+   r.chars_per_s = lcd.data_writes / seconds;
+   r.bytes_per_s = lcd.bytes() / seconds;
+   r.main_ms = (board.now - start - waited) / (double)SIM_MS;
+   r.total_ms = (board.now - start) / (double)SIM_MS;
+   r.busy_writes = lcd.busy_writes;
+   r.drain_reads = most_reads;
+   r.dropped = d.queued ? queued::lcd_dropped : 0;
+   r.screen_ok = true;
+   for(y = 1; y <= 4; y++) {
+      for(x = 0; x < 20; x++) {
+         r.screen_ok &= lcd.line(y)[x] == text(SCREENS - 1, y, x);
+      }
+   }
+   return r;
+}
+
+int main( void ) {
+   Json json;
+   bool ok = true;
+
+   json.begin();
+   json.str("benchmark", "lcd_cps");
+   json.num("clock_hz", HOST_CLOCK);
+   for(const Driver &d : drivers) {
+      json.begin(d.name);
+      for(int clear = 0; clear < 2; clear++) {
+         Result r = run(d, clear);
+         json.begin(clear ? "redraw" : "stream");
+         json.num("chars_per_s", r.chars_per_s);
+         json.num("bytes_per_s", r.bytes_per_s);
+         json.num("main_ms", r.main_ms);
+         json.num("total_ms", r.total_ms);
+         json.num("busy_writes", r.busy_writes);
+         if(d.queued) {
+            json.num("drain_status_reads_max", r.drain_reads);
+            json.num("dropped", r.dropped);
+         }
+         json.boolean("screen_ok", r.screen_ok);
+         json.end();
+         ok &= r.busy_writes == 0 && r.dropped == 0 && r.screen_ok;
+      }
+      json.end();
+   }
+   json.end();
+   return ok ? 0 : 1;
+}
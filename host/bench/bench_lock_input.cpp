@@ -0,0 +1,259 @@
+// bench_lock_input - Input latency of the RELAY/LOCK.c state machine
+//
+// A scripted user drives the lock through a whole session: the master
+// password is created, three wrong passwords start the 30 s lockout,
+// the right one opens the relay, which is closed with a key once and
+// left to its hold time once, and a second password is added and used.
+// Keys are also pressed while the lock validates and counts down, where
+// they must be ignored. Every press has 3 ms of contact bounce.
+//
+// The user waits for the screens on the LCD, so the script follows the
+// lock whatever its timing. For every key the lock must take, it reports
+// the time from the key going down to its reaction: the key echoed on
+// the LCD, the next screen for '#' and the relay closing in the open
+// state, sampled every millisecond. Also reports the longest gap between
+// two updates of the lockout countdown and the time the relay stayed
+// open.
+
+#include "ccs.h"
+#include "bench.h"
+
+#include <deque>
+
+namespace lock {
+#include "lock.c"
+}
+
+#define HOLD_MS    60
+#define GAP_MS     250
+#define BOUNCE_MS  3
+
+static const char keys[] = "123A456B789C*0#D";
+
+struct Reaction {
+   SimTime down;
+   char echo;             // Character on the LCD, 0 any, 'R' relay closes
+   Samples *samples;
+};
+
+struct Bench {
+   Cpu board, user;
+   Hd44780 lcd{1, 4, 20};
+   Keypad pad;
+   Eeprom24 eeprom{1024};
+
+   std::deque<Reaction> pending;
+   Samples echo, submit, relay;
+   int ignored = 0, unexpected = 0;
+   bool relay_on = false;
+   SimTime relay_since = 0;
+   Samples relay_open_ms;
+   SimTime countdown_gap = 0;
+   bool opened_after_lockout = false, opened_new = false;
+
+   Bench() {
+      board.name = "lock";
+      board.pin_devices.push_back(&lcd);
+      board.pin_devices.push_back(&pad);
+      board.i2c.devices.push_back(&eeprom);
+      user.name = "user";
+      lcd.on_data = [this](uint8_t c) { data(c); };
+   }
+
+   void data(uint8_t c) {
+      if(pending.empty() || pending.front().echo == 'R') {
+         return;
+      }
+      Reaction &r = pending.front();
+      if(r.echo && r.echo != c) {
+         unexpected++;
+         return;
+      }
+      r.samples->add((board.now - r.down) / (double)SIM_US);
+      pending.pop_front();
+   }
+
+   // Relay on RC0, sampled by the user every millisecond
+   void sample_relay() {
+      bool on = board.lat[2] & 1;
+      if(on == relay_on) {
+         return;
+      }
+      relay_on = on;
+      if(on) {
+         relay_since = user.now;
+         return;
+      }
+      relay_open_ms.add((user.now - relay_since) / (double)SIM_MS);
+      if(!pending.empty() && pending.front().echo == 'R') {
+         relay.add((user.now - pending.front().down) / (double)SIM_US);
+         pending.pop_front();
+      }
+   }
+
+   void wait_ms(unsigned ms) {
+      for(unsigned i = 0; i < ms; i++) {
+         user.wait(SIM_MS);
+         sample_relay();
+      }
+   }
+
+   bool shows(int line, const char *text) {
+      return lcd.line(line).find(text) != std::string::npos;
+   }
+
+   // Waits up to limit ms for a text on a line
+   bool wait_for(int line, const char *text, unsigned limit = 5000) {
+      for(unsigned i = 0; i < limit; i++) {
+         if(shows(line, text)) {
+            return true;
+         }
+         wait_ms(1);
+      }
+      fprintf(stderr, "bench_lock_input: no \"%s\" on line %d\n", text, line);
+      return false;
+   }
+
+   // Waits for the empty screen of the password entry
+   bool wait_enter(unsigned limit = 5000) {
+      for(unsigned i = 0; i < limit; i++) {
+         if(lcd.line(1) + lcd.line(2) + lcd.line(3) + lcd.line(4) ==
+            std::string(80, ' ')) {
+            return true;
+         }
+         wait_ms(1);
+      }
+      fprintf(stderr, "bench_lock_input: no password entry screen\n");
+      return false;
+   }
+
+   // Presses a key, its reaction expected or none
+   void tap(char key, bool expected, char echo, Samples *samples) {
+      int index = strchr(keys, key) - keys;
+      pad.press(index, user.now, HOLD_MS * SIM_MS, BOUNCE_MS * SIM_MS);
+      if(expected) {
+         pending.push_back({ user.now, echo, samples });
+      } else {
+         ignored++;
+      }
+   }
+
+   void press(char key, bool expected, char echo, Samples *samples) {
+      tap(key, expected, echo, samples);
+      wait_ms(GAP_MS);
+   }
+
+   // A password ended by '#'
+   void type(const char *text) {
+      for(const char *t = text; *t; t++) {
+         press(*t, true, *t, &echo);
+      }
+      press('#', true, 0, &submit);
+   }
+
+   void wrong( void ) {
+      wait_enter();
+      type("1111");
+      wait_for(2, "Validating");
+      press('5', false, 0, nullptr);
+      wait_for(2, "Invalid Password");
+   }
+
+   void session( void ) {
+      // Master password
+      wait_for(2, "Create New Password");
+      type("1234");
+      wait_for(2, "Saved Password");
+      wait_enter();
+
+      // Three wrong ones start the lockout, the countdown keeps going
+      // while keys are pressed
+      wrong();
+      wrong();
+      wrong();
+      wait_for(3, "Try again in");
+      std::string last = lcd.line(3);
+      SimTime changed = user.now, next_key = user.now + 1500 * SIM_MS;
+      while(shows(3, "Try again in") && user.now < changed + 2 * SIM_SEC) {
+         if(user.now >= next_key) {
+            tap('7', false, 0, nullptr);
+            next_key += 3 * SIM_SEC;
+         }
+         if(lcd.line(3) != last) {
+            last = lcd.line(3);
+            countdown_gap = std::max(countdown_gap, user.now - changed);
+            changed = user.now;
+         }
+         wait_ms(1);
+      }
+
+      // Opened, closed with a key
+      wait_enter(40000);
+      type("1234");
+      opened_after_lockout = wait_for(2, "Correct Password");
+      wait_ms(2000);
+      press('5', true, 'R', nullptr);
+      wait_ms(500);
+
+      // Opened, closed by the hold time (5 s)
+      wait_enter();
+      type("1234");
+      wait_for(2, "Correct Password");
+      wait_ms(6000);
+
+      // A second password, 2 s hold time
+      wait_enter();
+      type("1234");
+      wait_for(2, "Correct Password");
+      press('A', true, 0, &submit);
+      wait_for(2, "Add Password");
+      type("5678");
+      wait_for(2, "Hold Time");
+      press('2', true, 0, &submit);
+      wait_for(4, "Saved");
+      wait_enter();
+      type("5678");
+      opened_new = wait_for(2, "Correct Password");
+      wait_ms(3000);
+
+      user.sim->end = user.now;
+   }
+};
+
+int main( void ) {
+   Bench b;
+   Json json;
+
+   Sim sim(600 * SIM_SEC);
+   sim.add(b.board, lock::program_main);
+   sim.add(b.user, [&]() { b.session(); });
+   sim.run();
+
+   Samples all;
+   for(Samples *s : { &b.echo, &b.submit, &b.relay }) {
+      for(double v : s->values) {
+         all.add(v);
+      }
+   }
+
+   json.begin();
+   json.str("benchmark", "lock_input");
+   json.num("session_s", b.user.now / (double)SIM_SEC);
+   json.num("worst_input_latency_us", all.max());
+   json.percentiles("echo_us", b.echo);
+   json.percentiles("submit_us", b.submit);
+   json.percentiles("relay_close_us", b.relay);
+   json.num("missed", b.pending.size());
+   json.num("unexpected_chars", b.unexpected);
+   json.num("ignored_presses", b.ignored);
+   json.num("countdown_max_gap_ms", b.countdown_gap / (double)SIM_MS);
+   json.array("relay_open_ms");
+   for(double v : b.relay_open_ms.values) {
+      json.num(nullptr, v);
+   }
+   json.end_array();
+   json.boolean("opened_after_lockout", b.opened_after_lockout);
+   json.boolean("opened_with_new_password", b.opened_new);
+   json.end();
+   return b.pending.empty() && b.opened_after_lockout && b.opened_new ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+// bench_pos_link - Replay of the POS master traffic against the slave
+//
+// The real slave program runs on its board (pos_rig.h) and the commands
+// of the master are replayed with the functions of POS_COMMUNICATION.c.
+// The same session, a new product checked and saved then a sale that
+// browses 10 products and adds 3 of them, is replayed in the two
+// protocols of POS_MASTER.c:
+//
+//    per_screen  The original master: check_Product() asks ProdNum and
+//                downloads every product 10 ms apart, selectProducts()
+//                asks ProdNum and a SendProd for every product shown.
+//    snapshot    The catalog is downloaded once at power up and every
+//                screen only checks the CatalogGen of the slave, with 20
+//                more menu entries.
+//
+// For every catalog size it reports the bytes on the wire, the round
+// trips, the I2C and EEPROM traffic of the slave and the latency
+// percentiles of every command, from the command byte to the return of
+// the master function or to its last byte leaving the UART, whichever is
+// later.
+
+#include "ccs.h"
+#include "bench.h"
+#include "pos_rig.h"
+
+namespace master {
+#include "pos_communication.c"
+}
+
+static const char *command_names[] = {
+   "ProdNum", "SendProd", "ReceiveProd", "SaveProd", "PrintMessage",
+   "ClearScreen", "LinkStats", "DumpProfile", "CatalogGen"
+};
+#define COMMANDS 9
+
+struct Result {
+   int products;
+   uint64_t trips = 0;
+   uint64_t master_tx, slave_tx;
+   uint64_t i2c_transactions, i2c_bytes;
+   uint64_t write_cycles, read_bytes, busy_polls;
+   uint64_t lost_bytes;
+   int failed = 0;
+   double seconds;
+   Samples latency[COMMANDS];
+};
+
+// Times a command from its first byte to the end of fn
+template<class F> void timed(Result &r, int command, F fn) {
+   SimTime start = cpu->now;
+   master::send_command(command);
+   r.trips++;
+   fn();
+   SimTime done = std::max(cpu->now, cpu->uart.tx_done);
+   r.latency[command].add((done - start) / (double)SIM_US);
+}
+
+// Client messages of a sale, one for every added product
+static void sale_messages(Result &r) {
+   using namespace master;
+
+   for(int i = 0; i < 3; i++) {
+      timed(r, PrintMessage, [&]() {
+         ccs_printf(link_putc," %02u %s\n $  %lu.00%c%c", 1, "ITEM000001", 38, 0, 13);
+      });
+      delay_ms(200);
+   }
+}
+
+// A new product, when it fits
+static void save(Result &r, int num) {
+   using namespace master;
+   Product prod;
+
+   if(num >= POS_CATALOG_MAX) {
+      return;
+   }
+   strcpy(prod.sku, "900000");
+   strcpy(prod.name, "NEWPRODUCT");
+   prod.price = 125;
+   timed(r, SaveProd, [&]() {
+      if(!send_product(prod)) {
+         r.failed++;
+      }
+   });
+   delay_ms(200);
+}
+
+// The original master, the catalog read again on every screen
+static void replay_per_screen(Result &r) {
+   using namespace master;
+   Product prod;
+   int num;
+   int i;
+
+   // Slave boot
+   delay_ms(100);
+
+   // check_Product() of the new product, no product is the same
+   timed(r, ProdNum, [&]() { num = link_getc(); });
+   for(i = 0; i < num; i++) {
+      delay_ms(10);
+      timed(r, SendProd, [&]() {
+         link_putc(i);
+         if(!receive_product(prod)) {
+            r.failed++;
+         }
+      });
+   }
+   save(r, num);
+
+   // selectProducts(), a product shown every 500 ms
+   timed(r, ProdNum, [&]() { num = link_getc(); });
+   for(i = 0; i < 10; i++) {
+      delay_us(100);
+      timed(r, SendProd, [&]() {
+         link_putc(i % num);
+         if(!receive_product(prod)) {
+            r.failed++;
+         }
+      });
+      delay_ms(500);
+   }
+   sale_messages(r);
+   timed(r, ClearScreen, [&]() {});
+   delay_ms(50);
+}
+
+// The current master, a snapshot of the catalog checked by generation
+static void replay_snapshot(Result &r) {
+   using namespace master;
+   Product prod;
+   int num;
+   int i;
+
+   // Slave boot
+   delay_ms(100);
+
+   // sync_Catalog() at power up
+   timed(r, CatalogGen, [&]() { link_getc(); });
+   timed(r, ProdNum, [&]() { num = link_getc(); });
+   for(i = 0; i < num; i++) {
+      delay_ms(10);
+      timed(r, SendProd, [&]() {
+         link_putc(i);
+         if(!receive_product(prod)) {
+            r.failed++;
+         }
+      });
+   }
+
+   // Menu entries, the snapshot is still valid
+   for(i = 0; i < 20; i++) {
+      timed(r, CatalogGen, [&]() { link_getc(); });
+      delay_ms(50);
+   }
+
+   // check_Product() and the save, which keeps the snapshot valid
+   timed(r, CatalogGen, [&]() { link_getc(); });
+   save(r, num);
+
+   // selectProducts(), the products are shown from the snapshot
+   timed(r, CatalogGen, [&]() { link_getc(); });
+   delay_ms(10 * 500);
+   sale_messages(r);
+   timed(r, ClearScreen, [&]() {});
+   delay_ms(50);
+}
+
+static Result run(int products, bool per_screen) {
+   Result r;
+   PosSlaveRig slave;
+   Cpu master;
+
+   r.products = products;
+   master.name = "master";
+   master.clock = 5000000;
+   slave.seed(products);
+   slave.connect(master);
+
+   Sim sim(600 * SIM_SEC);
+   sim.add(slave.cpu, pos_slave::program_main);
+   sim.add(master, [&]() {
+      per_screen ? replay_per_screen(r) : replay_snapshot(r);
+      r.seconds = cpu->now / (double)SIM_SEC;
+      cpu->sim->end = cpu->now;     // Stops the slave too
+   });
+   sim.run();
+
+   r.master_tx = master.uart.tx_bytes;
+   r.slave_tx = slave.cpu.uart.tx_bytes;
+   r.lost_bytes = master.uart.overruns + slave.cpu.uart.overruns;
+   r.i2c_transactions = slave.cpu.i2c.transactions;
+   r.i2c_bytes = slave.cpu.i2c.bytes;
+   r.write_cycles = slave.eeprom.write_cycles;
+   r.read_bytes = slave.eeprom.read_bytes;
+   r.busy_polls = slave.eeprom.busy_polls;
+   return r;
+}
+
+// Runs every catalog size in a protocol
+static void report(Json &json, bool per_screen) {
+   static const int sizes[] = { 1, 5, 10, 15, 20, 25 };
+
+   json.array(per_screen ? "per_screen" : "snapshot");
+   for(int n : sizes) {
+      Result r = run(n, per_screen);
+      json.begin();
+      json.num("products", r.products);
+      json.num("round_trips", r.trips);
+      json.begin("bytes");
+      json.num("master_tx", r.master_tx);
+      json.num("slave_tx", r.slave_tx);
+      json.num("total", r.master_tx + r.slave_tx);
+      json.num("lost", r.lost_bytes);
+      json.end();
+      json.begin("slave_i2c");
+      json.num("transactions", r.i2c_transactions);
+      json.num("bytes", r.i2c_bytes);
+      json.end();
+      json.begin("eeprom");
+      json.num("write_cycles", r.write_cycles);
+      json.num("read_bytes", r.read_bytes);
+      json.num("busy_polls", r.busy_polls);
+      json.end();
+      json.num("failed_products", r.failed);
+      json.num("session_s", r.seconds);
+      json.begin("latency_us");
+      for(int c = 0; c < COMMANDS; c++) {
+         if(r.latency[c].count()) {
+            json.percentiles(command_names[c], r.latency[c]);
+         }
+      }
+      json.end();
+      json.end();
+   }
+   json.end_array();
+}
+
+int main( void ) {
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "pos_link");
+   report(json, true);
+   report(json, false);
+   json.end();
+   return 0;
+}
@@ -0,0 +1,253 @@
+// bench_pos_session - Link round trips per sale, before and after the
+// catalog snapshot of the POS master
+//
+// Replays the commands POS_MASTER.c sends in a session against the real
+// slave program, as the master did before the snapshot (ProdNum on every
+// screen and a SendProd per product shown or checked) and as it does now
+// (a download at power up, then one CatalogGen per screen). A sale shows
+// 8 products, adds 3 of them and takes 1 s of payment screens, a new
+// product is checked against the catalog and saved. Each mode runs from
+// power up through 1 new product and 20 sales.
+
+#include "ccs.h"
+#include "bench.h"
+#include "pos_rig.h"
+
+namespace master {
+#include "pos_communication.c"
+}
+
+using namespace master;
+
+#define SALES         20
+#define SHOWN         8      // Products shown in a sale
+#define ADDED         3      // Products added to a sale
+#define PAY_RENDERS   20     // Payment screens, 50 ms each
+
+struct Counts {
+   uint64_t catalog = 0;      // ProdNum, SendProd and CatalogGen
+   uint64_t messages = 0;     // Every other command
+   uint64_t bytes = 0;
+   double seconds = 0;
+};
+
+struct Result {
+   int products;
+   Counts boot, create, sale;  // sale is the average of the sales
+};
+
+static Counts *counting;
+static Cpu *slave_cpu;
+
+static void command(int cmd) {
+   send_command(cmd);
+   if(cmd == ProdNum || cmd == SendProd || cmd == CatalogGen) {
+      counting->catalog++;
+   } else {
+      counting->messages++;
+   }
+}
+
+static void fetch(int num, Product &prod) {
+   command(SendProd);
+   link_putc(num);
+   receive_product(prod);
+}
+
+// Runs a part of the session and counts its traffic into c
+template<class F> void part(Counts &c, F fn) {
+   uint64_t bytes = cpu->uart.tx_bytes + slave_cpu->uart.tx_bytes;
+   SimTime start = cpu->now;
+   counting = &c;
+   fn();
+   c.bytes += cpu->uart.tx_bytes + slave_cpu->uart.tx_bytes - bytes;
+   c.seconds += (cpu->now - start) / (double)SIM_SEC;
+}
+
+// Messages of a sale, the same in both versions
+static void sale_messages( void ) {
+   int i;
+   for(i = 0; i < ADDED; i++) {
+      command(PrintMessage);
+      ccs_printf(link_putc," %02u %s\n $  %lu.00%c%c", 1, "ITEM000001", 38, 0, 13);
+      delay_ms(500);
+   }
+   for(i = 0; i < PAY_RENDERS; i++) {
+      command(PrintMessage);
+      ccs_printf(link_putc,"TOTAL: $ %lu.00\nPAY:   $ %lu.00%c%c", 114, 200, 0, 13);
+      delay_ms(50);
+   }
+   command(PrintMessage);
+   ccs_printf(link_putc,"Come Back Soon%c%c",0,13);
+   delay_ms(2000);
+   command(ClearScreen);
+}
+
+static void new_product(Product &prod) {
+   strcpy(prod.sku, "900000");
+   strcpy(prod.name, "NEWPRODUCT");
+   prod.price = 125;
+}
+
+/*******        Before the snapshot        *******/
+
+static void session_before(Result &r) {
+   Product prod, comp;
+   int num, i, s;
+
+   delay_ms(100);
+
+   part(r.create, [&]() {
+      // createNewProduct()
+      command(ProdNum);
+      num = link_getc();
+
+      // check_Product()
+      command(ProdNum);
+      num = link_getc();
+      for(i = 0; i < num; i++) {
+         delay_ms(10);
+         fetch(i, comp);
+      }
+      new_product(prod);
+      command(SaveProd);
+      send_product(prod);
+      delay_ms(2000);
+   });
+
+   for(s = 0; s < SALES; s++) {
+      part(r.sale, [&]() {
+         // selectProducts()
+         command(ProdNum);
+         num = link_getc();
+         for(i = 0; i < SHOWN; i++) {
+            delay_us(100);
+            fetch(i % num, prod);
+            delay_ms(300);
+         }
+         sale_messages();
+      });
+   }
+}
+
+/*******         After the snapshot        *******/
+
+static uint8_t catalog_gen;
+static bool catalog_valid;
+
+// sync_Catalog() of POS_MASTER.c
+static void sync( void ) {
+   Product prod;
+   int gen, num, i;
+
+   command(CatalogGen);
+   gen = link_getc();
+   if(catalog_valid && gen == catalog_gen) {
+      return;
+   }
+   command(ProdNum);
+   num = link_getc();
+   catalog_valid = true;
+   for(i = 0; i < num; i++) {
+      delay_ms(10);
+      fetch(i, prod);
+   }
+   catalog_gen = gen;
+}
+
+static void session_after(Result &r) {
+   Product prod;
+   int s, i;
+
+   catalog_valid = false;
+   delay_ms(100);
+
+   part(r.boot, [&]() { sync(); });
+
+   part(r.create, [&]() {
+      sync();      // createNewProduct()
+      sync();      // check_Product()
+      new_product(prod);
+      command(SaveProd);
+      send_product(prod);
+      catalog_gen++;     // catalog_Add()
+      delay_ms(2000);
+   });
+
+   for(s = 0; s < SALES; s++) {
+      part(r.sale, [&]() {
+         sync();   // selectProducts()
+         for(i = 0; i < SHOWN; i++) {
+            delay_ms(300);
+         }
+         sale_messages();
+      });
+   }
+}
+
+static Result run(int products, bool after) {
+   Result r;
+   PosSlaveRig slave;
+   Cpu m;
+
+   r.products = products;
+   m.name = "master";
+   m.clock = 5000000;
+   slave.seed(products);
+   slave.connect(m);
+   slave_cpu = &slave.cpu;
+
+   Sim sim(3600 * SIM_SEC);
+   sim.add(slave.cpu, pos_slave::program_main);
+   sim.add(m, [&]() {
+      after ? session_after(r) : session_before(r);
+      cpu->sim->end = cpu->now;
+   });
+   sim.run();
+
+   r.sale.catalog /= SALES;
+   r.sale.messages /= SALES;
+   r.sale.bytes /= SALES;
+   r.sale.seconds /= SALES;
+   return r;
+}
+
+static void counts(Json &json, const char *key, const Counts &c) {
+   json.begin(key);
+   json.num("catalog_trips", c.catalog);
+   json.num("message_trips", c.messages);
+   json.num("round_trips", c.catalog + c.messages);
+   json.num("bytes", c.bytes);
+   json.num("seconds", c.seconds);
+   json.end();
+}
+
+int main( void ) {
+   static const int sizes[] = { 10, 24 };
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "pos_session");
+   json.num("sales", SALES);
+   json.array("catalogs");
+   for(int n : sizes) {
+      json.begin();
+      json.num("products", n);
+      for(int after = 0; after < 2; after++) {
+         Result r = run(n, after);
+         uint64_t total = r.boot.catalog + r.boot.messages +
+                          r.create.catalog + r.create.messages +
+                          SALES * (r.sale.catalog + r.sale.messages);
+         json.begin(after ? "after" : "before");
+         counts(json, "boot", r.boot);
+         counts(json, "new_product", r.create);
+         counts(json, "per_sale", r.sale);
+         json.num("session_round_trips", total);
+         json.end();
+      }
+      json.end();
+   }
+   json.end_array();
+   json.end();
+   return 0;
+}
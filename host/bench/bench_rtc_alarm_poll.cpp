@@ -0,0 +1,150 @@
+// bench_rtc_alarm_poll - Slave I2C traffic of a polling master, alarm
+// read from the EEPROM against the RAM cache
+//
+// A scripted master polls the RTC slave back to back for a minute, as
+// the master of the base revision did on every pass of its main loop:
+// SendAlarm alone, then SendDate, SendTime and SendAlarm. It runs against
+// the slave of the base revision, which read the alarm from the 24LC04B
+// on every SendAlarm, and the current one, which answers from RAM. Then
+// it sends ReceiveAlarm ten times with the value already saved. Reports
+// polls and I2C transactions per minute, split by device, and the EEPROM
+// write cycles. Pushed frames of the current slave are skipped.
+
+#include "ccs.h"
+#include "bench.h"
+#include "rtc_rig.h"
+
+#define BOOT     SIM_SEC
+#define MEASURE  (60 * SIM_SEC)
+#define START    secs_from_civil(2024, 3, 14, 9, 26, 50)
+
+// Commands of RTC_COMMUNICATION.c, the same in both revisions
+#define SEND_DATE      0
+#define SEND_TIME      1
+#define SEND_ALARM     2
+#define RECEIVE_ALARM  5
+
+struct Traffic {
+   uint64_t polls, i2c, rtc, eeprom, write_cycles;
+
+   static Traffic of(RtcSlaveRig &s, uint64_t polls) {
+      return { polls, s.cpu.i2c.transactions, s.rtc.transactions,
+               s.eeprom.transactions, s.eeprom.write_cycles };
+   }
+   Traffic operator-(const Traffic &t) const {
+      return { polls - t.polls, i2c - t.i2c, rtc - t.rtc, eeprom - t.eeprom,
+               write_cycles - t.write_cycles };
+   }
+};
+
+struct Result {
+   Traffic alarm, loop, save;
+};
+
+// Next byte of an answer, pushed frames skipped
+static uint8_t answer_getc( void ) {
+   for(;;) {
+      uint8_t c = ccs_getc();
+      if(c < 0x80) {
+         return c;
+      }
+      // TimeEvent, DateEvent, AlarmEvent and AlarmEntryEvent
+      static const int lengths[4] = { 3, 4, 3, 6 };
+      for(int i = 0; i < lengths[c & 3]; i++) {
+         ccs_getc();
+      }
+   }
+}
+
+// A SendXxx command, its answer and the acknowledge
+static void poll(uint8_t command, int bytes) {
+   ccs_putc(command);
+   for(int i = 0; i < bytes; i++) {
+      answer_getc();
+   }
+   ccs_putc(0);
+}
+
+static void master(Result &r, RtcSlaveRig &slave) {
+   uint64_t polls = 0;
+   Traffic start;
+   SimTime end;
+
+   delay_ms(BOOT / SIM_MS);
+
+   start = Traffic::of(slave, polls);
+   for(end = cpu->now + MEASURE; cpu->now < end; polls++) {
+      poll(SEND_ALARM, 3);
+   }
+   r.alarm = Traffic::of(slave, polls) - start;
+
+   start = Traffic::of(slave, polls = 0);
+   for(end = cpu->now + MEASURE; cpu->now < end; polls++) {
+      poll(SEND_DATE, 4);
+      poll(SEND_TIME, 3);
+      poll(SEND_ALARM, 3);
+   }
+   r.loop = Traffic::of(slave, polls) - start;
+
+   // The default alarm, 8:00:00
+   delay_ms(100);
+   start = Traffic::of(slave, polls = 0);
+   for(int i = 0; i < 10; i++, polls++) {
+      ccs_putc(RECEIVE_ALARM);
+      ccs_putc(0);
+      ccs_putc(0);
+      ccs_putc(8);
+      answer_getc();
+      delay_ms(100);
+   }
+   r.save = Traffic::of(slave, polls) - start;
+
+   cpu->sim->end = cpu->now;     // Stops the slave too
+}
+
+static Result run(bool base) {
+   Result r;
+   RtcSlaveRig slave(base);
+   Cpu board;
+
+   board.name = "master";
+   board.clock = 5000000;
+   board.uart.peer = &slave.cpu;
+   slave.cpu.uart.peer = &board;
+   slave.rtc.set(START, 0);
+
+   Sim sim(10 * MEASURE);
+   sim.lookahead = board.uart.byte_ns;
+   sim.add(slave.cpu, [&]() { slave.program(base); });
+   sim.add(board, [&]() { master(r, slave); });
+   sim.run();
+   return r;
+}
+
+static void report(Json &json, const char *key, const Traffic &t, bool minute) {
+   double scale = minute ? 60.0 * SIM_SEC / MEASURE : 1;
+   json.begin(key);
+   json.num(minute ? "polls_per_min" : "commands", t.polls * scale);
+   json.num(minute ? "i2c_per_min" : "i2c", t.i2c * scale);
+   json.num(minute ? "ds1307_per_min" : "ds1307", t.rtc * scale);
+   json.num(minute ? "eeprom_per_min" : "eeprom", t.eeprom * scale);
+   json.num("eeprom_write_cycles", t.write_cycles);
+   json.end();
+}
+
+int main( void ) {
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "rtc_alarm_poll");
+   for(int after = 0; after < 2; after++) {
+      Result r = run(!after);
+      json.begin(after ? "after" : "before");
+      report(json, "send_alarm", r.alarm, true);
+      report(json, "date_time_alarm", r.loop, true);
+      report(json, "receive_same_alarm", r.save, false);
+      json.end();
+   }
+   json.end();
+   return 0;
+}
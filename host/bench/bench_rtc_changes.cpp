@@ -0,0 +1,210 @@
+// bench_rtc_changes - Replay of the RTC master SendChanges sequence
+//
+// The '#' key of RTC_Master.c sends the adjusted values to the slave:
+// ReceiveDate and the date, ReceiveTime and the time, ReceiveAlarm and
+// the alarm, then SetRTC. The sequence is replayed 30 times, 2 s apart,
+// with the functions of RTC_COMMUNICATION.c against the slave program of
+// the base revision and the current one (rtc_rig.h), which also pushes
+// the time once a second and the alarm back after ReceiveAlarm. Every
+// sequence sets another time.
+//
+// Reports the bytes on the wire, the round trips and the I2C, EEPROM and
+// DS1307 RAM traffic of the slave during the sequences, the latency of
+// every step, from its command byte to the acknowledge, and of the whole
+// sequence up to the new time being in the DS1307. SetRTC has no
+// acknowledge, its step also ends when the DS1307 has the time.
+
+#include "ccs.h"
+#include "bench.h"
+#include "rtc_rig.h"
+
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 2
+namespace base {
+#include "../gen-base/rtc_communication.c"
+}
+
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 0
+namespace now {
+#include "rtc_communication.c"
+}
+
+#define SEQUENCES  30
+#define START      secs_from_civil(2024, 3, 14, 9, 26, 50)
+#define APPLY_MAX  (100 * SIM_MS)
+
+enum Steps { StepDate, StepTime, StepAlarm, StepSet, STEPS };
+static const char *step_names[STEPS] = {
+   "ReceiveDate", "ReceiveTime", "ReceiveAlarm", "SetRTC"
+};
+
+struct Counters {
+   uint64_t master_tx, slave_tx, i2c, eeprom_writes, nvram_writes;
+
+   static Counters of(Cpu &master, RtcSlaveRig &s) {
+      return { master.uart.tx_bytes, s.cpu.uart.tx_bytes, s.cpu.i2c.transactions,
+               s.eeprom.write_cycles, s.rtc.nvram_writes };
+   }
+   void add(const Counters &from, const Counters &to) {
+      master_tx += to.master_tx - from.master_tx;
+      slave_tx += to.slave_tx - from.slave_tx;
+      i2c += to.i2c - from.i2c;
+      eeprom_writes += to.eeprom_writes - from.eeprom_writes;
+      nvram_writes += to.nvram_writes - from.nvram_writes;
+   }
+};
+
+struct Result {
+   Counters d = {};            // Counted during the sequences
+   uint64_t trips = 0;
+   int applied = 0;            // Sequences that set the DS1307
+   Samples step[STEPS], sequence;
+};
+
+static Result *result;
+static RtcSlaveRig *slave;
+
+// Values of sequence i, one hour apart
+template<class D, class T> static uint64_t values(int i, D &date, T &time, T &alarm) {
+   uint64_t secs = START + (i + 1) * 3600ull;
+   CivilTime c = civil_from_secs(secs);
+
+   date.dow = c.dow;
+   date.day = c.day;
+   date.mth = c.mth;
+   date.year = c.year - 2000;
+   time.hour = c.hour;
+   time.min = c.min;
+   time.sec = c.sec;
+   alarm.hour = (c.hour + 1) % 24;
+   alarm.min = 0;
+   alarm.sec = 0;
+   return secs;
+}
+
+// Times a step from its command byte to the end of fn
+template<class F> static void step(int s, int command, F fn) {
+   SimTime start = cpu->now;
+   ccs_putc(command);
+   result->trips++;
+   fn();
+   result->step[s].add((std::max(cpu->now, cpu->uart.tx_done) - start) / (double)SIM_US);
+}
+
+// Waits until the DS1307 counts from secs, returns false on a timeout
+static bool applied(uint64_t secs) {
+   SimTime deadline = cpu->now + APPLY_MAX;
+   uint64_t t;
+
+   while(cpu->now < deadline) {
+      t = slave->rtc.seconds(cpu->now);
+      if(t == secs || t == secs + 1) {
+         return true;
+      }
+      delay_us(100);
+   }
+   return false;
+}
+
+// One sequence, with the functions of the revision in ns
+#define SEND_CHANGES(ns, i, drain) do { \
+   ns::Date date; \
+   ns::Time time, alarm; \
+   uint64_t secs = values(i, date, time, alarm); \
+   Counters before = Counters::of(*cpu, *slave); \
+   SimTime start = cpu->now, set; \
+   step(StepDate, ns::ReceiveDate, [&]() { ns::send_date(date); }); \
+   step(StepTime, ns::ReceiveTime, [&]() { ns::send_time(time); }); \
+   step(StepAlarm, ns::ReceiveAlarm, [&]() { ns::send_time(alarm); }); \
+   set = cpu->now; \
+   ccs_putc(ns::SetRTC); \
+   result->trips++; \
+   if(applied(secs)) { \
+      result->applied++; \
+      result->step[StepSet].add((cpu->now - set) / (double)SIM_US); \
+      result->sequence.add((cpu->now - start) / (double)SIM_US); \
+   } \
+   drain; \
+   result->d.add(before, Counters::of(*cpu, *slave)); \
+} while(0)
+
+static void replay_base( void ) {
+   delay_ms(100);
+   for(int i = 0; i < SEQUENCES; i++) {
+      SEND_CHANGES(base, i, (void)0);
+      delay_ms(2000);
+   }
+   cpu->sim->end = cpu->now;
+}
+
+static void replay_now( void ) {
+   now::link_init();
+   enable_interrupts(GLOBAL);
+   delay_ms(100);
+   for(int i = 0; i < SEQUENCES; i++) {
+      // Pushes waiting since the last sequence
+      while(now::link_tail != now::link_head) {
+         now::receive_push(now::link_getc());
+      }
+      SEND_CHANGES(now, i, delay_ms(20));
+      delay_ms(2000);
+   }
+   cpu->sim->end = cpu->now;
+}
+
+static Result run(bool is_base) {
+   Result r;
+   RtcSlaveRig rig(is_base);
+   Cpu master;
+
+   result = &r;
+   slave = &rig;
+   master.name = "master";
+   master.program = is_base ? 2 : 0;
+   master.clock = 5000000;
+   master.uart.peer = &rig.cpu;
+   rig.cpu.uart.peer = &master;
+   rig.rtc.set(START, 0);
+
+   Sim sim(600 * SIM_SEC);
+   sim.lookahead = master.uart.byte_ns;
+   sim.add(rig.cpu, [&]() { rig.program(is_base); });
+   sim.add(master, is_base ? replay_base : replay_now);
+   sim.run();
+   return r;
+}
+
+int main( void ) {
+   Json json;
+   bool ok = true;
+
+   json.begin();
+   json.str("benchmark", "rtc_changes");
+   json.num("sequences", SEQUENCES);
+   for(int after = 0; after < 2; after++) {
+      Result r = run(!after);
+      json.begin(after ? "after" : "before");
+      json.num("round_trips", r.trips);
+      json.begin("bytes_per_sequence");
+      json.num("master_tx", r.d.master_tx / (double)SEQUENCES);
+      json.num("slave_tx", r.d.slave_tx / (double)SEQUENCES);
+      json.end();
+      json.begin("slave_per_sequence");
+      json.num("i2c_transactions", r.d.i2c / (double)SEQUENCES);
+      json.num("eeprom_write_cycles", r.d.eeprom_writes / (double)SEQUENCES);
+      json.num("nvram_writes", r.d.nvram_writes / (double)SEQUENCES);
+      json.end();
+      json.num("applied", r.applied);
+      json.begin("latency_us");
+      for(int s = 0; s < STEPS; s++) {
+         json.percentiles(step_names[s], r.step[s]);
+      }
+      json.percentiles("sequence", r.sequence);
+      json.end();
+      json.end();
+      ok &= r.applied == SEQUENCES;
+   }
+   json.end();
+   return ok ? 0 : 1;
+}
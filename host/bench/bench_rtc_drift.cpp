@@ -0,0 +1,116 @@
+// bench_rtc_drift - Error of the RTC master local clock with skewed
+// crystals
+//
+// Runs the master and slave programs for 20 minutes with the master
+// crystal off by -500 to +500 ppm and the DS1307 one by +20 ppm. Every
+// millisecond the time on the master LCD is read, and every time its
+// seconds change the change is compared with the DS1307 tick of that
+// second. It reports the error of the changes after the first sync
+// (positive when the LCD is late), how many seconds were skipped or
+// shown twice, and the link bytes the clock used.
+
+#include <stdio.h>
+#include <math.h>
+
+#include "bench.h"
+#include "rtc_rig.h"
+
+#define RUN      (20 * 60 * SIM_SEC)
+#define SETTLE   (5 * SIM_SEC)        // Boot and first sync
+#define POLL     SIM_MS
+#define RTC_PPM  20
+#define START    secs_from_civil(2024, 3, 14, 9, 26, 50)
+
+struct Result {
+   double ppm;
+   Samples error_ms;
+   int skipped = 0, repeated = 0;
+   uint64_t link_bytes;
+};
+
+// Seconds since midnight on the second line of the LCD, -1 if none
+static long shown(const Hd44780 &lcd) {
+   int h, m, s;
+   if(sscanf(lcd.line(2).c_str(), "%2d:%2d:%2d", &h, &m, &s) != 3) {
+      return -1;
+   }
+   return h * 3600L + m * 60 + s;
+}
+
+// Time the DS1307 entered the second secs since 2000
+static SimTime tick_of(const Ds1307 &rtc, uint64_t secs) {
+   return rtc.base_time + (SimTime)llroundl((long double)(secs - rtc.base_secs)
+                                           * SIM_SEC / (1 + rtc.ppm * 1e-6L));
+}
+
+static Result run(double ppm) {
+   Result r;
+   RtcSlaveRig slave;
+   RtcMasterRig master;
+   long last = -1;
+   std::function<void()> poll;
+
+   r.ppm = ppm;
+   master.cpu.clock = (uint32_t)llround(5000000 * (1 + ppm * 1e-6));
+   master.connect(slave);
+   slave.rtc.ppm = RTC_PPM;
+   slave.rtc.set(START, 0);
+
+   // Not while the tick is sending a change to the LCD
+   poll = [&]() {
+      if(master.cpu.in_isr) {
+         master.cpu.at(master.cpu.now + POLL / 10, poll);
+         return;
+      }
+      long now = shown(master.lcd);
+      if(now >= 0 && now != last) {
+         if(master.cpu.now >= SETTLE && last >= 0) {
+            long step = (now - last + 86400) % 86400;
+            r.skipped += step > 1 ? step - 1 : 0;
+            r.repeated += step == 0;
+            uint64_t secs = START - START % 86400 + now;
+            double error = ((double)master.cpu.now - tick_of(slave.rtc, secs)) / SIM_MS;
+            r.error_ms.add(error);
+         }
+         last = now;
+      }
+      master.cpu.at(master.cpu.now + POLL, poll);
+   };
+   master.cpu.at(POLL, poll);
+
+   Sim sim(RUN);
+   sim.lookahead = master.cpu.uart.byte_ns;
+   sim.add(slave.cpu, [&]() { slave.program(false); });
+   sim.add(master.cpu, [&]() { master.program(false); });
+   sim.run();
+
+   r.link_bytes = master.cpu.uart.tx_bytes + slave.cpu.uart.tx_bytes;
+   return r;
+}
+
+int main( void ) {
+   static const double skews[] = { -500, -100, 0, 100, 500 };
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "rtc_drift");
+   json.num("minutes", RUN / (60 * SIM_SEC));
+   json.num("rtc_ppm", RTC_PPM);
+   json.array("master_skews");
+   for(double ppm : skews) {
+      Result r = run(ppm);
+      double worst = std::max(r.error_ms.max(), -r.error_ms.min());
+      json.begin();
+      json.num("master_ppm", r.ppm);
+      json.percentiles("error_ms", r.error_ms);
+      json.num("min_error_ms", r.error_ms.min());
+      json.num("max_abs_error_ms", worst);
+      json.num("skipped", r.skipped);
+      json.num("repeated", r.repeated);
+      json.num("link_bytes", r.link_bytes);
+      json.end();
+   }
+   json.end_array();
+   json.end();
+   return 0;
+}
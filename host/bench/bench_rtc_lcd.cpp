@@ -0,0 +1,104 @@
+// bench_rtc_lcd - LCD writes per second of the RTC master, full reprint
+// against field level redraw
+//
+// Runs the master and slave programs of the base revision, which printed
+// the date, time and alarm lines on every pass of the main loop, and the
+// current ones, which only send the digits that changed. Measures 60 s
+// of idle running and then 20 s of adjusting the time ('C' pressed),
+// where the adjusted field blinks. Reports the bytes the HD44780 model
+// receives per second, split in instructions and characters, and checks
+// the time on the LCD against the DS1307 at the end.
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "rtc_rig.h"
+
+#define WARMUP   (10 * SIM_SEC)
+#define IDLE     (60 * SIM_SEC)
+#define ADJUST   (20 * SIM_SEC)
+#define START    secs_from_civil(2024, 3, 14, 9, 26, 50)
+
+#define KEY_C      11
+#define KEY_STAR   12
+
+struct Count {
+   uint64_t instructions, data;
+
+   static Count of(const Hd44780 &lcd) {
+      return { lcd.instructions, lcd.data_writes };
+   }
+   Count operator-(const Count &c) const {
+      return { instructions - c.instructions, data - c.data };
+   }
+};
+
+struct Result {
+   Count idle, adjust;
+   bool display_ok;
+};
+
+// "HH:MM:SS" at the start of the second line
+static bool shows(const Hd44780 &lcd, const CivilTime &t) {
+   char text[9];
+   snprintf(text, sizeof(text), "%02d:%02d:%02d", t.hour, t.min, t.sec);
+   return lcd.line(2).compare(0, 8, text) == 0;
+}
+
+static Result run(bool base) {
+   Result r;
+   RtcSlaveRig slave(base);
+   RtcMasterRig master(base);
+   Count marks[3];
+   SimTime adjust = WARMUP + IDLE;
+
+   master.connect(slave);
+   slave.rtc.set(START, 0);
+   master.pad.press(KEY_C, adjust, 100 * SIM_MS);
+   master.pad.press(KEY_STAR, adjust + ADJUST, 100 * SIM_MS);
+   master.cpu.at(WARMUP, [&]() { marks[0] = Count::of(master.lcd); });
+   master.cpu.at(adjust, [&]() { marks[1] = Count::of(master.lcd); });
+   master.cpu.at(adjust + ADJUST, [&]() { marks[2] = Count::of(master.lcd); });
+
+   Sim sim(adjust + ADJUST + 5 * SIM_SEC);
+   sim.lookahead = master.cpu.uart.byte_ns;
+   sim.add(slave.cpu, [&]() { slave.program(base); });
+   sim.add(master.cpu, [&]() { master.program(base); });
+   sim.run();
+
+   r.idle = marks[1] - marks[0];
+   r.adjust = marks[2] - marks[1];
+
+   uint64_t now = slave.rtc.seconds(master.cpu.now);
+   r.display_ok = false;
+   for(uint64_t s = now - 1; s <= now + 1; s++) {
+      r.display_ok |= shows(master.lcd, civil_from_secs(s));
+   }
+   return r;
+}
+
+static void report(Json &json, const char *key, const Count &c, SimTime span) {
+   double seconds = span / (double)SIM_SEC;
+   json.begin(key);
+   json.num("bytes_per_s", (c.instructions + c.data) / seconds);
+   json.num("instructions_per_s", c.instructions / seconds);
+   json.num("chars_per_s", c.data / seconds);
+   json.end();
+}
+
+int main( void ) {
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "rtc_lcd");
+   for(int after = 0; after < 2; after++) {
+      Result r = run(!after);
+      json.begin(after ? "after" : "before");
+      report(json, "idle", r.idle, IDLE);
+      report(json, "adjusting", r.adjust, ADJUST);
+      json.boolean("display_ok", r.display_ok);
+      json.end();
+   }
+   json.end();
+   return 0;
+}
@@ -0,0 +1,99 @@
+// bench_rtc_link - Link utilization and master loop rate of the RTC
+// project, polled against pushed updates
+//
+// Runs the master and slave programs of the base revision, where the
+// master asks for the date, time and alarm on every pass of its main
+// loop, and the current ones, where the slave pushes the changes and the
+// master keeps its own clock. After a 10 s warm up it measures 120 s of
+// idle running: bytes per second in each direction, the share of the
+// 9600 baud line they take, master main loop passes per second and the
+// slave I2C transactions. The time on the LCD is checked against the
+// DS1307 at the end.
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "rtc_rig.h"
+
+#define WARMUP   (10 * SIM_SEC)
+#define MEASURE  (120 * SIM_SEC)
+#define START    secs_from_civil(2024, 3, 14, 9, 26, 50)
+
+struct Snapshot {
+   uint64_t master_tx, slave_tx, loops, i2c;
+
+   static Snapshot of(RtcMasterRig &m, RtcSlaveRig &s) {
+      return { m.cpu.uart.tx_bytes, s.cpu.uart.tx_bytes, m.cpu.loops,
+               s.cpu.i2c.transactions };
+   }
+};
+
+struct Result {
+   Snapshot d;         // Counted during the measure
+   double seconds;
+   bool display_ok;
+};
+
+// "HH:MM:SS" at the start of the second line
+static bool shows(const Hd44780 &lcd, const CivilTime &t) {
+   char text[9];
+   snprintf(text, sizeof(text), "%02d:%02d:%02d", t.hour, t.min, t.sec);
+   return lcd.line(2).compare(0, 8, text) == 0;
+}
+
+static Result run(bool base) {
+   Result r;
+   RtcSlaveRig slave(base);
+   RtcMasterRig master(base);
+   Snapshot start;
+
+   master.connect(slave);
+   slave.rtc.set(START, 0);
+   master.cpu.at(WARMUP, [&]() { start = Snapshot::of(master, slave); });
+
+   Sim sim(WARMUP + MEASURE);
+   sim.lookahead = master.cpu.uart.byte_ns;
+   sim.add(slave.cpu, [&]() { slave.program(base); });
+   sim.add(master.cpu, [&]() { master.program(base); });
+   sim.run();
+
+   Snapshot end = Snapshot::of(master, slave);
+   r.d = { end.master_tx - start.master_tx, end.slave_tx - start.slave_tx,
+           end.loops - start.loops, end.i2c - start.i2c };
+   r.seconds = MEASURE / (double)SIM_SEC;
+
+   // The master clock is kept within a second of the DS1307
+   uint64_t now = slave.rtc.seconds(master.cpu.now);
+   r.display_ok = false;
+   for(uint64_t s = now - 1; s <= now + 1; s++) {
+      r.display_ok |= shows(master.lcd, civil_from_secs(s));
+   }
+   return r;
+}
+
+// Bits of 8N1 frames against the 9600 bits of a second
+static double utilization(uint64_t bytes, double seconds) {
+   return bytes * 10 / seconds / 9600;
+}
+
+int main( void ) {
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "rtc_link");
+   json.num("seconds", MEASURE / (double)SIM_SEC);
+   for(int after = 0; after < 2; after++) {
+      Result r = run(!after);
+      json.begin(after ? "after" : "before");
+      json.num("master_tx_bytes_per_s", r.d.master_tx / r.seconds);
+      json.num("slave_tx_bytes_per_s", r.d.slave_tx / r.seconds);
+      json.num("master_tx_utilization", utilization(r.d.master_tx, r.seconds));
+      json.num("slave_tx_utilization", utilization(r.d.slave_tx, r.seconds));
+      json.num("master_loops_per_s", r.d.loops / r.seconds);
+      json.num("slave_i2c_per_s", r.d.i2c / r.seconds);
+      json.boolean("display_ok", r.display_ok);
+      json.end();
+   }
+   json.end();
+   return 0;
+}
@@ -0,0 +1,131 @@
+// bench_rtc_secs - Instruction cycles of the seconds conversions of
+// RTC_COMMUNICATION.c
+//
+// The host build does not run PIC code, so the cycles are estimated from
+// the PIC18 code CCS generates, one cycle an instruction and two for a
+// taken branch, CALL, RETURN, MOVFF or TBLRD, with the CCS math helpers
+// on the hardware multiplier:
+//
+//    32 bit / or %   @DIV3232, 32 passes of 20 and setup 10
+//    16 bit / or %   @DIV1616, arguments 8, CALL/RETURN 4, setup 6 and
+//                    16 passes of 13
+//    32 bit *        @MUL3232, 10 MULWF partial products and adds 60,
+//                    arguments 8, CALL/RETURN 4
+//    16 bit *        @MUL1616, 4 MULWF partial products and adds 20,
+//                    arguments 4, CALL/RETURN 4
+//    32 bit + - cmp  4 bytes of 2
+//    set_*_str()     CALL/RETURN 4, switch 10, strcpy() of 4 bytes 32
+//
+//    timecmp         CALL/RETURN 4, two Time copies 12, 3 for every field
+//                    compared, result 2
+//    hms2secs        CALL/RETURN 4, arguments 3, hour * 3600 32 bit,
+//                    min * 60 16 bit, two adds 32 bit
+//    time2secs       CALL/RETURN 4, Time copy 6, hms2secs
+//    secs2time       CALL/RETURN 4, arguments 5, secs / 60 32 bit,
+//                    mins * 60 32 bit, subtract, mins / 60 16 bit,
+//                    hour * 60 16 bit, subtract 2, stores 3
+//    secs_add        CALL/RETURN 4, arguments 8, then the base revision
+//                    two 32 bit % and an add; now a compare, an add, a
+//                    compare and a subtract when it wraps, the %
+//                    only for a day or more
+//    date2epoch      CALL/RETURN 4, copies 14, range tests 12, year * 365
+//                    16 bit, (year + 3) / 4 4, table read 18, adds 8,
+//                    leap test 6, days * 86400 32 bit, time2secs, add
+//    epoch2date      CALL/RETURN 4, arguments 6, epoch / 86400 32 bit,
+//                    days * 86400 32 bit, subtract, secs2time,
+//                    (days + 6) % 7, days / 1461 and days % 1461 16 bit,
+//                    * 4 4, when past the leap year a subtract 4, / 365
+//                    and % 365 16 bit and an add 3, leap test 3, a month
+//                    loop pass 34 (table read 18, leap test 5, compare 7,
+//                    decrement and branch 4), day and month 8, both
+//                    set_*_str()
+//
+// The conversions run over every day of 2000 - 2099 at noon, the month
+// loop passes of epoch2date() follow from the month it finds. secs_add
+// is timed on the once a second clock update of RTC_Master.c, a time of
+// the day plus at most 255 seconds, and checked against the base
+// formula.
+
+#include "ccs.h"
+#include "bench.h"
+
+#include "rtc_communication.c"
+
+#define CALL_RET    4
+#define DIV32       (10 + 32 * 20)
+#define DIV16       (8 + CALL_RET + 6 + 16 * 13)
+#define MUL32       (60 + 8 + CALL_RET)
+#define MUL16       (20 + 4 + CALL_RET)
+#define OP32        8
+#define STR_SET     (CALL_RET + 10 + 32)
+#define HMS2SECS    (CALL_RET + 3 + MUL32 + MUL16 + 2 * OP32)
+#define TIME2SECS   (CALL_RET + 6 + HMS2SECS)
+#define SECS2TIME   (CALL_RET + 5 + DIV32 + MUL32 + OP32 + DIV16 + MUL16 + 2 + 3)
+#define OLD_ADD     (CALL_RET + 8 + 2 * DIV32 + OP32)
+#define NEW_ADD     (CALL_RET + 8 + 3 * OP32)
+#define DATE2EPOCH  (CALL_RET + 14 + 12 + MUL16 + 4 + 18 + 8 + 6 + MUL32 + \
+                     TIME2SECS + OP32)
+#define E2D_BASE    (CALL_RET + 6 + DIV32 + MUL32 + OP32 + SECS2TIME + \
+                     DIV16 + 2 * DIV16 + 4 + 3 + 8 + 2 * STR_SET)
+#define E2D_LATER   (4 + 2 * DIV16 + 3)
+#define E2D_PASS    34
+
+#define CENTURY_DAYS 36525
+
+// Cycles of timecmp() decided at field n (1 hour, 2 minute, 3 second)
+static unsigned field_compare(int fields) {
+   return CALL_RET + 12 + 3 * fields + 2;
+}
+
+int main( void ) {
+   Samples e2d, cmp;
+   Date date;
+   Time time;
+   int day, mismatches = 0;
+   uint32_t secs, d;
+
+   for(day = 0; day < CENTURY_DAYS; day++) {
+      epoch2date((EpochSecs)day * DAY_SECONDS + DAY_SECONDS / 2, date, time);
+      e2d.add(E2D_BASE + (day % 1461 >= 366 ? E2D_LATER : 0) +
+              (12 - date.mth + (date.mth > 1)) * E2D_PASS);
+   }
+
+   // Every pair of hours, the same hour compared down to the seconds
+   for(int a = 0; a < 24; a++) {
+      for(int b = 0; b < 24; b++) {
+         cmp.add(field_compare(a != b ? 1 : 3));
+      }
+   }
+
+   for(secs = 0; secs < DAY_SECONDS; secs += 7) {
+      for(d = 0; d < 256; d += 17) {
+         mismatches += secs_add(secs, d) != (secs + d % DAY_SECONDS) % DAY_SECONDS;
+      }
+   }
+   mismatches += secs_add(DAY_SECONDS - 1, 3 * DAY_SECONDS + 2) != 1;
+
+   Json json;
+   json.begin();
+   json.str("benchmark", "rtc_secs");
+   json.str("cycles", "estimated, PIC18");
+   json.begin("timecmp");
+   json.num("fields_mean", cmp.mean());
+   json.num("fields_max", field_compare(3));
+   json.num("seconds", CALL_RET + 12 + 2 * TIME2SECS + OP32 + 2);
+   json.end();
+   json.begin("secs_add_clock_update");
+   json.num("base", OLD_ADD);
+   json.num("compare_subtract", NEW_ADD);
+   json.num("mismatches", mismatches);
+   json.end();
+   json.num("time2secs", TIME2SECS);
+   json.num("secs2time", SECS2TIME);
+   json.num("date2epoch", DATE2EPOCH);
+   json.begin("epoch2date");
+   json.num("mean", e2d.mean());
+   json.num("min", e2d.min());
+   json.num("max", e2d.max());
+   json.end();
+   json.end();
+   return mismatches ? 1 : 0;
+}
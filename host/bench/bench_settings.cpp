@@ -0,0 +1,168 @@
+// bench_settings - Latency of the settings in the DS1307 RAM against the
+// 24LC04B
+//
+// The RTC slave used to keep its alarm table in the 24LC04B, one byte
+// write at a time, and now keeps it in the SETTINGS.c store on the 56
+// bytes of DS1307 RAM. Times the boot load of the 40 byte table, saving
+// one changed entry, saving the whole table and saving a single byte,
+// each from an idle bus: on the EEPROM with byte writes and with page
+// writes, and in the settings store. latency_us runs to the return of
+// the call, durable_us to the end of the last EEPROM write cycle.
+
+#include "ccs.h"
+#include "bench.h"
+
+#include "rtc_communication.c"
+#include "ds1307.c"
+#include "settings.c"
+#include "2404.c"
+
+#define TABLE_SIZE  (ALARMS * ALARM_SIZE)
+#define KEY_TABLE   1
+#define KEY_BYTE    2
+#define PAGE        16
+
+static Cpu board;
+static Ds1307 rtc;
+static Eeprom24 eeprom{512};
+static BYTE table[TABLE_SIZE];
+
+struct Cost {
+   double latency_us, durable_us;
+   uint64_t i2c, write_cycles;
+};
+
+template<class F> Cost measure(F fn) {
+   Cost c;
+   board.wait(10 * SIM_MS);         // Idle bus, no write cycle running
+   SimTime start = board.now;
+   uint64_t i2c = board.i2c.transactions, cycles = eeprom.write_cycles;
+   fn();
+   c.latency_us = (board.now - start) / (double)SIM_US;
+   c.durable_us = (std::max(board.now, eeprom.busy_until) - start) /
+                  (double)SIM_US;
+   c.i2c = board.i2c.transactions - i2c;
+   c.write_cycles = eeprom.write_cycles - cycles;
+   return c;
+}
+
+// Byte writes of the bytes that changed, as RTC_Slave.c did
+static void eeprom_bytes(int first, int len) {
+   for(int i = first; i < first + len; i++) {
+      if(read_ext_eeprom(i) != table[i]) {
+         write_ext_eeprom(i, table[i]);
+      }
+   }
+}
+
+// Page writes, split at the 16 byte pages
+static void eeprom_pages(int first, int len) {
+   while(len > 0) {
+      int n = std::min(len, PAGE - first % PAGE);
+      write_ext_eeprom_page(first, &table[first], n);
+      first += n;
+      len -= n;
+   }
+}
+
+static void change(int first, int len) {
+   for(int i = first; i < first + len; i++) {
+      table[i]++;
+   }
+}
+
+static void report(Json &json, const char *key, const Cost &c) {
+   json.begin(key);
+   json.num("latency_us", c.latency_us);
+   json.num("durable_us", c.durable_us);
+   json.num("i2c", c.i2c);
+   json.num("write_cycles", c.write_cycles);
+   json.end();
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   Json json;
+   BYTE value = 30;
+   int i;
+
+   board.clock = 5000000;
+   board.i2c.devices.push_back(&rtc);
+   board.i2c.devices.push_back(&eeprom);
+   settings_load();
+   settings_set(KEY_TABLE, table, TABLE_SIZE);
+   settings_set8(KEY_BYTE, value);
+   eeprom_pages(0, TABLE_SIZE);
+
+   json.begin();
+   json.str("benchmark", "settings");
+   json.num("table_bytes", TABLE_SIZE);
+
+   json.begin("load_table");
+   report(json, "eeprom", measure([]() {
+      for(int i = 0; i < TABLE_SIZE; i++) {
+         table[i] = read_ext_eeprom(i);
+      }
+   }));
+   report(json, "nvram", measure([]() {
+      settings_load();
+      settings_get(KEY_TABLE, table, TABLE_SIZE);
+   }));
+   json.end();
+
+   // Entry 1, bytes 5-9
+   json.begin("save_entry");
+   change(ALARM_SIZE, ALARM_SIZE);
+   report(json, "eeprom_bytes", measure([]() {
+      eeprom_bytes(ALARM_SIZE, ALARM_SIZE);
+   }));
+   change(ALARM_SIZE, ALARM_SIZE);
+   report(json, "eeprom_page", measure([]() {
+      eeprom_pages(ALARM_SIZE, ALARM_SIZE);
+   }));
+   change(ALARM_SIZE, ALARM_SIZE);
+   report(json, "nvram", measure([]() {
+      settings_set(KEY_TABLE, table, TABLE_SIZE);
+   }));
+   json.end();
+
+   json.begin("save_table");
+   change(0, TABLE_SIZE);
+   report(json, "eeprom_bytes", measure([]() {
+      eeprom_bytes(0, TABLE_SIZE);
+   }));
+   change(0, TABLE_SIZE);
+   report(json, "eeprom_page", measure([]() {
+      eeprom_pages(0, TABLE_SIZE);
+   }));
+   change(0, TABLE_SIZE);
+   report(json, "nvram", measure([]() {
+      settings_set(KEY_TABLE, table, TABLE_SIZE);
+   }));
+   json.end();
+
+   json.begin("save_byte");
+   value++;
+   report(json, "eeprom", measure([&]() {
+      write_ext_eeprom(TABLE_SIZE, value);
+   }));
+   value++;
+   report(json, "nvram", measure([&]() {
+      settings_set8(KEY_BYTE, value);
+   }));
+   json.end();
+
+   json.end();
+
+   // The store holds the last table, the EEPROM the one before
+   BYTE stored[TABLE_SIZE];
+   settings_load();
+   settings_get(KEY_TABLE, stored, TABLE_SIZE);
+   for(i = 0; i < TABLE_SIZE; i++) {
+      if(stored[i] != table[i] || eeprom.mem[i] != (BYTE)(table[i] - 1)) {
+         fprintf(stderr, "bench_settings: byte %d differs\n", i);
+         return 1;
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,134 @@
+// bench_tick_isr - Instruction cycles of the TIMER 0/TMR0.c tick interrupt,
+// modulo counter against the cascaded counters of TICK.c
+//
+// The host build does not run PIC code, so the cycles are estimated from
+// the PIC18 code CCS generates, one cycle an instruction and two for a
+// taken branch, CALL, RETURN or MOVFF. The interrupt entry and exit of
+// CCS and the LED calls are the same in both and left out:
+//
+//    old count++     16 bit increment 3
+//    old count % n   arguments 8, CALL/RETURN 4, @DIV1616 setup 6 and
+//                    16 passes of 13, remainder test 4 (== 30: 5)
+//    old minute      count = 0 2, min++ and wrap 5
+//    old reload      set_timer0(206) 2, clear_interrupt 1
+//    new counter     increment and compare 5 for every counter reached,
+//                    clear 1 when it wraps
+//    new hooks       tick_cs == 30 3, tick_cs == 0 3, then 3 for every
+//                    lower counter that wrapped
+//    new reload      Timer 0 back a period: MOVFF of TMR0L/H 4, 16 bit
+//                    subtract 4, MOVFF back 4; none on Timer 1 and CCP1
+//
+// An hour of ticks runs through a copy of the old else if chain, to count
+// the divisions of each tick, and through tick_isr() of TICK.c, with the
+// hooks counting the wraps. The main loop of the old sample also divided
+// twice for every LCD refresh, count / 100 and count % 100; the new one
+// prints the counters.
+
+#define HOST_CLOCK 5000000     // #use delay of TMR0.c
+
+#include "ccs.h"
+#include "bench.h"
+
+#define INC16         3
+#define MOD16         (8 + CALL_RET + 6 + 16 * 13)
+#define MOD_TEST      4
+#define MOD_TEST_30   5
+#define CALL_RET      4
+#define OLD_MINUTE    (2 + 5)
+#define OLD_RELOAD    (2 + 1)
+#define NEW_LEVEL     5
+#define NEW_WRAP      1
+#define NEW_HOOK      3
+#define NEW_RELOAD_T0 (4 + 4 + 4)
+
+#define HOUR_TICKS    360000
+
+static unsigned wraps;    // Counters wrapped by the last tick
+
+#define TICK_TIMER0
+#define TICK_ON_SECOND()  wraps = 1
+#define TICK_ON_TEN()     wraps = 2
+#define TICK_ON_MINUTE()  wraps = 3
+#include "tick.c"
+
+// Cycles of a tick of the base revision, count the value before it
+static unsigned old_tick(uint16_t &count, uint8_t &min) {
+   unsigned cycles = INC16 + OLD_RELOAD;
+
+   count++;
+   cycles += MOD16 + MOD_TEST;
+   if(count % 6000 == 0) {
+      count = 0;
+      if(++min == 60) {
+         min = 0;
+      }
+      return cycles + OLD_MINUTE;
+   }
+   cycles += MOD16 + MOD_TEST;
+   if(count % 1000 == 0) {
+      return cycles;
+   }
+   cycles += MOD16 + MOD_TEST;
+   if(count % 100 == 0) {
+      return cycles;
+   }
+   return cycles + MOD16 + MOD_TEST_30;
+}
+
+// Cycles of a tick of TICK.c on Timer 1, from the counters it reached
+static unsigned new_tick( void ) {
+   unsigned cycles = 0;
+
+   wraps = 0;
+   tick_isr();
+
+   // tick_cs, then one more counter for every wrap. The hooks test
+   // tick_cs twice, then tick_sec and tick_sec10 once the one below
+   // wrapped.
+   cycles += NEW_LEVEL * (1 + wraps) + NEW_WRAP * wraps;
+   cycles += NEW_HOOK * (2 + std::min(wraps, 2u));
+   return cycles;
+}
+
+int main( void ) {
+   Cpu board;
+   CpuScope scope(board);
+   Samples old_cycles, t0_cycles, t1_cycles;
+   uint16_t count = 0;
+   uint8_t min = 0;
+   Json json;
+
+   tick_init();
+   for(int t = 0; t < HOUR_TICKS; t++) {
+      old_cycles.add(old_tick(count, min));
+      unsigned c = new_tick();
+      t0_cycles.add(c + NEW_RELOAD_T0);
+      t1_cycles.add(c);
+   }
+   if(count != 0 || min != 0 || tick_min != 0) {
+      fprintf(stderr, "bench_tick_isr: counters out of step\n");
+      return 1;
+   }
+
+   json.begin();
+   json.str("benchmark", "tick_isr");
+   json.str("cycles", "estimated, PIC18");
+   json.num("tick_cycles", HOST_CLOCK / 4 / 100);
+   for(int i = 0; i < 3; i++) {
+      static const char *keys[3] = { "modulo", "cascade_timer0",
+                                     "cascade_timer1" };
+      Samples &s = i == 0 ? old_cycles : i == 1 ? t0_cycles : t1_cycles;
+      json.begin(keys[i]);
+      json.num("mean", s.mean());
+      json.num("min", s.min());
+      json.num("max", s.max());
+      json.num("cpu_percent", 100.0 * s.mean() / (HOST_CLOCK / 4 / 100));
+      json.end();
+   }
+   json.begin("lcd_refresh");
+   json.num("modulo", 2 * MOD16);
+   json.num("cascade", 0);
+   json.end();
+   json.end();
+   return 0;
+}
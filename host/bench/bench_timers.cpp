@@ -0,0 +1,113 @@
+// bench_timers - Per tick cost of the TIMERS.c wheel against the number
+// of running timers
+//
+// Runs 0 to 4096 periodic timers, periods of 1 to 1000 ticks, on a wheel
+// of 256 slots for 100000 ticks. Counts the timers timer_tick() visits
+// in the slot of each tick, the work that depends on the timers running,
+// and times the tick on the host. The same timers are also run as a plain
+// array where every tick counts down every timer, as the ad hoc counters
+// the wheel replaced did.
+
+#include <chrono>
+
+#include "ccs.h"
+#include "bench.h"
+
+#define TIMER_COUNT  4096
+#define TIMER_SLOTS  256
+#include "timers.c"
+
+#define TICKS        100000
+#define MAX_PERIOD   1000
+
+static Cpu board;
+static uint16_t periods[TIMER_COUNT];
+static uint16_t left[TIMER_COUNT];
+static uint8_t fired[TIMER_COUNT];
+
+static double host_ns(std::chrono::steady_clock::time_point start) {
+   return std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Timers hanging from the slot of the next tick
+static unsigned next_slot_length( void ) {
+   unsigned n = 0;
+   for(TimerId id = timer_wheel[(timer_now + 1) & TIMER_MASK]; id != TIMER_NONE;
+       id = timer_pool[id].next) {
+      n++;
+   }
+   return n;
+}
+
+static void start_timers(int active) {
+   uint32_t seed = 3;
+
+   timer_init();
+   for(int i = 0; i < active; i++) {
+      seed = seed * 1103515245 + 12345;
+      periods[i] = 1 + (seed >> 8) % MAX_PERIOD;
+      left[i] = periods[i];
+      timer_start(i, periods[i], periods[i]);
+   }
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   const int counts[] = { 0, 16, 64, 256, 1024, 4096 };
+   volatile uint32_t sink = 0;   // Keeps the timed loops
+   Json json;
+
+   json.begin();
+   json.str("benchmark", "timers");
+   json.num("slots", TIMER_SLOTS);
+   json.num("ticks", TICKS);
+   json.array("runs");
+   for(int active : counts) {
+      Samples visited;
+      uint64_t expiries = 0;
+
+      // Timers visited and expired per tick
+      start_timers(active);
+      for(int t = 0; t < TICKS; t++) {
+         visited.add(next_slot_length());
+         timer_tick();
+      }
+      for(int i = 0; i < active; i++) {
+         expiries += timer_expired(i);
+      }
+
+      start_timers(active);
+      auto start = std::chrono::steady_clock::now();
+      for(int t = 0; t < TICKS; t++) {
+         timer_tick();
+      }
+      double wheel_ns = host_ns(start) / TICKS;
+
+      // Every timer counted down on every tick
+      start = std::chrono::steady_clock::now();
+      for(int t = 0; t < TICKS; t++) {
+         for(int i = 0; i < active; i++) {
+            if(--left[i] == 0) {
+               left[i] = periods[i];
+               fired[i] = 1;
+            }
+         }
+         sink += fired[t % TIMER_COUNT];
+      }
+      double scan_ns = host_ns(start) / TICKS;
+
+      json.begin(nullptr);
+      json.num("active", active);
+      json.num("visited_mean", visited.mean());
+      json.num("visited_max", visited.max());
+      json.num("scan_visited", active);
+      json.num("wheel_tick_ns", wheel_ns);
+      json.num("scan_tick_ns", scan_ns);
+      json.boolean("all_fired", expiries == (uint64_t)active);
+      json.end();
+   }
+   json.end_array();
+   json.end();
+   return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+# gen.sh - Runs ccs2cpp.sed on every CCS source of the tree
+#
+# Usage: gen.sh OUTDIR [REVISION]
+# The C++ of a source goes to OUTDIR/<lowercase file name>, which is only
+# rewritten when it changed so make rebuilds what depends on it. With a
+# git revision the sources are taken from that revision of the tree, for
+# the benchmarks that compare with older code.
+
+out=$1
+rev=$2
+host=$(cd "$(dirname "$0")" && pwd)
+mkdir -p "$out"
+out=$(cd "$out" && pwd)
+
+cd "$host/.." || exit 1
+if [ -n "$rev" ]; then
+   tree=$(mktemp -d)
+   trap 'rm -rf "$tree"' EXIT
+   git archive "$rev" | tar -x -C "$tree" || exit 1
+   cd "$tree" || exit 1
+fi
+
+find . -path ./host -prune -o -path ./.git -prune -o \
+     \( -name '*.c' -o -name '*.C' \) -print |
+while IFS= read -r f; do
+   name=$(basename "$f" | tr 'A-Z' 'a-z')
+   sed -f "$host/ccs2cpp.sed" "$f" > "$out/$name.tmp" || exit 1
+   if cmp -s "$out/$name.tmp" "$out/$name"; then
+      rm "$out/$name.tmp"
+   else
+      mv "$out/$name.tmp" "$out/$name"
+   fi
+done
@@ -0,0 +1,3 @@
+// 18F4550.h of the host build, the device is the virtual PIC of sim.h
+
+#include "ccs.h"
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////
+////                         LCD420.C (host)                            ////
+////        Stand-in for the stock CCS driver in the host build         ////
+////                                                                    ////
+////  Same pins and functions as LCD420.c: lcd_init(), lcd_putc(c),     ////
+////  lcd_gotoxy(x,y). Like the stock drivers it never reads the busy   ////
+////  flag and waits a fixed worst case time after every byte instead:  ////
+////  2 ms after a clear or home and 50 us after anything else. The     ////
+////  benchmarks use it as the "before" of HD44780.c.                   ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+#define LCD420_E    PIN_B0
+#define LCD420_RS   PIN_B1
+#define LCD420_RW   PIN_B2
+
+const BYTE lcd420_line[4] = { 0x00, 0x40, 0x14, 0x54 };
+BYTE lcd420_y = 1;
+
+void lcd420_nibble(BYTE n) {
+   SFR_LATB = (SFR_LATB & 0x0F) | (n << 4);
+   SFR_TRISB &= 0x0F;
+   output_high(LCD420_E);
+   delay_us(1);
+   output_low(LCD420_E);
+}
+
+void lcd420_send(bool rs, BYTE n) {
+   output_bit(LCD420_RS, rs);
+   output_low(LCD420_RW);
+   lcd420_nibble(n >> 4);
+   lcd420_nibble(n & 0x0F);
+   if(!rs && n <= 0x03) {
+      delay_ms(2);
+   } else {
+      delay_us(50);
+   }
+}
+
+void lcd_init( void ) {
+   output_low(LCD420_E);
+   output_low(LCD420_RS);
+   output_low(LCD420_RW);
+   delay_ms(15);
+   for(BYTE i=0; i<3; i++) {
+      lcd420_nibble(0x03);
+      delay_ms(5);
+   }
+   lcd420_nibble(0x02);
+   delay_us(100);
+   lcd420_send(0, 0x28);
+   lcd420_send(0, 0x0C);
+   lcd420_send(0, 0x01);
+   lcd420_send(0, 0x06);
+}
+
+void lcd_gotoxy(BYTE x, BYTE y) {
+   if(y < 1 || y > 4) {
+      y = 1;
+   }
+   lcd420_y = y;
+   lcd420_send(0, 0x80 | (lcd420_line[y - 1] + x - 1));
+}
+
+void lcd_putc(char c) {
+   switch(c) {
+      case '\f': lcd420_send(0, 0x01); lcd420_y = 1; break;
+      case '\n': lcd_gotoxy(1, ++lcd420_y); break;
+      case '\b': lcd420_send(0, 0x10); break;
+      default:   lcd420_send(1, c); break;
+   }
+}
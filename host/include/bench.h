@@ -0,0 +1,113 @@
+// bench.h - Samples and JSON output of the host benchmarks
+//
+// Every benchmark prints one JSON object on stdout. Json keeps track of
+// the commas, Samples sorts its values to give percentiles.
+
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+struct Samples {
+   std::vector<double> values;
+
+   void add(double v) { values.push_back(v); }
+   size_t count() const { return values.size(); }
+
+   // Nearest rank percentile, p from 0 to 100
+   double percentile(double p) {
+      if(values.empty()) {
+         return 0;
+      }
+      std::sort(values.begin(), values.end());
+      size_t rank = (size_t)(p / 100 * values.size() + 0.999999);
+      return values[rank ? rank - 1 : 0];
+   }
+   double min() {
+      return values.empty() ? 0 : *std::min_element(values.begin(), values.end());
+   }
+   double max() {
+      return values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+   }
+   double mean() const {
+      double sum = 0;
+      for(double v : values) {
+         sum += v;
+      }
+      return values.empty() ? 0 : sum / values.size();
+   }
+};
+
+class Json {
+public:
+   explicit Json(FILE *out = stdout) : out(out) {}
+
+   Json &begin(const char *key = nullptr) { return open(key, '{'); }
+   Json &end() { return close('}'); }
+   Json &array(const char *key = nullptr) { return open(key, '['); }
+   Json &end_array() { return close(']'); }
+
+   Json &num(const char *key, double v) {
+      name(key);
+      if(v == (long long)v) {
+         fprintf(out, "%lld", (long long)v);
+      } else {
+         fprintf(out, "%.6g", v);
+      }
+      return *this;
+   }
+   Json &str(const char *key, const char *v) {
+      name(key);
+      fprintf(out, "\"%s\"", v);
+      return *this;
+   }
+   Json &boolean(const char *key, bool v) {
+      name(key);
+      fprintf(out, v ? "true" : "false");
+      return *this;
+   }
+   // count, p50, p90, p99 and max of a set of samples
+   Json &percentiles(const char *key, Samples &s) {
+      begin(key);
+      num("count", s.count());
+      num("p50", s.percentile(50));
+      num("p90", s.percentile(90));
+      num("p99", s.percentile(99));
+      num("max", s.max());
+      return end();
+   }
+
+private:
+   FILE *out;
+   std::vector<bool> first;
+
+   void name(const char *key) {
+      if(!first.empty()) {
+         if(!first.back()) {
+            fputc(',', out);
+         }
+         first.back() = false;
+      }
+      if(key) {
+         fprintf(out, "\"%s\":", key);
+      }
+   }
+   Json &open(const char *key, char c) {
+      name(key);
+      fputc(c, out);
+      first.push_back(true);
+      return *this;
+   }
+   Json &close(char c) {
+      fputc(c, out);
+      first.pop_back();
+      if(first.empty()) {
+         fputc('\n', out);
+      }
+      return *this;
+   }
+};
+
+#endif
@@ -0,0 +1,329 @@
+////////////////////////////////////////////////////////////////////////////
+////                               CCS.H                                ////
+////        Built-in functions of CCS C on the virtual PIC (sim.h)      ////
+////                                                                    ////
+////  Included by the 18F4550.h of the host build. Sources go through   ////
+////  ccs2cpp.sed first, which turns the CCS types and directives into  ////
+////  C++ and the registers and bits into the SFR_ and BIT_ names here. ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_CCS_H
+#define HOST_CCS_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#ifndef HOST_PROGRAM
+#define HOST_PROGRAM 0
+#endif
+
+#ifndef HOST_CLOCK
+#define HOST_CLOCK 20000000
+#endif
+
+typedef uint8_t BYTE;
+typedef bool    BOOLEAN;
+#define TRUE    1
+#define FALSE   0
+#define null    NULL   // Identifiers are case insensitive
+
+// #int_xxx, see ccs2cpp.sed
+#define HOST_ISR(vector,fn) \
+   static HostIsr host_isr_##fn(vector, HOST_PROGRAM, fn);
+
+// Loop hooks inserted by ccs2cpp.sed
+#define HOST_SPIN()   cpu->spin()
+inline void host_loop( void ) { cpu->loop(); }
+
+/*******            Registers and bits           *******/
+
+inline uint8_t &host_port(int port) {
+   cpu->port_word[port] = cpu->read_port(port);
+   cpu->port_reads[port]++;
+   return *(uint8_t*)&cpu->port_word[port];
+}
+
+// LATx, writes reach the devices on the pins at once
+struct HostLatch {
+   int port;
+   operator uint8_t() const { return cpu->lat[port]; }
+   HostLatch &operator=(uint8_t value) {
+      cpu->lat[port] = value;
+      cpu->lat_writes[port]++;
+      cpu->pins_changed(port);
+      return *this;
+   }
+   HostLatch &operator|=(uint8_t value) { return *this = *this | value; }
+   HostLatch &operator&=(uint8_t value) { return *this = *this & value; }
+};
+
+#define SFR_PORTA   host_port(0)
+#define SFR_PORTB   host_port(1)
+#define SFR_PORTC   host_port(2)
+#define SFR_PORTD   host_port(3)
+#define SFR_PORTE   host_port(4)
+#define SFR_LATA    HostLatch{0}
+#define SFR_LATB    HostLatch{1}
+#define SFR_LATC    HostLatch{2}
+#define SFR_LATD    HostLatch{3}
+#define SFR_LATE    HostLatch{4}
+#define SFR_TRISA   (cpu->tris[0])
+#define SFR_TRISB   (cpu->tris[1])
+#define SFR_TRISC   (cpu->tris[2])
+#define SFR_TRISD   (cpu->tris[3])
+#define SFR_TRISE   (cpu->tris[4])
+#define BIT_GIE     (cpu->gie)
+#define CCP_1       (cpu->ccp1)
+#define CCP_2       (cpu->ccp2)
+
+/*******               Interrupts                *******/
+
+#define GLOBAL      0x100
+#define H_TO_L      0
+#define L_TO_H      1
+
+// GLOBAL can be or'ed with a source, as in enable_interrupts(GLOBAL|INT_TIMER0)
+inline void enable_interrupts(int source) {
+   if(source & GLOBAL) {
+      cpu->gie = true;
+      source &= ~GLOBAL;
+      if(source) {
+         cpu->int_enable |= 1 << source;
+      }
+   } else {
+      cpu->int_enable |= 1 << source;
+   }
+   cpu->dispatch();
+}
+
+inline void disable_interrupts(int source) {
+   if(source == GLOBAL) {
+      cpu->gie = false;
+   } else {
+      cpu->int_enable &= ~(1 << source);
+   }
+}
+
+inline bool interrupt_active(int source) {
+   return (cpu->int_flag >> source) & 1;
+}
+
+inline void clear_interrupt(int source) {
+   cpu->int_flag &= ~(1 << source);
+}
+
+inline void ext_int_edge(int source, int edge) {}
+
+/*******                 Timers                  *******/
+
+#define T0_INTERNAL  0x00
+#define T0_DIV_1     0x08
+#define T0_DIV_2     0x00
+#define T0_DIV_4     0x01
+#define T0_DIV_8     0x02
+#define T0_DIV_16    0x03
+#define T0_DIV_32    0x04
+#define T0_DIV_64    0x05
+#define T0_DIV_128   0x06
+#define T0_DIV_256   0x07
+#define T0_8_BIT     0x80
+
+#define T1_INTERNAL  0x85
+#define T1_DIV_BY_1  0x00
+#define T1_DIV_BY_2  0x10
+#define T1_DIV_BY_4  0x20
+#define T1_DIV_BY_8  0x30
+
+#define T2_DISABLED  0x00
+#define T2_DIV_BY_1  0x04
+#define T2_DIV_BY_4  0x05
+#define T2_DIV_BY_16 0x06
+
+#define T3_INTERNAL  0x85
+#define T3_DIV_BY_1  0x00
+#define T3_DIV_BY_2  0x10
+#define T3_DIV_BY_4  0x20
+#define T3_DIV_BY_8  0x30
+
+#define CCP_OFF                  0x00
+#define CCP_CAPTURE_FE           0x04
+#define CCP_CAPTURE_RE           0x05
+#define CCP_COMPARE_RESET_TIMER  0x0B
+
+void setup_timer_0(int mode);
+void setup_timer_1(int mode);
+void setup_timer_2(int mode, int period, int postscale);
+void setup_timer_3(int mode);
+void setup_ccp1(int mode);
+void setup_ccp2(int mode);
+
+inline uint16_t get_timer0( void ) { return cpu->timer0(); }
+inline uint16_t get_timer1( void ) { return cpu->timer1(); }
+inline uint16_t get_timer3( void ) { return cpu->timer3(); }
+#define get_rtcc get_timer0
+void set_timer0(uint16_t value);
+void set_timer1(uint16_t value);
+
+/*******                  Pins                   *******/
+
+// Pin numbers are port * 8 + bit
+enum HostPins {
+   PIN_A0 = 0, PIN_A1, PIN_A2, PIN_A3, PIN_A4, PIN_A5, PIN_A6, PIN_A7,
+   PIN_B0, PIN_B1, PIN_B2, PIN_B3, PIN_B4, PIN_B5, PIN_B6, PIN_B7,
+   PIN_C0, PIN_C1, PIN_C2, PIN_C3, PIN_C4, PIN_C5, PIN_C6, PIN_C7,
+   PIN_D0, PIN_D1, PIN_D2, PIN_D3, PIN_D4, PIN_D5, PIN_D6, PIN_D7,
+   PIN_E0, PIN_E1, PIN_E2
+};
+
+void output_bit(int pin, int value);
+inline void output_high(int pin) { output_bit(pin,1); }
+inline void output_low(int pin) { output_bit(pin,0); }
+void output_toggle(int pin);
+void output_float(int pin);
+bool input(int pin);
+bool input_state(int pin);
+void output_a(uint8_t value);
+uint8_t input_a( void );
+
+template<class T> void host_set_tris(int port, T value) {
+   uint8_t byte;
+   memcpy(&byte, &value, 1);
+   cpu->tris[port] = byte;
+   cpu->pins_changed(port);
+}
+#define set_tris_a(v) host_set_tris(0,v)
+#define set_tris_b(v) host_set_tris(1,v)
+#define set_tris_c(v) host_set_tris(2,v)
+#define set_tris_d(v) host_set_tris(3,v)
+#define set_tris_e(v) host_set_tris(4,v)
+
+/*******                 Delays                  *******/
+
+inline void delay_cycles(int n) { cpu->cycles(n); }
+inline void delay_us(uint32_t n) { cpu->wait(n * SIM_US); }
+inline void delay_ms(uint32_t n) { cpu->wait(n * SIM_MS); }
+
+/*******            RS232, I2C, EEPROM           *******/
+
+inline void ccs_putc(char c) { cpu->putc(c); }
+inline char ccs_getc( void ) { return cpu->getc(); }
+inline bool ccs_kbhit( void ) { return cpu->kbhit(); }
+
+inline void i2c_start( void ) { cpu->i2c_start(); }
+inline void i2c_stop( void ) { cpu->i2c_stop(); }
+inline bool i2c_write(uint8_t data) { return cpu->i2c_write(data); }
+inline uint8_t i2c_read(int ack = 1) { return cpu->i2c_read(ack != 0); }
+
+inline uint8_t read_eeprom(uint8_t address) { return cpu->eeprom[address]; }
+inline void write_eeprom(uint8_t address, uint8_t value) {
+   cpu->eeprom[address] = value;
+   cpu->eeprom_writes++;
+   cpu->wait(4 * SIM_MS);
+}
+
+/*******              Bits and bytes             *******/
+
+template<class T> uint8_t make8(T value, int n) {
+   return (uint8_t)((uint32_t)value >> (8 * n));
+}
+inline uint16_t make16(uint8_t high, uint8_t low) {
+   return (uint16_t)(high << 8 | low);
+}
+inline uint32_t make32(uint8_t b3, uint8_t b2, uint8_t b1, uint8_t b0) {
+   return (uint32_t)b3 << 24 | (uint32_t)b2 << 16 | (uint32_t)b1 << 8 | b0;
+}
+inline uint32_t make32(uint16_t high, uint16_t low) {
+   return (uint32_t)high << 16 | low;
+}
+template<class T> bool bit_test(T value, int bit) {
+   return ((uint32_t)value >> bit) & 1;
+}
+template<class T> void bit_set(T &value, int bit) {
+   value |= (T)((T)1 << bit);
+}
+template<class T> void bit_clear(T &value, int bit) {
+   value &= (T)~((T)1 << bit);
+}
+
+/*******                 printf                  *******/
+
+// CCS formats: %c %s %u %d %x %X with width and zero padding, l for
+// 16 bit and L for 32 bit values. %c sends NULs too.
+template<class F> void ccs_vprintf(F out, const char *format, va_list args) {
+   char digits[16];
+   for(const char *f = format; *f; f++) {
+      if(*f != '%') {
+         out(*f);
+         continue;
+      }
+      f++;
+      bool zero = (*f == '0');
+      int width = 0;
+      while(*f >= '0' && *f <= '9') {
+         width = width * 10 + *f++ - '0';
+      }
+      int size = 8;
+      if(*f == 'l') { size = 16; f++; }
+      else if(*f == 'L') { size = 32; f++; }
+      if(*f == 'c') {
+         out((char)va_arg(args, int));
+         continue;
+      }
+      if(*f == 's') {
+         const char *s = va_arg(args, const char*);
+         int len = strlen(s);
+         for(int i = len; i < width; i++) out(' ');
+         while(*s) out(*s++);
+         continue;
+      }
+      if(*f == '%') {
+         out('%');
+         continue;
+      }
+      uint32_t value = va_arg(args, uint32_t);
+      if(size == 8) value &= 0xFF;
+      if(size == 16) value &= 0xFFFF;
+      bool negative = false;
+      if(*f == 'd') {
+         int32_t s = size == 8 ? (int8_t)value : size == 16 ? (int16_t)value
+                                                           : (int32_t)value;
+         negative = s < 0;
+         value = negative ? -s : s;
+      }
+      unsigned base = (*f == 'x' || *f == 'X') ? 16 : 10;
+      const char *set = *f == 'X' ? "0123456789ABCDEF" : "0123456789abcdef";
+      int n = 0;
+      do {
+         digits[n++] = set[value % base];
+         value /= base;
+      } while(value);
+      if(negative) {
+         if(zero) { out('-'); width--; }
+         else digits[n++] = '-';
+      }
+      for(int i = n; i < width; i++) out(zero ? '0' : ' ');
+      while(n) out(digits[--n]);
+   }
+}
+
+template<class F> void ccs_printf(F out, const char *format, ...) {
+   va_list args;
+   va_start(args, format);
+   ccs_vprintf(out, format, args);
+   va_end(args);
+}
+
+// Without a function the text goes to the RS232 port
+inline void ccs_printf(const char *format, ...) {
+   va_list args;
+   va_start(args, format);
+   ccs_vprintf(ccs_putc, format, args);
+   va_end(args);
+}
+
+#endif
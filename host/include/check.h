@@ -0,0 +1,31 @@
+// check.h - Assertions of the host tests
+//
+// CHECK() reports a failed condition and keeps going, the test returns
+// check_result() from main so make test sees every failure at once.
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond) \
+   ((cond) ? (void)0 : (void)(check_failures++, \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond)))
+
+#define CHECK_EQ(a,b) do { \
+   long long check_a = (long long)(a), check_b = (long long)(b); \
+   if(check_a != check_b) { \
+      check_failures++; \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", \
+              __FILE__, __LINE__, #a, #b, check_a, check_b); \
+   } \
+} while(0)
+
+static inline int check_result(const char *name) {
+   printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+   return check_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,31 @@
+// kp_old_scan.h - Nested keypad scan of KP4X4.c before the table scan
+//
+// Writes the row nibble of PORTD for each row and compares the column
+// nibble with every column pattern, 16 reads per scan. On the PIC a
+// write to PORTD is a read-modify-write of the port into the latch.
+// The patterns are compared as the 4 bit fields they are assigned to.
+
+#ifndef HOST_KP_OLD_SCAN_H
+#define HOST_KP_OLD_SCAN_H
+
+#include "ccs.h"
+
+static uint8_t kp_old_scan( void ) {
+   uint8_t key = 255;
+
+   for(uint8_t row = 0; row < 4; row++) {
+      // kp.row = 0b11110111 >> row
+      uint8_t port = SFR_PORTD;
+      SFR_LATD = (port & 0x0F) | (((0b11110111 >> row) & 0x0F) << 4);
+
+      for(uint8_t col = 0; col < 4; col++) {
+         // kp.col == (0b11110111 >> col)
+         if((SFR_PORTD & 0x0F) == ((0b11110111 >> col) & 0x0F)) {
+            key = row * 4 + col;
+         }
+      }
+   }
+   return key;
+}
+
+#endif
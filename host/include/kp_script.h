@@ -0,0 +1,38 @@
+// kp_script.h - Scripted key presses of the keypad tests and benchmarks
+//
+// A script is a list of presses on random keys, with random hold times,
+// gaps and contact bounce, always the same for a seed.
+
+#ifndef HOST_KP_SCRIPT_H
+#define HOST_KP_SCRIPT_H
+
+#include <vector>
+
+#include "sim.h"
+
+struct KpScript {
+   uint32_t state;
+
+   explicit KpScript(uint32_t seed) : state(seed) {}
+
+   unsigned next(unsigned n) {
+      state = state * 1103515245u + 12345u;
+      return (state >> 8) % n;
+   }
+
+   // Adds count presses to pad from start, returns the end of the last.
+   // Every press is stable for at least 30 ms between its bounces.
+   SimTime presses(Keypad &pad, int count, SimTime start,
+                   unsigned max_bounce_ms, unsigned max_hold_ms = 400) {
+      SimTime t = start;
+      for(int i = 0; i < count; i++) {
+         unsigned bounce = max_bounce_ms ? next(max_bounce_ms + 1) : 0;
+         unsigned hold = bounce + 30 + next(max_hold_ms - 30);
+         pad.press(next(16), t * 1, hold * SIM_MS, bounce * SIM_MS);
+         t += (hold + bounce + 40 + next(200)) * SIM_MS;
+      }
+      return t;
+   }
+};
+
+#endif
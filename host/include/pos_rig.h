@@ -0,0 +1,64 @@
+// pos_rig.h - POS slave board of the host benchmarks
+//
+// The slave program of units/pos_slave.cpp on a 5 MHz Cpu, with the
+// 24LC04B and the 2x16 LCD of its board. seed() writes a catalog of n
+// products straight into the EEPROM, in the layout of POS_SLAVE.c.
+
+#ifndef HOST_POS_RIG_H
+#define HOST_POS_RIG_H
+
+#include <stdio.h>
+
+#include "sim.h"
+
+namespace pos_slave {
+void program_main( void );
+}
+
+#define POS_SLAVE_PROGRAM 1
+#define POS_CATALOG_MAX   25
+#define POS_GEN_ADDR      0x1FF
+
+struct PosSlaveRig {
+   Cpu cpu;
+   Eeprom24 eeprom{512};
+   Hd44780 lcd{3, 2, 16};
+
+   PosSlaveRig() {
+      cpu.name = "pos_slave";
+      cpu.program = POS_SLAVE_PROGRAM;
+      cpu.clock = 5000000;
+      cpu.i2c.devices.push_back(&eeprom);
+      cpu.pin_devices.push_back(&lcd);
+   }
+
+   // Prices are kept clear of 13 in both bytes, the link ends a product
+   // on the first 13 it receives
+   static unsigned price(int i) {
+      unsigned p = 15 + (i * 37) % 900;
+      while((p & 0xFF) == 13 || (p >> 8) == 13) {
+         p++;
+      }
+      return p;
+   }
+
+   void seed(int n) {
+      eeprom.mem[0] = n;
+      for(int i = 0; i < n; i++) {
+         uint8_t *p = &eeprom.mem[1 + i * 20];
+         snprintf((char*)p, 7, "%06d", i);
+         snprintf((char*)p + 7, 11, "ITEM%06d", i);
+         p[18] = price(i) >> 8;
+         p[19] = price(i) & 0xFF;
+      }
+      eeprom.mem[POS_GEN_ADDR] = 0;
+   }
+
+   // Connects the UART of the slave to the one of the master
+   void connect(Cpu &master) {
+      master.uart.peer = &cpu;
+      cpu.uart.peer = &master;
+   }
+};
+
+#endif
@@ -0,0 +1,67 @@
+// rtc_rig.h - Master and slave boards of the RTC AND ALARM project
+//
+// RtcSlaveRig has the DS1307, with its square wave on INT2, and the
+// 24LC04B on the I2C bus. RtcMasterRig has the 4x20 LCD on port B and
+// the keypad on port D. Both run at 5 MHz (RTC_COMMUNICATION.c). The
+// programs are the ones of units/rtc_*.cpp: the current master and slave
+// and the ones of the base revision (gen-base), which polled the slave.
+
+#ifndef HOST_RTC_RIG_H
+#define HOST_RTC_RIG_H
+
+#include "sim.h"
+
+namespace rtc_master { void program_main( void ); }
+namespace rtc_slave { void program_main( void ); }
+namespace rtc_master_base { void program_main( void ); }
+namespace rtc_slave_base { void program_main( void ); }
+
+#define RTC_MASTER_PROGRAM       0
+#define RTC_SLAVE_PROGRAM        1
+#define RTC_MASTER_BASE_PROGRAM  2
+#define RTC_SLAVE_BASE_PROGRAM   3
+
+struct RtcSlaveRig {
+   Cpu cpu;
+   Ds1307 rtc;
+   Eeprom24 eeprom{512};
+
+   explicit RtcSlaveRig(bool base = false) {
+      cpu.name = "rtc_slave";
+      cpu.program = base ? RTC_SLAVE_BASE_PROGRAM : RTC_SLAVE_PROGRAM;
+      cpu.clock = 5000000;
+      cpu.i2c.devices.push_back(&rtc);
+      cpu.i2c.devices.push_back(&eeprom);
+      rtc.sqw = &cpu;
+   }
+
+   void program(bool base) {
+      base ? rtc_slave_base::program_main() : rtc_slave::program_main();
+   }
+};
+
+struct RtcMasterRig {
+   Cpu cpu;
+   Hd44780 lcd{1, 4, 20};
+   Keypad pad;
+
+   explicit RtcMasterRig(bool base = false) {
+      cpu.name = "rtc_master";
+      cpu.program = base ? RTC_MASTER_BASE_PROGRAM : RTC_MASTER_PROGRAM;
+      cpu.clock = 5000000;
+      cpu.pin_devices.push_back(&lcd);
+      cpu.pin_devices.push_back(&pad);
+   }
+
+   void program(bool base) {
+      base ? rtc_master_base::program_main() : rtc_master::program_main();
+   }
+
+   // Connects the UART of the master to the one of the slave
+   void connect(RtcSlaveRig &slave) {
+      cpu.uart.peer = &slave.cpu;
+      slave.cpu.uart.peer = &cpu;
+   }
+};
+
+#endif
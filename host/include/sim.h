@@ -0,0 +1,372 @@
+////////////////////////////////////////////////////////////////////////////
+////                               SIM.H                                ////
+////       Virtual PIC18F4550 and the devices of the boards             ////
+////                                                                    ////
+////  Cpu        Virtual time, interrupts, timers, ports, UART, I2C     ////
+////             bus and internal EEPROM of one microcontroller         ////
+////                                                                    ////
+////  Sim        Runs one or more Cpu in step. Every Cpu runs in its    ////
+////             own thread, only the one furthest behind in virtual    ////
+////             time runs, so the threads never overlap.               ////
+////                                                                    ////
+////  Models     I2cBus, Eeprom24 (24LC04B/08B), Ds1307, Hd44780 and    ////
+////             Keypad, with the counters the benchmarks report        ////
+////                                                                    ////
+////////////////////////////////////////////////////////////////////////////
+
+// Virtual time is kept in nanoseconds. The code of the programs takes no
+// time by itself: time only moves in delays, I2C transfers, waits on the
+// UART, spin loops (HOST_SPIN) and main loop passes (host_loop), which
+// cost Cpu::loop_ns each. Interrupts are dispatched whenever time moves
+// and GLOBAL is enabled.
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+typedef uint64_t SimTime;      // Nanoseconds
+
+#define SIM_US       1000ULL
+#define SIM_MS       1000000ULL
+#define SIM_SEC      1000000000ULL
+#define SIM_NEVER    UINT64_MAX
+
+// Interrupt sources, also the dispatch order
+enum HostInterrupts {
+   INT_EXT, INT_EXT1, INT_EXT2, INT_RDA, INT_TIMER0, INT_TIMER1,
+   INT_TIMER2, INT_TIMER3, INT_CCP1, INT_CCP2, HOST_INTS
+};
+
+#define HOST_PROGRAMS 4
+
+typedef void (*HostIsrFn)(void);
+extern HostIsrFn host_isrs[HOST_PROGRAMS][HOST_INTS];
+
+// Registers an #int_xxx function of a program
+struct HostIsr {
+   HostIsr(int vector, int program, HostIsrFn fn) {
+      host_isrs[program][vector] = fn;
+   }
+};
+
+// Thrown when a Cpu reaches the end of the simulation
+struct HostStop {};
+
+struct Cpu;
+class Sim;
+
+// A device on the pins of a port
+struct PinDevice {
+   virtual ~PinDevice() {}
+   virtual void pins_changed(Cpu &cpu, int port) {}
+   // Level of the input pins, bits not driven are left as found
+   virtual uint8_t pins_input(Cpu &cpu, int port, uint8_t level) {
+      return level;
+   }
+};
+
+// A device on the I2C bus
+struct I2cDevice {
+   virtual ~I2cDevice() {}
+   virtual bool claims(uint8_t address) = 0;    // 7 bit address
+   virtual bool start(Cpu &cpu, uint8_t control) = 0;  // true is ACK
+   virtual bool write(Cpu &cpu, uint8_t data) = 0;
+   virtual uint8_t read(Cpu &cpu, bool ack) = 0;
+   virtual void stop(Cpu &cpu) = 0;
+
+   uint64_t transactions = 0;      // That addressed it, see I2cBus
+};
+
+// Software I2C master at 100 kHz
+struct I2cBus {
+   std::vector<I2cDevice*> devices;
+   I2cDevice *active = nullptr;
+   I2cDevice *counted = nullptr;   // Last device of the transaction
+   bool addressing = false;     // Next write is the control byte
+   bool in_transaction = false;
+
+   uint64_t transactions = 0;   // START to STOP
+   uint64_t starts = 0;         // Repeated starts included
+   uint64_t bytes = 0;          // Control, address and data bytes
+   uint64_t nacks = 0;
+   SimTime busy_ns = 0;         // Time the bus was driven
+
+   void reset_counters() {
+      transactions = starts = bytes = nacks = 0;
+      busy_ns = 0;
+   }
+};
+
+struct UartPeer;
+
+// Receiver and transmitter of the RS232 port, 9600 8N1
+struct Uart {
+   SimTime byte_ns = 1041667;   // 10 bits at 9600 baud
+   SimTime tx_done = 0;         // Last queued byte leaves the pin
+   std::vector<uint8_t> fifo;   // RCREG, 2 bytes deep
+   UartPeer *peer = nullptr;
+
+   uint64_t tx_bytes = 0;
+   uint64_t rx_bytes = 0;
+   uint64_t overruns = 0;
+};
+
+// Other end of a UART: another Cpu or a script
+struct UartPeer {
+   virtual ~UartPeer() {}
+   virtual void receive(uint8_t c, SimTime at) = 0;
+};
+
+struct Cpu : UartPeer {
+   std::string name;
+   int program = 0;             // ISR table of the program it runs
+   uint32_t clock = 20000000;   // Oscillator (Hz)
+   SimTime now = 0;
+   SimTime loop_ns = 0;         // Cost of a main loop pass
+   SimTime spin_ns = 20 * SIM_US;   // Longest step of a spin loop
+   unsigned isr_entry_cycles = 40;  // Latency and context save
+   Sim *sim = nullptr;
+   SimTime target = 0;          // Time it is waiting to reach
+   uint64_t loops = 0;          // Main loop passes
+
+   // Interrupts
+   bool gie = false;
+   bool in_isr = false;
+   uint16_t int_enable = 0;
+   uint16_t int_flag = 0;
+   uint64_t isr_calls[HOST_INTS] = {};
+
+   // Ports A - E
+   uint8_t lat[5] = {};
+   uint8_t tris[5] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+   uint32_t port_word[5] = {};
+   std::vector<PinDevice*> pin_devices;
+   uint64_t port_reads[5] = {};     // PORTx reads of the program
+   uint64_t lat_writes[5] = {};     // LATx writes of the program
+
+   // Timers
+   uint16_t t0_div = 1; bool t0_on = false;  bool t0_8bit = false;
+   SimTime t0_base = 0; uint16_t t0_start = 0; uint64_t t0_gen = 0;
+   uint8_t t1_div = 1;  bool t1_on = false;
+   SimTime t1_base = 0; uint16_t t1_start = 0; uint64_t t1_gen = 0;
+   uint16_t ccp1 = 0;   bool ccp1_reset = false;
+   uint16_t ccp2 = 0;   bool ccp2_capture = false;
+   uint64_t t2_gen = 0;
+   uint8_t t3_div = 1;  bool t3_on = false; SimTime t3_base = 0;
+
+   // Peripherals
+   Uart uart;
+   I2cBus i2c;
+   uint8_t eeprom[256];
+   uint64_t eeprom_writes = 0;
+
+   Cpu();
+
+   // Time
+   void advance(SimTime until);        // Runs events and interrupts
+   void wait(SimTime ns) { advance(now + ns); }
+   void spin();                        // A pass of a busy wait
+   void loop();                        // A pass of the main loop
+   void cycles(uint64_t n);
+   SimTime tcy() const { return 4000000000ULL / clock; }
+   void at(SimTime when, std::function<void()> fn);
+   SimTime next_event() const;
+   void dispatch();
+
+   // Ports
+   uint8_t read_port(int port);
+   void pins_changed(int port);
+
+   // Timers
+   uint16_t timer0();
+   uint16_t timer1();
+   uint16_t timer3();
+   void schedule_timer0();
+   void schedule_timer1();
+   void capture_ccp2();                // Falling edge on the CCP2 pin
+
+   // UART
+   void putc(uint8_t c);
+   uint8_t getc();
+   bool kbhit() { return !uart.fifo.empty(); }
+   void receive(uint8_t c, SimTime at) override;
+
+   // I2C
+   void i2c_start();
+   void i2c_stop();
+   bool i2c_write(uint8_t data);
+   uint8_t i2c_read(bool ack);
+
+private:
+   struct Event {
+      SimTime t;
+      uint64_t seq;
+      std::function<void()> fn;
+      bool operator<(const Event &e) const {
+         return t != e.t ? t > e.t : seq > e.seq;
+      }
+   };
+   std::priority_queue<Event> events;
+   uint64_t seq = 0;
+};
+
+// CPU running the code of the current thread
+extern thread_local Cpu *cpu;
+
+class Sim {
+public:
+   explicit Sim(SimTime end) : end(end) {}
+
+   // Runs every program until end, each on its Cpu
+   void add(Cpu &cpu, std::function<void()> program);
+   void run();
+
+   void wait_turn(Cpu &cpu);           // Called by Cpu::advance
+   SimTime end;
+
+   // A Cpu keeps running while it is less than this ahead of the others.
+   // Only safe when they only talk through the UART, whose bytes take
+   // longer than this to arrive: Uart::byte_ns at most.
+   SimTime lookahead = 0;
+
+private:
+   struct Entry { Cpu *cpu; std::function<void()> program; };
+   std::vector<Entry> cpus;
+   size_t first() const;               // Cpu furthest behind
+   struct State;
+   State *state = nullptr;
+};
+
+// Runs fn with c as the CPU of the thread, without a Sim
+struct CpuScope {
+   Cpu *saved;
+   explicit CpuScope(Cpu &c) : saved(cpu) { cpu = &c; }
+   ~CpuScope() { cpu = saved; }
+};
+
+/*******              Device models              *******/
+
+// MicroChip 24LC04B/08B/16B, 16 byte pages and a 5 ms write cycle
+struct Eeprom24 : I2cDevice {
+   std::vector<uint8_t> mem;
+   std::vector<uint32_t> wear;     // Write cycles of every byte
+   SimTime busy_until = 0;
+   uint16_t pointer = 0;
+   uint8_t block = 0;
+   int phase = 0;                  // 0 address, 1 data
+   bool writing = false;
+   std::vector<std::pair<uint16_t,uint8_t>> pending;
+
+   uint64_t write_cycles = 0;      // Byte and page writes
+   uint64_t read_bytes = 0;
+   uint64_t busy_polls = 0;        // Control bytes refused while busy
+
+   explicit Eeprom24(size_t size) : mem(size, 0xFF), wear(size, 0) {}
+   bool claims(uint8_t address) override {
+      return (address & 0x78) == 0x50 && (size_t)(address & 7) * 256 < mem.size();
+   }
+   bool start(Cpu &cpu, uint8_t control) override;
+   bool write(Cpu &cpu, uint8_t data) override;
+   uint8_t read(Cpu &cpu, bool ack) override;
+   void stop(Cpu &cpu) override;
+   void reset_counters() { write_cycles = read_bytes = busy_polls = transactions = 0; }
+};
+
+// Dallas DS1307, time kept in seconds since 2000 from virtual time
+struct Ds1307 : I2cDevice {
+   uint8_t nvram[56] = {};
+   uint8_t control = 0x03;
+   double ppm = 0;                 // Frequency error of its crystal
+   uint64_t base_secs = 0;         // Seconds since 2000 at base_time
+   SimTime base_time = 0;
+   bool halted = false;
+   uint8_t pointer = 0;
+   int phase = 0;
+   uint8_t latched[7] = {};        // User buffer, copied on every START
+   uint8_t written[7] = {};
+   bool time_written = false;
+   Cpu *sqw = nullptr;             // Gets INT_EXT2 on every falling edge
+   bool sqw_on_ccp2 = false;       // Or a CCP2 capture
+   uint64_t sqw_gen = 0;           // Edges of older start_sqw() are dropped
+
+   uint64_t nvram_reads = 0;       // Bytes
+   uint64_t nvram_writes = 0;
+
+   bool claims(uint8_t address) override { return address == 0x68; }
+   bool start(Cpu &cpu, uint8_t control) override;
+   bool write(Cpu &cpu, uint8_t data) override;
+   uint8_t read(Cpu &cpu, bool ack) override;
+   void stop(Cpu &cpu) override;
+
+   uint64_t seconds(SimTime at) const;       // Seconds since 2000
+   SimTime next_second(SimTime at) const;    // Time of the next tick
+   void set(uint64_t secs, SimTime at);
+   void start_sqw(Cpu &cpu);                 // Schedules the edges
+};
+
+// Date of a number of seconds since 2000, independent of the libraries
+struct CivilTime {
+   int year, mth, day, dow, hour, min, sec;   // dow 1 = Sunday
+};
+CivilTime civil_from_secs(uint64_t secs);
+uint64_t secs_from_civil(int year, int mth, int day, int hour, int min, int sec);
+
+// HD44780 controller on the E, RS, RW and D4-D7 pins of a port
+struct Hd44780 : PinDevice {
+   int port;                       // 1 port B, 3 port D
+   int lines, width;
+   uint8_t ddram[128];
+   uint8_t cgram[64];
+   uint8_t ac = 0;                 // Address counter
+   bool cg = false;                // AC points to the CGRAM
+   uint8_t shift = 0;              // Display shift (0 - 39)
+   bool four_bit = false;
+   bool high_nibble = true;
+   uint8_t latch = 0;
+   uint8_t read_value = 0;
+   bool e = false;
+   SimTime busy_until = 0;
+
+   uint64_t instructions = 0;
+   uint64_t data_writes = 0;
+   uint64_t data_reads = 0;
+   uint64_t status_reads = 0;
+   uint64_t busy_writes = 0;       // Bytes sent while busy, lost
+   uint64_t cgram_writes = 0;
+   std::function<void(uint8_t)> on_data;   // Every DDRAM character
+
+   Hd44780(int port, int lines = 4, int width = 20);
+   void pins_changed(Cpu &cpu, int port) override;
+   uint8_t pins_input(Cpu &cpu, int port, uint8_t level) override;
+   void execute(Cpu &cpu, bool rs, uint8_t value);
+   std::string line(int y) const;   // Visible text of a line (1 - 4)
+   uint64_t bytes() const { return instructions + data_writes; }
+   void reset_counters() {
+      instructions = data_writes = data_reads = 0;
+      status_reads = busy_writes = cgram_writes = 0;
+   }
+};
+
+// 4x4 keypad on port D, pressed keys short a row to a column
+struct Keypad : PinDevice {
+   struct Press {
+      int key;                     // row*4 + col
+      SimTime down, up;
+      SimTime bounce;              // Contact chatter after each edge
+   };
+   std::vector<Press> presses;
+   uint32_t seed = 12345;
+
+   void press(int key, SimTime down, SimTime hold, SimTime bounce = 0) {
+      presses.push_back({ key, down, down + hold, bounce });
+   }
+   bool closed(int key, SimTime at) const;
+   uint8_t pins_input(Cpu &cpu, int port, uint8_t level) override;
+};
+
+#endif
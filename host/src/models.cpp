@@ -0,0 +1,417 @@
+// Models of the devices on the boards: 24LC0xB, DS1307, HD44780, keypad
+
+#include <cmath>
+#include <memory>
+
+#include "ccs.h"
+
+/*******           24LC04B / 08B / 16B           *******/
+
+#define EEPROM_WRITE_NS  (5 * SIM_MS)
+#define EEPROM_PAGE      16
+
+bool Eeprom24::start(Cpu &c, uint8_t control) {
+   if(c.now < busy_until) {
+      busy_polls++;
+      return false;
+   }
+   block = (control >> 1) & 7;
+   if(control & 1) {
+      phase = 2;
+   } else {
+      phase = 0;
+      writing = false;
+      pending.clear();
+   }
+   return true;
+}
+
+bool Eeprom24::write(Cpu &c, uint8_t data) {
+   if(phase == 0) {
+      pointer = (block * 256 + data) % mem.size();
+      phase = 1;
+      return true;
+   }
+   if(phase != 1) {
+      return false;
+   }
+
+   // The address rolls over inside the page while data is written
+   pending.push_back({ pointer, data });
+   pointer = (pointer & ~(EEPROM_PAGE - 1)) | ((pointer + 1) & (EEPROM_PAGE - 1));
+   writing = true;
+   return true;
+}
+
+uint8_t Eeprom24::read(Cpu &c, bool ack) {
+   uint8_t value = mem[pointer];
+   pointer = (pointer + 1) % mem.size();
+   read_bytes++;
+   return value;
+}
+
+void Eeprom24::stop(Cpu &c) {
+   if(writing && !pending.empty()) {
+      for(auto &p : pending) {
+         mem[p.first] = p.second;
+         wear[p.first]++;
+      }
+      write_cycles++;
+      busy_until = c.now + EEPROM_WRITE_NS;
+   }
+   pending.clear();
+   writing = false;
+}
+
+/*******                 Calendar                *******/
+
+static int month_days(int year, int mth) {
+   static const int days[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
+   return mth == 2 && year % 4 == 0 ? 29 : days[mth - 1];
+}
+
+CivilTime civil_from_secs(uint64_t secs) {
+   CivilTime t;
+   uint64_t days = secs / 86400;
+   uint32_t rest = secs % 86400;
+
+   t.hour = rest / 3600;
+   t.min = rest / 60 % 60;
+   t.sec = rest % 60;
+   t.dow = (days + 6) % 7 + 1;       // 1 Jan 2000 was a Saturday
+   t.year = 2000;
+   while(days >= (uint64_t)(t.year % 4 == 0 ? 366 : 365)) {
+      days -= t.year % 4 == 0 ? 366 : 365;
+      t.year++;
+   }
+   t.mth = 1;
+   while(days >= (uint64_t)month_days(t.year, t.mth)) {
+      days -= month_days(t.year, t.mth);
+      t.mth++;
+   }
+   t.day = days + 1;
+   return t;
+}
+
+uint64_t secs_from_civil(int year, int mth, int day, int hour, int min, int sec) {
+   uint64_t days = 0;
+   for(int y = 2000; y < year; y++) {
+      days += y % 4 == 0 ? 366 : 365;
+   }
+   for(int m = 1; m < mth; m++) {
+      days += month_days(year, m);
+   }
+   days += day - 1;
+   return days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+/*******                  DS1307                 *******/
+
+static uint8_t bcd(int v) { return (v / 10) << 4 | v % 10; }
+static int unbcd(uint8_t v) { return (v >> 4) * 10 + (v & 0x0F); }
+
+uint64_t Ds1307::seconds(SimTime at) const {
+   if(halted || at < base_time) {
+      return base_secs;
+   }
+   long double elapsed = (long double)(at - base_time) * (1 + ppm * 1e-6L);
+   return base_secs + (uint64_t)(elapsed / SIM_SEC);
+}
+
+SimTime Ds1307::next_second(SimTime at) const {
+   uint64_t s = seconds(at) + 1 - base_secs;
+   long double t = (long double)s * SIM_SEC / (1 + ppm * 1e-6L);
+   return base_time + (SimTime)ceill(t);
+}
+
+void Ds1307::set(uint64_t secs, SimTime at) {
+   base_secs = secs;
+   base_time = at;
+}
+
+// The user buffer is loaded from the counters on every START
+bool Ds1307::start(Cpu &c, uint8_t ctl) {
+   CivilTime t = civil_from_secs(seconds(c.now));
+
+   latched[0] = bcd(t.sec) | (halted ? 0x80 : 0);
+   latched[1] = bcd(t.min);
+   latched[2] = bcd(t.hour);
+   latched[3] = bcd(t.dow);
+   latched[4] = bcd(t.day);
+   latched[5] = bcd(t.mth);
+   latched[6] = bcd(t.year - 2000);
+   memcpy(written, latched, sizeof(written));
+   phase = (ctl & 1) ? 2 : 0;
+   return true;
+}
+
+bool Ds1307::write(Cpu &c, uint8_t data) {
+   if(phase == 0) {
+      pointer = data & 0x3F;
+      phase = 1;
+      return true;
+   }
+   if(pointer < 7) {
+      written[pointer] = data;
+      time_written = true;
+   } else if(pointer == 7) {
+      bool was = control & 0x10;
+      control = data;
+      if(!was && (control & 0x10) && sqw) {
+         start_sqw(*sqw);
+      }
+   } else {
+      nvram[pointer - 8] = data;
+      nvram_writes++;
+   }
+   pointer = (pointer + 1) & 0x3F;
+   return true;
+}
+
+uint8_t Ds1307::read(Cpu &c, bool ack) {
+   uint8_t value;
+   if(pointer < 7) {
+      value = latched[pointer];
+   } else if(pointer == 7) {
+      value = control;
+   } else {
+      value = nvram[pointer - 8];
+      nvram_reads++;
+   }
+   pointer = (pointer + 1) & 0x3F;
+   return value;
+}
+
+// Time registers written in the transaction set the clock at the STOP
+void Ds1307::stop(Cpu &c) {
+   if(time_written) {
+      halted = written[0] & 0x80;
+      uint64_t secs = secs_from_civil(2000 + unbcd(written[6]),
+         unbcd(written[5] & 0x1F), unbcd(written[4] & 0x3F),
+         unbcd(written[2] & 0x3F), unbcd(written[1] & 0x7F),
+         unbcd(written[0] & 0x7F));
+      set(secs, c.now);
+      if(sqw && (control & 0x10)) {
+         start_sqw(*sqw);
+      }
+   }
+   time_written = false;
+}
+
+// 1 Hz output, falling edge when the seconds change
+void Ds1307::start_sqw(Cpu &c) {
+   uint64_t gen = ++sqw_gen;
+   std::shared_ptr<std::function<void()>> edge =
+      std::make_shared<std::function<void()>>();
+   Cpu *target = &c;
+
+   *edge = [this, target, gen, edge]() {
+      target->at(next_second(target->now), [this, target, gen, edge]() {
+         if(gen != sqw_gen || !(control & 0x10)) {
+            return;
+         }
+         if(sqw_on_ccp2) {
+            target->capture_ccp2();
+         } else {
+            target->int_flag |= 1 << INT_EXT2;
+         }
+         (*edge)();
+      });
+   };
+   (*edge)();
+}
+
+/*******                 HD44780                 *******/
+
+#define LCD_EXEC_NS   (37 * SIM_US)
+#define LCD_CLEAR_NS  (1520 * SIM_US)
+
+Hd44780::Hd44780(int port, int lines, int width)
+   : port(port), lines(lines), width(width) {
+   memset(ddram, ' ', sizeof(ddram));
+   memset(cgram, 0, sizeof(cgram));
+}
+
+// Next DDRAM address, the two lines are 0x00-0x27 and 0x40-0x67
+static uint8_t ddram_next(uint8_t ac, int step) {
+   uint8_t row = ac & 0x40;
+   uint8_t col = ((ac & 0x3F) + 40 + step) % 40;
+   if(step > 0 && col == 0) {
+      row ^= 0x40;
+   }
+   if(step < 0 && col == 39) {
+      row ^= 0x40;
+   }
+   return row | col;
+}
+
+void Hd44780::execute(Cpu &c, bool rs, uint8_t v) {
+   if(c.now < busy_until) {
+      busy_writes++;
+      return;
+   }
+   busy_until = c.now + LCD_EXEC_NS;
+
+   if(rs) {
+      if(cg) {
+         cgram[ac & 0x3F] = v;
+         ac = (ac + 1) & 0x3F;
+         cgram_writes++;
+      } else {
+         ddram[ac & 0x7F] = v;
+         ac = ddram_next(ac, 1);
+         if(on_data) {
+            on_data(v);
+         }
+      }
+      data_writes++;
+      return;
+   }
+
+   instructions++;
+   if(v >= 0x80) {
+      cg = false;
+      ac = v & 0x7F;
+   } else if(v >= 0x40) {
+      cg = true;
+      ac = v & 0x3F;
+   } else if(v >= 0x20) {
+      four_bit = !(v & 0x10);
+   } else if(v >= 0x10) {
+      if(v & 0x08) {
+         shift = (v & 0x04) ? (shift + 39) % 40 : (shift + 1) % 40;
+      } else if(!cg) {
+         ac = ddram_next(ac, (v & 0x04) ? 1 : -1);
+      }
+   } else if(v >= 0x04) {
+      // Entry mode and display control, always increment and on here
+   } else if(v >= 0x02) {
+      ac = 0;
+      cg = false;
+      shift = 0;
+      busy_until = c.now + LCD_CLEAR_NS;
+   } else if(v == 0x01) {
+      memset(ddram, ' ', sizeof(ddram));
+      ac = 0;
+      cg = false;
+      shift = 0;
+      busy_until = c.now + LCD_CLEAR_NS;
+   }
+}
+
+void Hd44780::pins_changed(Cpu &c, int p) {
+   if(p != port) {
+      return;
+   }
+   bool now_e = c.lat[p] & 0x01 && !(c.tris[p] & 0x01);
+   bool rs = c.lat[p] & 0x02;
+   bool rw = c.lat[p] & 0x04;
+
+   if(now_e == e) {
+      return;
+   }
+   e = now_e;
+
+   if(e && rw) {
+      // Status or data read, the byte is fetched on the first nibble
+      if(high_nibble) {
+         if(rs) {
+            read_value = cg ? cgram[ac & 0x3F] : ddram[ac & 0x7F];
+         } else {
+            read_value = (c.now < busy_until ? 0x80 : 0) | (ac & 0x7F);
+         }
+      }
+      return;
+   }
+
+   if(!e && rw) {
+      if(!four_bit || !high_nibble) {
+         if(rs) {
+            data_reads++;
+            ac = cg ? (ac + 1) & 0x3F : ddram_next(ac, 1);
+         } else {
+            status_reads++;
+         }
+      }
+      high_nibble = four_bit ? !high_nibble : true;
+      return;
+   }
+
+   if(!e) {
+      uint8_t nibble = c.lat[p] >> 4;
+      if(!four_bit) {
+         // 8 bit mode until the function set, D0-D3 read as 0
+         execute(c, rs, nibble << 4);
+         high_nibble = true;
+      } else if(high_nibble) {
+         latch = nibble << 4;
+         high_nibble = false;
+      } else {
+         high_nibble = true;
+         execute(c, rs, latch | nibble);
+      }
+   }
+}
+
+uint8_t Hd44780::pins_input(Cpu &c, int p, uint8_t level) {
+   if(p != port || !e || !(c.lat[p] & 0x04)) {
+      return level;
+   }
+   uint8_t nibble = (!four_bit || high_nibble) ? read_value >> 4 : read_value & 0x0F;
+   uint8_t inputs = c.tris[p] & 0xF0;
+   return (level & ~inputs) | ((nibble << 4) & inputs);
+}
+
+std::string Hd44780::line(int y) const {
+   static const uint8_t base[4] = { 0x00, 0x40, 0x00, 0x40 };
+   std::string text;
+   int offset = y > 2 ? width : 0;
+   for(int i = 0; i < width; i++) {
+      text += (char)ddram[base[y - 1] + (offset + shift + i) % 40];
+   }
+   return text;
+}
+
+/*******                 Keypad                  *******/
+
+// Chatter of a contact, changing every 100 us
+static bool chatter(uint32_t seed, int key, SimTime at) {
+   uint32_t h = seed ^ (uint32_t)(at / (100 * SIM_US)) * 2654435761u ^ key * 40503u;
+   h ^= h >> 13;
+   h *= 0x5bd1e995;
+   h ^= h >> 15;
+   return h & 1;
+}
+
+bool Keypad::closed(int key, SimTime at) const {
+   for(const Press &p : presses) {
+      if(p.key != key || at < p.down || at >= p.up + p.bounce) {
+         continue;
+      }
+      if(at < p.down + p.bounce || at >= p.up) {
+         return chatter(seed, key, at);
+      }
+      return true;
+   }
+   return false;
+}
+
+// Rows D7 (row 0) to D4 are outputs, columns D3 (col 0) to D0 inputs
+uint8_t Keypad::pins_input(Cpu &c, int p, uint8_t level) {
+   if(p != 3) {
+      return level;
+   }
+   for(int row = 0; row < 4; row++) {
+      uint8_t row_pin = 1 << (7 - row);
+      if((c.tris[3] & row_pin) || (c.lat[3] & row_pin)) {
+         continue;
+      }
+      for(int col = 0; col < 4; col++) {
+         uint8_t col_pin = 1 << (3 - col);
+         if((c.tris[3] & col_pin) && closed(row * 4 + col, c.now)) {
+            level &= ~col_pin;
+         }
+      }
+   }
+   return level;
+}
@@ -0,0 +1,515 @@
+// Virtual PIC18F4550: time, interrupts, timers, ports, UART and I2C
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ccs.h"
+
+HostIsrFn host_isrs[HOST_PROGRAMS][HOST_INTS];
+thread_local Cpu *cpu = nullptr;
+
+// Time of the n-th count of a timer started at base
+static SimTime count_time(const Cpu &c, SimTime base, unsigned div, uint64_t n) {
+   unsigned __int128 num = (unsigned __int128)n * 4000000000ULL * div;
+   return base + (SimTime)((num + c.clock - 1) / c.clock);
+}
+
+// Counts of a timer started at base
+static uint64_t counts(const Cpu &c, SimTime base, unsigned div) {
+   if(c.now < base) {
+      return 0;
+   }
+   unsigned __int128 num = (unsigned __int128)(c.now - base) * c.clock;
+   return (uint64_t)(num / (4000000000ULL * div));
+}
+
+Cpu::Cpu() {
+   memset(eeprom, 0xFF, sizeof(eeprom));
+}
+
+/*******                  Time                   *******/
+
+void Cpu::at(SimTime when, std::function<void()> fn) {
+   events.push({ when, seq++, fn });
+}
+
+SimTime Cpu::next_event() const {
+   return events.empty() ? SIM_NEVER : events.top().t;
+}
+
+void Cpu::advance(SimTime until) {
+   bool stop = false;
+
+   if(until < now) {
+      until = now;
+   }
+   if(sim) {
+      if(until >= sim->end) {
+         until = sim->end;
+         stop = true;
+      }
+      target = until;
+      sim->wait_turn(*this);
+   }
+
+   while(!events.empty() && events.top().t <= until) {
+      Event e = events.top();
+      events.pop();
+      if(e.t > now) {
+         now = e.t;
+      }
+      e.fn();
+      dispatch();
+   }
+   if(until > now) {
+      now = until;
+   }
+   dispatch();
+
+   if(stop) {
+      throw HostStop();
+   }
+}
+
+void Cpu::spin() {
+   SimTime step = std::min(next_event(), now + spin_ns);
+   advance(std::max(step, now + tcy()));
+}
+
+void Cpu::loop() {
+   loops++;
+   wait(loop_ns ? loop_ns : 100 * tcy());
+}
+
+void Cpu::cycles(uint64_t n) {
+   wait(n * tcy());
+}
+
+// Runs the pending interrupts while GLOBAL is enabled
+void Cpu::dispatch() {
+   while(gie && !in_isr) {
+      uint16_t pending = int_flag;
+      if(!uart.fifo.empty()) {
+         pending |= 1 << INT_RDA;
+      }
+      pending &= int_enable;
+      if(pending == 0) {
+         return;
+      }
+
+      int vector = 0;
+      while(!(pending & (1 << vector))) {
+         vector++;
+      }
+      HostIsrFn fn = host_isrs[program][vector];
+      int_flag &= ~(1 << vector);
+      if(!fn) {
+         if(vector == INT_RDA) {
+            return;
+         }
+         continue;
+      }
+
+      size_t waiting = uart.fifo.size();
+      in_isr = true;
+      gie = false;
+      wait(isr_entry_cycles * tcy());
+      fn();
+      isr_calls[vector]++;
+      in_isr = false;
+      gie = true;
+
+      // An RDA handler that does not read would never return
+      if(vector == INT_RDA && uart.fifo.size() >= waiting) {
+         return;
+      }
+   }
+}
+
+/*******                  Ports                  *******/
+
+uint8_t Cpu::read_port(int port) {
+   uint8_t level = (lat[port] & ~tris[port]) | tris[port];
+   for(PinDevice *d : pin_devices) {
+      level = d->pins_input(*this, port, level);
+   }
+   return level;
+}
+
+void Cpu::pins_changed(int port) {
+   for(PinDevice *d : pin_devices) {
+      d->pins_changed(*this, port);
+   }
+}
+
+void output_bit(int pin, int value) {
+   int port = pin / 8;
+   uint8_t mask = 1 << (pin % 8);
+   cpu->tris[port] &= ~mask;
+   if(value) {
+      cpu->lat[port] |= mask;
+   } else {
+      cpu->lat[port] &= ~mask;
+   }
+   cpu->pins_changed(port);
+}
+
+void output_toggle(int pin) {
+   output_bit(pin, !((cpu->lat[pin / 8] >> (pin % 8)) & 1));
+}
+
+void output_float(int pin) {
+   cpu->tris[pin / 8] |= 1 << (pin % 8);
+   cpu->pins_changed(pin / 8);
+}
+
+bool input(int pin) {
+   output_float(pin);
+   return (cpu->read_port(pin / 8) >> (pin % 8)) & 1;
+}
+
+bool input_state(int pin) {
+   return (cpu->read_port(pin / 8) >> (pin % 8)) & 1;
+}
+
+void output_a(uint8_t value) {
+   cpu->tris[0] = 0;
+   cpu->lat[0] = value;
+   cpu->pins_changed(0);
+}
+
+uint8_t input_a( void ) {
+   return cpu->read_port(0);
+}
+
+/*******                 Timers                  *******/
+
+uint16_t Cpu::timer0() {
+   if(!t0_on) {
+      return t0_start;
+   }
+   uint16_t n = t0_start + counts(*this, t0_base, t0_div);
+   return t0_8bit ? n & 0xFF : n;
+}
+
+uint16_t Cpu::timer1() {
+   if(!t1_on) {
+      return t1_start;
+   }
+   uint64_t n = t1_start + counts(*this, t1_base, t1_div);
+   return ccp1_reset ? n % ((uint32_t)ccp1 + 1) : (uint16_t)n;
+}
+
+uint16_t Cpu::timer3() {
+   if(!t3_on) {
+      return 0;
+   }
+   return (uint16_t)counts(*this, t3_base, t3_div);
+}
+
+// Overflow of Timer 0 (16 bit mode)
+void Cpu::schedule_timer0() {
+   uint64_t gen = ++t0_gen;
+   if(!t0_on) {
+      return;
+   }
+   SimTime t = count_time(*this, t0_base, t0_div,
+                           (t0_8bit ? 256 : 65536) - t0_start);
+   at(t, [this, gen]() {
+      if(gen != t0_gen) {
+         return;
+      }
+      int_flag |= 1 << INT_TIMER0;
+      t0_base = now;
+      t0_start = 0;
+      schedule_timer0();
+   });
+}
+
+// Compare match of CCP1 resetting Timer 1, or its overflow
+void Cpu::schedule_timer1() {
+   uint64_t gen = ++t1_gen;
+   if(!t1_on) {
+      return;
+   }
+   uint32_t period = ccp1_reset ? (uint32_t)ccp1 + 1 : 65536;
+   uint64_t left = period - (t1_start % period);
+   SimTime t = count_time(*this, t1_base, t1_div, left);
+   at(t, [this, gen]() {
+      if(gen != t1_gen) {
+         return;
+      }
+      int_flag |= 1 << (ccp1_reset ? INT_CCP1 : INT_TIMER1);
+      t1_base = now;
+      t1_start = 0;
+      schedule_timer1();
+   });
+}
+
+void Cpu::capture_ccp2() {
+   if(ccp2_capture) {
+      ccp2 = timer1();
+      int_flag |= 1 << INT_CCP2;
+   }
+}
+
+void setup_timer_0(int mode) {
+   cpu->t0_start = cpu->timer0();
+   cpu->t0_base = cpu->now;
+   cpu->t0_div = (mode & T0_DIV_1) ? 1 : 2 << (mode & 7);
+   cpu->t0_8bit = (mode & T0_8_BIT) != 0;
+   cpu->t0_start = cpu->t0_8bit ? cpu->t0_start & 0xFF : cpu->t0_start;
+   cpu->t0_on = true;
+   cpu->schedule_timer0();
+}
+
+void set_timer0(uint16_t value) {
+   // Writing the timer stops it for two cycles and clears the prescaler
+   cpu->t0_start = cpu->t0_8bit ? value & 0xFF : value;
+   cpu->t0_base = cpu->now + 2 * cpu->tcy();
+   cpu->schedule_timer0();
+}
+
+void setup_timer_1(int mode) {
+   cpu->t1_start = cpu->timer1();
+   cpu->t1_base = cpu->now;
+   cpu->t1_div = 1 << ((mode >> 4) & 3);
+   cpu->t1_on = (mode & 1) != 0;
+   cpu->schedule_timer1();
+}
+
+void set_timer1(uint16_t value) {
+   cpu->t1_start = value;
+   cpu->t1_base = cpu->now;
+   cpu->schedule_timer1();
+}
+
+void setup_ccp1(int mode) {
+   cpu->t1_start = cpu->timer1();
+   cpu->t1_base = cpu->now;
+   cpu->ccp1_reset = (mode == CCP_COMPARE_RESET_TIMER);
+   cpu->schedule_timer1();
+}
+
+void setup_ccp2(int mode) {
+   cpu->ccp2_capture = (mode == CCP_CAPTURE_FE || mode == CCP_CAPTURE_RE);
+}
+
+void setup_timer_2(int mode, int period, int postscale) {
+   unsigned div = mode == T2_DIV_BY_16 ? 16 : mode == T2_DIV_BY_4 ? 4 : 1;
+   uint64_t n = ((uint64_t)period + 1) * postscale;
+   uint64_t gen = ++cpu->t2_gen;
+   Cpu *c = cpu;
+
+   if(mode == T2_DISABLED) {
+      return;
+   }
+   std::shared_ptr<std::function<void(SimTime)>> next =
+      std::make_shared<std::function<void(SimTime)>>();
+   *next = [c, div, n, gen, next](SimTime base) {
+      c->at(count_time(*c, base, div, n), [c, gen, next]() {
+         if(gen != c->t2_gen) {
+            return;
+         }
+         c->int_flag |= 1 << INT_TIMER2;
+         (*next)(c->now);
+      });
+   };
+   (*next)(c->now);
+}
+
+void setup_timer_3(int mode) {
+   cpu->t3_base = cpu->now;
+   cpu->t3_div = 1 << ((mode >> 4) & 3);
+   cpu->t3_on = (mode & 1) != 0;
+}
+
+/*******                  UART                   *******/
+
+void Cpu::putc(uint8_t c) {
+   // TXREG is still full while two bytes are queued
+   if(uart.tx_done > now + uart.byte_ns) {
+      advance(uart.tx_done - uart.byte_ns);
+   }
+   uart.tx_done = std::max(now, uart.tx_done) + uart.byte_ns;
+   uart.tx_bytes++;
+   if(uart.peer) {
+      uart.peer->receive(c, uart.tx_done);
+   }
+}
+
+uint8_t Cpu::getc() {
+   while(uart.fifo.empty()) {
+      spin();
+   }
+   uint8_t c = uart.fifo.front();
+   uart.fifo.erase(uart.fifo.begin());
+   return c;
+}
+
+// A byte arrives at the receiver, lost if RCREG already holds two
+void Cpu::receive(uint8_t c, SimTime when) {
+   at(when, [this, c]() {
+      if(uart.fifo.size() >= 2) {
+         uart.overruns++;
+         return;
+      }
+      uart.fifo.push_back(c);
+      uart.rx_bytes++;
+   });
+}
+
+/*******                   I2C                   *******/
+
+#define I2C_BIT_NS  (10 * SIM_US)    // 100 kHz
+
+void Cpu::i2c_start() {
+   if(!i2c.in_transaction) {
+      i2c.transactions++;
+      i2c.in_transaction = true;
+      i2c.counted = nullptr;
+   }
+   i2c.starts++;
+   i2c.addressing = true;
+   i2c.busy_ns += I2C_BIT_NS;
+   wait(I2C_BIT_NS);
+}
+
+void Cpu::i2c_stop() {
+   i2c.busy_ns += I2C_BIT_NS;
+   wait(I2C_BIT_NS);
+   if(i2c.active) {
+      i2c.active->stop(*this);
+   }
+   i2c.active = nullptr;
+   i2c.in_transaction = false;
+}
+
+// Returns the acknowledge bit, 0 when the byte was acknowledged
+bool Cpu::i2c_write(uint8_t data) {
+   i2c.busy_ns += 9 * I2C_BIT_NS;
+   wait(9 * I2C_BIT_NS);
+   i2c.bytes++;
+
+   if(i2c.addressing) {
+      i2c.addressing = false;
+      i2c.active = nullptr;
+      for(I2cDevice *d : i2c.devices) {
+         if(d->claims(data >> 1)) {
+            i2c.active = d;
+            break;
+         }
+      }
+      if(!i2c.active || !i2c.active->start(*this, data)) {
+         i2c.active = nullptr;
+         i2c.nacks++;
+         return 1;
+      }
+      // A repeated start to the same device is the same transaction
+      if(i2c.active != i2c.counted) {
+         i2c.active->transactions++;
+         i2c.counted = i2c.active;
+      }
+      return 0;
+   }
+   if(!i2c.active || !i2c.active->write(*this, data)) {
+      i2c.nacks++;
+      return 1;
+   }
+   return 0;
+}
+
+uint8_t Cpu::i2c_read(bool ack) {
+   i2c.busy_ns += 9 * I2C_BIT_NS;
+   wait(9 * I2C_BIT_NS);
+   i2c.bytes++;
+   return i2c.active ? i2c.active->read(*this, ack) : 0xFF;
+}
+
+/*******                   Sim                   *******/
+
+struct Sim::State {
+   std::mutex mutex;
+   std::vector<std::unique_ptr<std::condition_variable>> cv;
+   size_t running = 0;
+};
+
+void Sim::add(Cpu &c, std::function<void()> program) {
+   cpus.push_back({ &c, program });
+}
+
+// Blocks until c is the Cpu furthest behind, which is then the only one
+// running. Ties go to the first one added. With a lookahead it keeps
+// running while it is no more than that ahead of the others.
+void Sim::wait_turn(Cpu &c) {
+   std::unique_lock<std::mutex> lock(state->mutex);
+
+   size_t me = 0;
+   while(cpus[me].cpu != &c) {
+      me++;
+   }
+   size_t next = first();
+   if(next == me) {
+      return;
+   }
+   if(lookahead && c.target <= cpus[next].cpu->target + lookahead) {
+      return;
+   }
+   state->running = next;
+   state->cv[next]->notify_one();
+   state->cv[me]->wait(lock, [&]() { return state->running == me; });
+}
+
+size_t Sim::first() const {
+   size_t best = 0;
+   for(size_t i = 1; i < cpus.size(); i++) {
+      if(cpus[i].cpu->target < cpus[best].cpu->target) {
+         best = i;
+      }
+   }
+   return best;
+}
+
+void Sim::run() {
+   State st;
+   std::vector<std::thread> threads;
+
+   state = &st;
+   for(size_t i = 0; i < cpus.size(); i++) {
+      st.cv.emplace_back(new std::condition_variable());
+      cpus[i].cpu->sim = this;
+      cpus[i].cpu->target = cpus[i].cpu->now;
+   }
+   st.running = first();
+
+   for(size_t i = 0; i < cpus.size(); i++) {
+      threads.emplace_back([this, i]() {
+         Cpu &c = *cpus[i].cpu;
+         cpu = &c;
+         try {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv[i]->wait(lock, [&]() { return state->running == i; });
+            lock.unlock();
+            cpus[i].program();
+            c.advance(end);
+         } catch(HostStop &) {
+         }
+
+         // Out of the race, wakes the next one
+         std::unique_lock<std::mutex> lock(state->mutex);
+         c.target = SIM_NEVER;
+         state->running = first();
+         state->cv[state->running]->notify_one();
+      });
+   }
+   for(std::thread &t : threads) {
+      t.join();
+   }
+   for(Entry &e : cpus) {
+      e.cpu->sim = nullptr;
+   }
+   state = nullptr;
+}
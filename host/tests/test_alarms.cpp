@@ -0,0 +1,136 @@
+// test_alarms - Alarm scheduler of ALARMS.c across midnight and the week
+//
+// alarm_tick() is called every second and checked against the alarm
+// windows of the table: an alarm rings from its fire time for duration
+// seconds, on every day set in days, wrapping from Saturday to Sunday.
+// Alarms that started before the scheduler did are not expected to ring,
+// so the comparison starts once they would all be over.
+
+#include "ccs.h"
+#include "check.h"
+
+#include "rtc_communication.c"
+#include "alarms.c"
+
+#define MON 1
+#define TUE 2
+#define SAT 6
+#define SUN 0
+
+static AlarmEntry table[ALARMS];
+
+static void clear_table( void ) {
+   for(int i = 0; i < ALARMS; i++) {
+      table[i].hour = ALARM_EMPTY;
+      table[i].days = 0;
+   }
+}
+
+static void set_entry(int i, int h, int m, int s, int duration, int days) {
+   table[i].hour = h;
+   table[i].min = m;
+   table[i].sec = s;
+   table[i].duration = duration;
+   table[i].days = days;
+}
+
+static uint32_t at(int dow, int h, int m, int s) {
+   return (uint32_t)dow * DAY_SECONDS + h * 3600 + m * 60 + s;
+}
+
+// True if now is inside the window of an entry of the table
+static bool rings(uint32_t now) {
+   for(int i = 0; i < ALARMS; i++) {
+      if(table[i].hour >= 24) {
+         continue;
+      }
+      for(int dow = 0; dow < 7; dow++) {
+         if((table[i].days >> dow) & 1) {
+            uint32_t fire = at(dow, table[i].hour, table[i].min, table[i].sec);
+            if((now + WEEK_SECONDS - fire) % WEEK_SECONDS < table[i].duration) {
+               return true;
+            }
+         }
+      }
+   }
+   return false;
+}
+
+// Ticks every second from start for count seconds, returns the failures
+static int run(uint32_t start, uint32_t count) {
+   int failures = 0;
+
+   alarm_last = 0;
+   alarm_end = 0;
+   alarm_schedule(table, start);
+   for(uint32_t t = 0; t < count; t++) {
+      uint32_t now = (start + t) % WEEK_SECONDS;
+      bool ringing = alarm_tick(table, now);
+      if(t >= 255 && ringing != rings(now)) {
+         if(failures++ < 5) {
+            fprintf(stderr, "now %u: ringing %d, expected %d\n",
+                    now, ringing, !ringing);
+         }
+      }
+   }
+   return failures;
+}
+
+int main( void ) {
+
+   // Rings across midnight, Monday to Tuesday
+   clear_table();
+   set_entry(0, 23, 59, 50, 30, 1 << MON);
+   CHECK_EQ(run(at(MON, 23, 0, 0), 2 * 3600), 0);
+   CHECK(!rings(at(MON, 23, 59, 49)));
+   CHECK(rings(at(TUE, 0, 0, 19)));
+   CHECK(!rings(at(TUE, 0, 0, 20)));
+
+   // Fires on the stroke of midnight, of Tuesday only
+   clear_table();
+   set_entry(0, 0, 0, 0, 10, 1 << TUE);
+   CHECK_EQ(run(at(MON, 23, 0, 0), 2 * 3600), 0);
+   CHECK_EQ(run(at(TUE, 0, 0, 0), 3600), 0);
+
+   // Rings across the week rollover, Saturday to Sunday
+   clear_table();
+   set_entry(0, 23, 59, 50, 30, 1 << SAT);
+   CHECK_EQ(run(at(SAT, 23, 0, 0), 2 * 3600), 0);
+
+   // Fires on the rollover itself, Sunday 00:00:00
+   clear_table();
+   set_entry(0, 0, 0, 0, 10, 1 << SUN);
+   CHECK_EQ(run(at(SAT, 23, 0, 0), 2 * 3600), 0);
+
+   // A longer alarm of another entry fires while one rings
+   clear_table();
+   set_entry(0, 23, 59, 0, 120, 0x7F);
+   set_entry(1, 23, 59, 30, 200, 0x7F);
+   set_entry(2, 23, 59, 30, 10, 0x7F);
+   CHECK_EQ(run(at(SAT, 22, 0, 0), 3 * 3600), 0);
+
+   // Empty entries and entries without days never fire
+   clear_table();
+   set_entry(0, ALARM_EMPTY, 0, 0, 30, 0x7F);
+   set_entry(1, 12, 0, 0, 30, 0);
+   CHECK_EQ(run(at(SUN, 0, 0, 0), WEEK_SECONDS + 3600), 0);
+   CHECK_EQ(alarm_next, ALARM_NONE);
+
+   // Random tables over eight days from a random second of the week
+   uint32_t seed = 1;
+   for(int n = 0; n < 20; n++) {
+      clear_table();
+      for(int i = 0; i < ALARMS; i++) {
+         seed = seed * 1103515245 + 12345;
+         if((seed >> 16) % 8 == 0) {
+            continue;
+         }
+         set_entry(i, (seed >> 8) % 24, (seed >> 12) % 60, (seed >> 4) % 60,
+                   (seed >> 20) % 256, (seed >> 24) & 0x7F);
+      }
+      seed = seed * 1103515245 + 12345;
+      CHECK_EQ(run(seed % WEEK_SECONDS, 8 * DAY_SECONDS), 0);
+   }
+
+   return check_result("test_alarms");
+}
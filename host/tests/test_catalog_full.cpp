@@ -0,0 +1,68 @@
+// test_catalog_full - Saves on the POS slave up to the last record
+//
+// The 24LC04B holds the product count at 0x000, CATALOG_SIZE records of
+// 20 bytes from 0x001 and the catalog generation at 0x1FF, which a 26th
+// record would cover. The slave program of units/pos_slave.cpp starts
+// one product short of full, and the master functions of
+// POS_COMMUNICATION.c save two products with SaveProd. The first must be
+// acknowledged and stored, the count and the generation going up. The
+// second must be acknowledged as failed, with no EEPROM write at all.
+
+#include "ccs.h"
+#include "check.h"
+#include "pos_rig.h"
+
+namespace master {
+#include "pos_communication.c"
+}
+
+using namespace master;
+
+static bool save(const char *sku, const char *name, unsigned price) {
+   Product prod;
+
+   strcpy(prod.sku, sku);
+   strcpy(prod.name, name);
+   prod.price = price;
+   send_command(SaveProd);
+   return send_product(prod);
+}
+
+int main( void ) {
+   PosSlaveRig slave;
+   Cpu board;
+   uint64_t writes = 0;
+
+   CHECK_EQ(CATALOG_SIZE, POS_CATALOG_MAX);
+   CHECK(1 + CATALOG_SIZE * 20 <= POS_GEN_ADDR);
+
+   board.name = "master";
+   board.clock = 5000000;
+   slave.seed(CATALOG_SIZE - 1);
+   slave.connect(board);
+
+   Sim sim(10 * SIM_SEC);
+   sim.lookahead = board.uart.byte_ns;
+   sim.add(slave.cpu, pos_slave::program_main);
+   sim.add(board, [&]() {
+      delay_ms(100);
+
+      // The last record
+      CHECK(save("900000", "LASTRECORD", 125));
+      delay_ms(200);
+      writes = slave.eeprom.write_cycles;
+
+      // One past it
+      CHECK(!save("900001", "ONETOOMANY", 126));
+      delay_ms(200);
+      CHECK_EQ(slave.eeprom.write_cycles, writes);
+      cpu->sim->end = cpu->now;
+   });
+   sim.run();
+
+   CHECK_EQ(slave.eeprom.mem[0], CATALOG_SIZE);
+   CHECK_EQ(slave.eeprom.mem[POS_GEN_ADDR], 1);
+   CHECK(memcmp(&slave.eeprom.mem[1 + (CATALOG_SIZE - 1) * 20],
+                "900000\0LASTRECORD", 18) == 0);
+   return check_result("test_catalog_full");
+}
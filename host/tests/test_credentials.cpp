@@ -0,0 +1,123 @@
+// test_credentials - Hashed credential table of CREDENTIALS.c with 200
+// PINs on the 24LC08B model
+//
+// 200 distinct PINs of 4 to 8 digits are added with hold times 0-15,
+// then every one of them is verified and 2000 PINs that were never added
+// are refused, after the RAM index was loaded again as at power up. A
+// lookup only reads the slots the index matches, 3 bytes each, so an
+// unknown PIN must take less than a read on average. Prints the EEPROM
+// bytes read per verification, for a saved PIN and for an unknown one,
+// and the time a lookup takes on the bus.
+
+#include "ccs.h"
+#include "check.h"
+
+#define EEPROM_SIZE 1024
+#include "2404.c"
+#include "credentials.c"
+
+#include <set>
+#include <string>
+
+#define USERS     200
+#define UNKNOWN   2000
+#define MAX_READS (CRED_PROBES * CRED_SLOTS * (CRED_SIZE - 1))
+#define SLOTS     (CRED_BUCKETS * CRED_SLOTS)
+
+static Cpu board;
+static Eeprom24 eeprom{1024};
+
+struct Lookups {
+   int count = 0;
+   uint64_t reads = 0, most = 0;
+   SimTime time = 0, longest = 0;
+};
+
+// Lookup of one PIN, its reads and time added to l
+static uint8_t lookup(const std::string &pin, Lookups &l) {
+   char text[9];
+   uint64_t reads = eeprom.read_bytes;
+   SimTime start = board.now;
+   uint8_t hold;
+
+   strcpy(text, pin.c_str());
+   hold = cred_find(text);
+   l.count++;
+   l.reads += eeprom.read_bytes - reads;
+   l.most = std::max(l.most, eeprom.read_bytes - reads);
+   l.time += board.now - start;
+   l.longest = std::max(l.longest, board.now - start);
+   return hold;
+}
+
+static void report(const char *name, const Lookups &l) {
+   printf("test_credentials: %-7s %.2f reads per lookup (max %llu), "
+          "%.0f us (max %.0f us)\n", name, (double)l.reads / l.count,
+          (unsigned long long)l.most, l.time / (double)l.count / SIM_US,
+          l.longest / (double)SIM_US);
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   std::vector<std::string> pins;
+   std::set<std::string> used;
+   uint32_t seed = 12345;
+   char text[9];
+   Lookups saved, unknown;
+   uint8_t index[SLOTS];
+   int false_matches = 0;
+   int i;
+
+   board.i2c.devices.push_back(&eeprom);
+   init_ext_eeprom();
+   cred_init();
+
+   // Random PINs of 4 to 8 digits
+   while((int)pins.size() < USERS + UNKNOWN) {
+      std::string pin;
+      seed = seed * 1103515245 + 12345;
+      int len = 4 + (seed >> 16) % 5;
+      for(int d = 0; d < len; d++) {
+         seed = seed * 1103515245 + 12345;
+         pin += '0' + (seed >> 16) % 10;
+      }
+      if(used.insert(pin).second) {
+         pins.push_back(pin);
+      }
+   }
+
+   for(i = 0; i < USERS; i++) {
+      strcpy(text, pins[i].c_str());
+      CHECK_EQ(cred_add(text, i % 16), CRED_OK);
+      CHECK(cred_index < CRED_BUCKETS * CRED_SLOTS);
+   }
+   strcpy(text, pins[0].c_str());
+   CHECK_EQ(cred_add(text, 3), CRED_EXISTS);
+
+   // Power up, the index read back from the EEPROM
+   memcpy(index, cred_first, SLOTS);
+   memset(cred_first, 0, SLOTS);
+   eeprom.reset_counters();
+   cred_init();
+   CHECK(memcmp(index, cred_first, SLOTS) == 0);
+   CHECK_EQ(eeprom.read_bytes, SLOTS);
+
+   eeprom.reset_counters();
+   for(i = 0; i < USERS; i++) {
+      CHECK_EQ(lookup(pins[i], saved), i % 16);
+   }
+   for(i = USERS; i < USERS + UNKNOWN; i++) {
+      if(lookup(pins[i], unknown) != CRED_NONE) {
+         false_matches++;
+      }
+   }
+   CHECK_EQ(false_matches, 0);
+   CHECK(saved.most <= MAX_READS);
+   CHECK(unknown.most <= MAX_READS);
+   CHECK(unknown.reads < (uint64_t)unknown.count);
+   CHECK_EQ(eeprom.write_cycles, 0);
+
+   report("saved", saved);
+   report("unknown", unknown);
+   return check_result("test_credentials");
+}
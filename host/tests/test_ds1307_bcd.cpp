@@ -0,0 +1,34 @@
+// test_ds1307_bcd - BCD conversions of DS1307.c
+//
+// Every value 0-99 converts to BCD and back, and every byte gives the
+// same result as the arithmetic of the base revision, in range or not:
+// bin2bcd() through its table, bcd2bin() through its shift and add.
+
+#include "ccs.h"
+#include "check.h"
+
+#include "rtc_communication.c"
+#include "ds1307.c"
+
+namespace old {
+#include "../gen-base/rtc_communication.c"
+#include "../gen-base/ds1307.c"
+}
+
+int main( void ) {
+   int v;
+
+   // 0-99 both ways
+   for(v = 0; v < 100; v++) {
+      CHECK_EQ(bin2bcd(v), (v / 10) << 4 | v % 10);
+      CHECK_EQ(bcd2bin(bin2bcd(v)), v);
+   }
+
+   // Every byte as before
+   for(v = 0; v < 256; v++) {
+      CHECK_EQ(bin2bcd(v), old::bin2bcd(v));
+      CHECK_EQ(bcd2bin(v), old::bcd2bin(v));
+   }
+
+   return check_result("test_ds1307_bcd");
+}
@@ -0,0 +1,98 @@
+// test_ds1307_burst - rtc_get_datetime() of DS1307.c against a rollover
+//
+// The DS1307 model rolls over at a chosen time after the read starts,
+// swept over the 3 ms a separate rtc_get_time() and rtc_get_date() take.
+// Read separately, in either order, some readings mix the two sides of
+// 31 Dec 23:59:59 -> 1 Jan 00:00:00. The burst read never does, and it
+// takes one bus transaction instead of two.
+
+#include "ccs.h"
+#include "check.h"
+
+#include "rtc_communication.c"
+#include "ds1307.c"
+
+#define BEFORE   secs_from_civil(2023, 12, 31, 23, 59, 59)
+#define STEP_US  5
+#define SPAN_US  3000
+
+static Cpu board;
+static Ds1307 rtc;
+
+// Seconds since 2000 of a reading, -1 when the fields do not make a date
+static long long reading(Date &date, Time &time) {
+   EpochSecs epoch = date2epoch(date, time);
+   return epoch == EPOCH_INVALID ? -1 : (long long)epoch;
+}
+
+// The DS1307 is at BEFORE and rolls over us microseconds from now
+static void roll_in(unsigned us) {
+   rtc.set(BEFORE, board.now + us * SIM_US - SIM_SEC);
+}
+
+static bool consistent(long long epoch) {
+   return epoch == (long long)BEFORE || epoch == (long long)BEFORE + 1;
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   Date date;
+   Time time;
+   int time_first = 0, date_first = 0, burst = 0;
+
+   board.i2c.devices.push_back(&rtc);
+   board.wait(SIM_SEC);      // roll_in() sets the clock a second back
+
+   for(unsigned us = 0; us <= SPAN_US; us += STEP_US) {
+      roll_in(us);
+      rtc_get_time(time);
+      rtc_get_date(date);
+      time_first += !consistent(reading(date, time));
+
+      roll_in(us);
+      rtc_get_date(date);
+      rtc_get_time(time);
+      date_first += !consistent(reading(date, time));
+
+      roll_in(us);
+      rtc_get_datetime(date, time);
+      burst += !consistent(reading(date, time));
+   }
+
+   // Separate reads straddle the rollover, the burst never does
+   CHECK(time_first > 0);
+   CHECK(date_first > 0);
+   CHECK_EQ(burst, 0);
+
+   // Readings away from a rollover are the same either way
+   rtc.set(secs_from_civil(2024, 2, 29, 12, 34, 56), board.now);
+   rtc_get_datetime(date, time);
+   CHECK_EQ(reading(date, time), secs_from_civil(2024, 2, 29, 12, 34, 56));
+   CHECK_EQ(date.dow, 5);
+   rtc_get_time(time);
+   rtc_get_date(date);
+   CHECK_EQ(reading(date, time), secs_from_civil(2024, 2, 29, 12, 34, 56));
+
+   // Bus traffic of a reading
+   board.i2c.reset_counters();
+   rtc_get_time(time);
+   rtc_get_date(date);
+   uint64_t separate = board.i2c.transactions, separate_bytes = board.i2c.bytes;
+   SimTime separate_ns = board.i2c.busy_ns;
+
+   board.i2c.reset_counters();
+   rtc_get_datetime(date, time);
+   CHECK_EQ(separate, 2);
+   CHECK_EQ(board.i2c.transactions, 1);
+   CHECK(board.i2c.bytes < separate_bytes);
+
+   printf("mixed readings in %d: time, date %d  date, time %d  burst %d\n",
+          SPAN_US / STEP_US + 1, time_first, date_first, burst);
+   printf("per reading: transactions %llu -> %llu, bytes %llu -> %llu, "
+          "bus %.0f -> %.0f us\n",
+          (unsigned long long)separate, (unsigned long long)board.i2c.transactions,
+          (unsigned long long)separate_bytes, (unsigned long long)board.i2c.bytes,
+          separate_ns / (double)SIM_US, board.i2c.busy_ns / (double)SIM_US);
+
+   return check_result("test_ds1307_burst");
+}
@@ -0,0 +1,80 @@
+// test_epoch - date2epoch() and epoch2date() of RTC_COMMUNICATION.c
+//
+// Every day from 1 Jan 2000 to 31 Dec 2099 goes to seconds since 2000 and
+// back at the start, the middle and the end of the day, checked against
+// gmtime() of the C library. Months and days out of range give
+// EPOCH_INVALID.
+
+#include <time.h>
+
+#include "ccs.h"
+#include "check.h"
+
+#include "rtc_communication.c"
+
+#define UNIX_2000  946684800
+
+int main( void ) {
+   static const int times[3][3] = { { 0, 0, 0 }, { 12, 34, 56 }, { 23, 59, 59 } };
+   Date date, back;
+   Time time, back_time;
+   struct tm tm;
+   int day, t, failures = 0;
+
+   for(day = 0; day < 36525; day++) {
+      for(t = 0; t < 3; t++) {
+         EpochSecs epoch = (EpochSecs)day * DAY_SECONDS +
+                           times[t][0] * 3600 + times[t][1] * 60 + times[t][2];
+         time_t unix_time = UNIX_2000 + (time_t)epoch;
+         gmtime_r(&unix_time, &tm);
+
+         date.year = tm.tm_year - 100;
+         date.mth = tm.tm_mon + 1;
+         date.day = tm.tm_mday;
+         date.dow = tm.tm_wday;
+         time.hour = times[t][0];
+         time.min = times[t][1];
+         time.sec = times[t][2];
+
+         epoch2date(date2epoch(date, time), back, back_time);
+         if(date2epoch(date, time) != epoch || back.year != date.year ||
+            back.mth != date.mth || back.day != date.day ||
+            back.dow != date.dow || back_time.hour != time.hour ||
+            back_time.min != time.min || back_time.sec != time.sec) {
+            if(failures++ < 5) {
+               fprintf(stderr, "20%02u-%02u-%02u %02u:%02u:%02u: epoch %u, "
+                       "back 20%02u-%02u-%02u dow %u %02u:%02u:%02u\n",
+                       date.year, date.mth, date.day, time.hour, time.min,
+                       time.sec, date2epoch(date, time), back.year, back.mth,
+                       back.day, back.dow, back_time.hour, back_time.min,
+                       back_time.sec);
+            }
+         }
+      }
+   }
+   CHECK_EQ(failures, 0);
+
+   // Last second of the century
+   epoch2date((EpochSecs)36525 * DAY_SECONDS - 1, back, back_time);
+   CHECK_EQ(back.year, 99);
+   CHECK_EQ(back.mth, 12);
+   CHECK_EQ(back.day, 31);
+   CHECK_EQ(back_time.sec, 59);
+
+   // Out of range fields, as read from a DS1307 never set
+   date.year = 24;
+   date.mth = 0;
+   date.day = 1;
+   CHECK_EQ(date2epoch(date, time), EPOCH_INVALID);
+   date.mth = 13;
+   CHECK_EQ(date2epoch(date, time), EPOCH_INVALID);
+   date.mth = 0x12;
+   CHECK_EQ(date2epoch(date, time), EPOCH_INVALID);
+   date.mth = 6;
+   date.day = 0;
+   CHECK_EQ(date2epoch(date, time), EPOCH_INVALID);
+   date.day = 32;
+   CHECK_EQ(date2epoch(date, time), EPOCH_INVALID);
+
+   return check_result("test_epoch");
+}
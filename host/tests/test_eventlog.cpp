@@ -0,0 +1,135 @@
+// test_eventlog - Ring buffered event log of EVENTLOG.c on the 24LC08B
+// model, placed as RELAY/LOCK.c places it
+//
+// 100 events are logged twice, with log_idle() after every event as the
+// lock main loop calls it and with log_add() alone. The dump must hold
+// the last LOG_ENTRIES written entries from the oldest, then the staged
+// ones, and after a reset the written ones only. Prints the EEPROM write
+// cycles per 100 events and checks nothing is written outside the log.
+
+#include "ccs.h"
+#include "check.h"
+
+#define EEPROM_SIZE    1024
+#include "2404.c"
+
+#define LOG_BASE       960
+#define LOG_ENTRIES    16
+#define LOG_HEAD_ADDR  0xFF
+#include "eventlog.c"
+
+#define EVENTS  100
+
+// Bytes sent by log_dump()
+struct Capture : UartPeer {
+   std::vector<uint8_t> bytes;
+   void receive(uint8_t c, SimTime) override { bytes.push_back(c); }
+};
+
+static Cpu board;
+static Eeprom24 eeprom{1024};
+static Capture serial;
+
+// Logs events first to first + count - 1, the time is the event number
+static void log_events(int first, int count, bool idle) {
+   for(int i = first; i < first + count; i++) {
+      log_add(i, i % 5, i & 0xFF);
+      if(idle) {
+         log_idle();
+      }
+   }
+}
+
+// Checks a dump holds the events first to last, after never used ones
+static void check_dump(int first, int last) {
+   serial.bytes.clear();
+   log_dump();
+
+   CHECK_EQ(serial.bytes.size(), 1 + serial.bytes[0] * sizeof(LogEntry));
+   int entries = serial.bytes[0];
+   int used = last - first + 1;
+   CHECK(used <= entries);
+   for(int e = 0; e < entries; e++) {
+      const uint8_t *b = &serial.bytes[1 + e * sizeof(LogEntry)];
+      int n = first + e - (entries - used);
+      if(n < first) {
+         CHECK_EQ(b[2], LOG_EMPTY);
+         continue;
+      }
+      CHECK_EQ(b[0] | b[1] << 8, n);
+      CHECK_EQ(b[2], n % 5);
+      CHECK_EQ(b[3], n & 0xFF);
+   }
+}
+
+// Power up: the staged entries are lost
+static void reset( void ) {
+   log_staged = 0;
+   log_head = 0;
+   log_init();
+}
+
+static uint64_t outside_writes( void ) {
+   uint64_t n = 0;
+   for(size_t a = 0; a < eeprom.wear.size(); a++) {
+      if(a < LOG_BASE || a >= LOG_BASE + LOG_BYTES) {
+         n += eeprom.wear[a];
+      }
+   }
+   return n;
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   uint64_t cycles, head_writes;
+   int flushed;
+
+   board.i2c.devices.push_back(&eeprom);
+   board.uart.peer = &serial;
+   init_ext_eeprom();
+   log_init();
+
+   // Never used entries, then the first few staged
+   check_dump(0, -1);
+   log_events(0, 3, true);
+   CHECK_EQ(eeprom.write_cycles, 0);
+   check_dump(0, 2);
+
+   // log_idle() after every event, as in the lock
+   reset();
+   eeprom.reset_counters();
+   head_writes = board.eeprom_writes;
+   log_events(0, EVENTS, true);
+   cycles = eeprom.write_cycles;
+   CHECK_EQ(cycles, EVENTS / LOG_PAGE);
+   CHECK_EQ(log_staged, EVENTS % LOG_PAGE);
+   printf("test_eventlog: log_idle: %llu write cycles per %d events, "
+          "%llu head writes\n", (unsigned long long)cycles, EVENTS,
+          (unsigned long long)(board.eeprom_writes - head_writes));
+   check_dump(EVENTS - LOG_ENTRIES - EVENTS % LOG_PAGE, EVENTS - 1);
+
+   // The staged events are lost, the written ones kept in order
+   flushed = EVENTS - EVENTS % LOG_PAGE;
+   reset();
+   check_dump(flushed - LOG_ENTRIES, flushed - 1);
+
+   // log_add() alone writes when the stage is full
+   eeprom.reset_counters();
+   log_events(flushed, EVENTS, false);
+   cycles = eeprom.write_cycles;
+   printf("test_eventlog: log_add:  %llu write cycles per %d events\n",
+          (unsigned long long)cycles, EVENTS);
+   CHECK(cycles <= (EVENTS / LOG_STAGE) * (LOG_STAGE / LOG_PAGE + 1));
+   check_dump(flushed + EVENTS - LOG_ENTRIES - log_staged,
+              flushed + EVENTS - 1);
+
+   // Everything written, the head in the internal EEPROM
+   log_flush();
+   CHECK_EQ(log_staged, 0);
+   CHECK_EQ(read_eeprom(LOG_HEAD_ADDR), log_head);
+   reset();
+   check_dump(flushed + EVENTS - LOG_ENTRIES, flushed + EVENTS - 1);
+
+   CHECK_EQ(outside_writes(), 0);
+   return check_result("test_eventlog");
+}
@@ -0,0 +1,120 @@
+// test_glyphs - CGRAM uploads of the GLYPHS.c cache
+//
+// Runs the glyph calls of a scripted POS master session on the HD44780
+// model: the menu arrow moving, the blinking cursor of the name entry
+// and the progress bar of 20 catalog downloads. The six glyphs fit in
+// the eight slots, so each must be uploaded once for the whole session,
+// 9 bytes each, and the CGRAM must hold their rows. The bar on the
+// screen must show the full blocks and the partial cell of its length.
+// Cycling through more glyphs than slots is the worst case of the least
+// recently used order, every call uploads, and is checked as well.
+
+#include "ccs.h"
+#include "check.h"
+
+#include "hd44780.c"
+#include "glyphs.c"
+
+#define PRODUCTS   37      // Products of a catalog download
+#define DOWNLOADS  20
+#define BAR_CELLS  20
+
+static Cpu board;
+static Hd44780 lcd{1, 4, 20};
+
+// The CGRAM of the slot holds the rows of the glyph
+static bool slot_holds(uint8_t slot, uint8_t id) {
+   return memcmp(&lcd.cgram[slot * 8], glyph_rows[id], 8) == 0;
+}
+
+// Menu of POS_MASTER.c, the arrow on one of two lines
+static void menu(int moves) {
+   for(int i = 0; i < moves; i++) {
+      uint8_t arrow = glyph(GlyphArrowLeft);
+      lcd_gotoxy(19, i % 2 + 2);
+      lcd_putc(arrow);
+   }
+}
+
+// Name entry, the underline cursor blinking on a position
+static void name_entry(int blinks) {
+   for(int i = 0; i < blinks; i++) {
+      uint8_t cursor = glyph(GlyphCursor);
+      lcd_gotoxy(9 + i % 8, 2);
+      lcd_putc(i % 2 ? ' ' : cursor);
+   }
+}
+
+// sync_Catalog(), the bar grown after every product
+static void download( void ) {
+   uint8_t bar = 0, next;
+
+   lcd_putc('\f');
+   for(int p = 1; p <= PRODUCTS; p++) {
+      next = p * BAR_CELLS * 5 / PRODUCTS;
+      glyph_bar(1, 3, bar, next);
+      bar = next;
+   }
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   uint64_t bytes;
+   int i;
+
+   board.pin_devices.push_back(&lcd);
+   lcd_init();
+   glyph_init();
+   board.wait(10 * SIM_MS);
+   lcd.reset_counters();
+
+   // Scripted session
+   for(i = 0; i < DOWNLOADS; i++) {
+      menu(10);
+      download();
+      name_entry(50);
+   }
+   CHECK_EQ(lcd.busy_writes, 0);
+   CHECK_EQ(glyph_uploads, 6);
+   CHECK_EQ(lcd.cgram_writes, 6 * 8);
+   for(i = 0; i < GLYPH_SLOTS; i++) {
+      if(glyph_loaded[i] != GLYPH_NONE) {
+         CHECK(slot_holds(i, glyph_loaded[i]));
+      }
+   }
+   printf("test_glyphs: %u uploads, %llu CGRAM writes in %d downloads\n",
+          glyph_uploads, (unsigned long long)lcd.cgram_writes, DOWNLOADS);
+
+   // The last download left a full bar
+   CHECK(lcd.line(3) == std::string(BAR_CELLS, (char)GLYPH_FULL));
+
+   // A bar of 7 fifths, a full block and the glyph of 2 columns
+   lcd_putc('\f');
+   glyph_bar(1, 1, 0, 7);
+   CHECK_EQ((uint8_t)lcd.line(1)[0], GLYPH_FULL);
+   CHECK(slot_holds(lcd.line(1)[1], GlyphBar2));
+   CHECK_EQ(lcd.line(1)[2], ' ');
+
+   // Reuse costs no bytes on the bus
+   bytes = lcd.bytes();
+   CHECK_EQ(glyph(GlyphBar2), (uint8_t)lcd.line(1)[1]);
+   CHECK_EQ(lcd.bytes(), bytes);
+
+   // Nine glyphs in turn: the least recently used is always the next one
+   glyph_init();
+   glyph_uploads = 0;
+   for(i = 0; i < 90; i++) {
+      glyph(i % 9);
+   }
+   CHECK_EQ(glyph_uploads, 90);
+   for(i = 0; i < 90; i++) {
+      glyph(i % 8);
+   }
+   CHECK_EQ(glyph_uploads, 90 + 8);
+   for(i = 0; i < GLYPH_SLOTS; i++) {
+      CHECK(slot_holds(glyph(i), i));
+   }
+   CHECK_EQ(glyph_uploads, 90 + 8);
+   CHECK_EQ(lcd.busy_writes, 0);
+   return check_result("test_glyphs");
+}
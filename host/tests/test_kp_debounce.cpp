@@ -0,0 +1,180 @@
+// test_kp_debounce - Interrupt driven keypad scanner of KP4X4.c
+//
+// Scripted presses, clean and bouncy, on the keypad model: every press
+// gives one press and one release event of its key, short glitches give
+// none, a press is reported within the debounce time and the events wait
+// in the FIFO while the main code is busy.
+
+#include "ccs.h"
+#include "check.h"
+#include "kp_script.h"
+
+#define KP_ISR
+namespace kp_isr {
+#include "kp4x4.c"
+}
+
+using namespace kp_isr;
+
+struct Seen {
+   int key;
+   bool pressed;
+   unsigned tick;    // kp_ticks of the event
+};
+
+static Cpu board;
+static Keypad pad;
+static SimTime t0;   // kp_init() time
+
+static void collect(std::vector<Seen> &seen) {
+   KpEvent e;
+   while(kp_get_event(e)) {
+      seen.push_back({ e.key, e.pressed, e.time });
+   }
+}
+
+// Runs the main code until the given time, reading events every 5 ms
+static void run_until(SimTime end, std::vector<Seen> &seen) {
+   while(cpu->now < end) {
+      delay_ms(5);
+      collect(seen);
+   }
+}
+
+// Timer 2 period, prescaler 16 and postscaler 4 (0.9984 ms at 20 MHz)
+#define TICK_NS ((SimTime)(KP_TIMER_PR + 1) * 64 * 4 * SIM_SEC / HOST_CLOCK)
+
+// Scanner tick of a time
+static unsigned tick_of(SimTime t) {
+   return (t - t0) / TICK_NS;
+}
+
+// Ticks from an edge to its event, the tick is 16 bit
+static unsigned delay_of(const Seen &event, SimTime edge) {
+   return (uint16_t)(event.tick - tick_of(edge));
+}
+
+static void test_clean_presses( void ) {
+   std::vector<Seen> seen;
+   SimTime start = cpu->now + 50 * SIM_MS;
+
+   for(int key = 0; key < 16; key++) {
+      pad.press(key, start + key * 100 * SIM_MS, 50 * SIM_MS);
+   }
+   run_until(start + 1700 * SIM_MS, seen);
+
+   CHECK_EQ(seen.size(), 32);
+   for(int key = 0; key < 16 && (size_t)key * 2 + 1 < seen.size(); key++) {
+      CHECK_EQ(seen[key * 2].key, key);
+      CHECK(seen[key * 2].pressed);
+      CHECK_EQ(seen[key * 2 + 1].key, key);
+      CHECK(!seen[key * 2 + 1].pressed);
+   }
+}
+
+static void test_bouncy_presses( void ) {
+   std::vector<Seen> seen;
+   KpScript script(29);
+   size_t first = pad.presses.size();
+   SimTime end = script.presses(pad, 300, cpu->now + 50 * SIM_MS, 15);
+
+   run_until(end + 100 * SIM_MS, seen);
+
+   CHECK_EQ(seen.size(), 2 * (pad.presses.size() - first));
+   for(size_t i = 0; i + first < pad.presses.size() && 2 * i + 1 < seen.size(); i++) {
+      const Keypad::Press &p = pad.presses[first + i];
+      const Seen &down = seen[2 * i];
+      const Seen &up = seen[2 * i + 1];
+
+      CHECK_EQ(down.key, p.key);
+      CHECK(down.pressed);
+      CHECK_EQ(up.key, p.key);
+      CHECK(!up.pressed);
+
+      // Reported after the bounce, within 5 scans of 4 ms and a row
+      CHECK(delay_of(down, p.down) <= p.bounce / SIM_MS + KP_DEBOUNCE * 4 + 4);
+      CHECK(delay_of(up, p.up) <= p.bounce / SIM_MS + KP_DEBOUNCE * 4 + 4);
+   }
+}
+
+static void test_glitches( void ) {
+   std::vector<Seen> seen;
+   SimTime start = cpu->now + 50 * SIM_MS;
+
+   // Closed for less than the debounce time
+   for(int i = 0; i < 16; i++) {
+      pad.press(i, start + i * 50 * SIM_MS, 8 * SIM_MS);
+   }
+   run_until(start + 900 * SIM_MS, seen);
+   CHECK_EQ(seen.size(), 0);
+}
+
+static void test_busy_main( void ) {
+   std::vector<Seen> seen;
+   SimTime start = cpu->now + 50 * SIM_MS;
+
+   // Three presses while the main code is away for 600 ms
+   for(int i = 0; i < 3; i++) {
+      pad.press(4 + i, start + i * 150 * SIM_MS, 60 * SIM_MS, 5 * SIM_MS);
+   }
+   delay_ms(650);
+   collect(seen);
+
+   CHECK_EQ(seen.size(), 6);
+   for(size_t i = 0; i < seen.size(); i++) {
+      CHECK_EQ(seen[i].key, 4 + i / 2);
+      CHECK_EQ(seen[i].pressed, i % 2 == 0);
+   }
+
+   // Events that do not fit in the FIFO are dropped, the rest kept
+   seen.clear();
+   start = cpu->now + 50 * SIM_MS;
+   for(int i = 0; i < 5; i++) {
+      pad.press(i, start + i * 100 * SIM_MS, 50 * SIM_MS);
+   }
+   delay_ms(600);
+   collect(seen);
+   CHECK_EQ(seen.size(), KP_EVENTS - 1);
+   for(size_t i = 0; i < seen.size(); i++) {
+      CHECK_EQ(seen[i].key, i / 2);
+   }
+}
+
+static void test_getn( void ) {
+   SimTime start = cpu->now + 50 * SIM_MS;
+   int8_t got[16];
+
+   for(int key = 0; key < 16; key++) {
+      pad.press(key, start + key * 100 * SIM_MS, 50 * SIM_MS, 3 * SIM_MS);
+   }
+   for(int n = 0; n < 16; ) {
+      uint8_t value = kp_getn();
+      if(value != NOKEYPRESS) {
+         got[n++] = value;
+      }
+      delay_ms(5);
+   }
+   for(int key = 0; key < 16; key++) {
+      CHECK_EQ(got[key], numkeys[key]);
+   }
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   board.pin_devices.push_back(&pad);
+
+   kp_init();
+   enable_interrupts(GLOBAL);
+   t0 = board.now;
+
+   test_clean_presses();
+   test_bouncy_presses();
+   test_glitches();
+   test_busy_main();
+   test_getn();
+
+   // One row every tick
+   CHECK(board.isr_calls[INT_TIMER2] >= tick_of(board.now) - 1);
+   CHECK(board.isr_calls[INT_TIMER2] <= tick_of(board.now) + 1);
+   return check_result("test_kp_debounce");
+}
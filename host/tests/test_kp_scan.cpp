@@ -0,0 +1,73 @@
+// test_kp_scan - Table driven kp_scan_raw() of KP4X4.c
+//
+// Every single key, every pair of keys and no key at all give the same
+// index as the nested scan it replaced, while reading PORTD four times
+// a scan instead of twenty.
+
+#include "ccs.h"
+#include "check.h"
+#include "kp_old_scan.h"
+
+namespace kp_polled {
+#include "kp4x4.c"
+}
+
+using namespace kp_polled;
+
+static Cpu board;
+static Keypad pad;
+
+// Holds the given keys down from now on, for a millisecond
+static void hold(int a, int b = -1) {
+   pad.presses.clear();
+   pad.press(a, board.now, SIM_MS);
+   if(b >= 0) {
+      pad.press(b, board.now, SIM_MS);
+   }
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   board.pin_devices.push_back(&pad);
+   kp_init();
+
+   // No key
+   pad.presses.clear();
+   CHECK_EQ(kp_scan_raw(), NOKEYPRESS);
+   CHECK_EQ(kp_old_scan(), NOKEYPRESS);
+
+   // Single keys, also through the edge detection of kp_getn()
+   for(int key = 0; key < 16; key++) {
+      hold(key);
+      CHECK_EQ(kp_scan_raw(), key);
+      CHECK_EQ(kp_old_scan(), key);
+      CHECK_EQ(kp_getn(), numkeys[key]);
+      CHECK_EQ(kp_getn(), NOKEYPRESS);
+      pad.presses.clear();
+      CHECK_EQ(kp_getn(), NOKEYPRESS);
+   }
+
+   // Pairs, the later row wins and a row with two keys down is ignored
+   for(int a = 0; a < 16; a++) {
+      for(int b = a + 1; b < 16; b++) {
+         hold(a, b);
+         uint8_t key = kp_scan_raw();
+         CHECK_EQ(key, kp_old_scan());
+         CHECK_EQ(key, (a / 4 == b / 4) ? NOKEYPRESS : b);
+      }
+   }
+
+   // Port accesses of a scan
+   hold(5);
+   board.port_reads[3] = board.lat_writes[3] = 0;
+   kp_scan_raw();
+   CHECK_EQ(board.port_reads[3], 4);
+   CHECK_EQ(board.lat_writes[3], 4);
+
+   board.port_reads[3] = board.lat_writes[3] = 0;
+   kp_old_scan();
+   CHECK_EQ(board.port_reads[3], 20);
+   CHECK_EQ(board.lat_writes[3], 4);
+
+   return check_result("test_kp_scan");
+}
@@ -0,0 +1,157 @@
+// test_marquee - Bus writes of the HD44780.c marquee per scroll step
+//
+// The marquee of the POS slave (2x16 on port D) and of LCD_TEST.c (4x20
+// on port B) is written once with lcd_marquee() and moved through a
+// whole turn of the 40 character line RAM with lcd_scroll(). After every
+// step the visible lines must be the text moved by one more character,
+// and the step must cost a single instruction byte on the bus. The same
+// turn is then drawn by rewriting every visible line from the moved
+// text, as the drivers without the display shift have to, for the bytes
+// and the bus time of a step.
+
+#include "ccs.h"
+#include "check.h"
+
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 0
+#define LCD_USE_PORTD
+#define LCD_LINES  2
+#define LCD_WIDTH  16
+namespace pos {
+#include "hd44780.c"
+}
+
+#undef LCD_USE_PORTD
+#undef LCD_LINES
+#undef LCD_WIDTH
+#undef LCD_E
+#undef LCD_RS
+#undef LCD_RW
+#undef lcd_port
+#undef lcd_lat
+#undef lcd_tris
+#undef lcd_write
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 1
+namespace lcd_test {
+#include "hd44780.c"
+}
+
+#define RAM_LINE  40
+
+static const char text[] =
+   "Fresh apples, two for one until Sunday\n"
+   "Ask at the counter for the weekly offers";
+
+struct Display {
+   const char *name;
+   int program, port, lines, width;
+   void (*init)( void );
+   uint8_t (*marquee)(char *);
+   void (*scroll)( void );
+   void (*gotoxy)(uint8_t, uint8_t);
+   void (*putc)(char);
+};
+
+static const Display displays[] = {
+   { "pos_slave", 0, 3, 2, 16, pos::lcd_init, pos::lcd_marquee,
+     pos::lcd_scroll, pos::lcd_gotoxy, pos::lcd_putc },
+   { "lcd_test", 1, 1, 4, 20, lcd_test::lcd_init, lcd_test::lcd_marquee,
+     lcd_test::lcd_scroll, lcd_test::lcd_gotoxy, lcd_test::lcd_putc },
+};
+
+// Line of the line RAM as lcd_marquee() writes it, padded with spaces
+static std::string ram_line(int n) {
+   std::string s = text;
+   size_t nl = s.find('\n');
+   s = n == 0 ? s.substr(0, nl) : s.substr(nl + 1);
+   s.resize(RAM_LINE, ' ');
+   return s;
+}
+
+// Visible line y after step moves, lines 3 and 4 show the second half
+static std::string window(const Display &d, int y, int step) {
+   std::string ram = ram_line((y - 1) % 2);
+   std::string s;
+   int offset = y > 2 ? d.width : 0;
+   for(int i = 0; i < d.width; i++) {
+      s += ram[(offset + step + i) % RAM_LINE];
+   }
+   return s;
+}
+
+static bool screen_is(const Display &d, Hd44780 &lcd, int step) {
+   bool same = true;
+   for(int y = 1; y <= d.lines; y++) {
+      same &= lcd.line(y) == window(d, y, step);
+   }
+   return same;
+}
+
+static void check_display(const Display &d) {
+   Cpu board;
+   CpuScope scope(board);
+   Hd44780 lcd{d.port, d.lines, d.width};
+   char buffer[sizeof(text)];
+   uint64_t shift_bytes, rewrite_bytes;
+   SimTime start, shift_time, rewrite_time;
+   int step, y, i, mismatches = 0;
+
+   board.program = d.program;
+   board.pin_devices.push_back(&lcd);
+   d.init();
+   board.wait(10 * SIM_MS);
+
+   // Written once, then shifted a whole turn
+   memcpy(buffer, text, sizeof(text));
+   CHECK_EQ(d.marquee(buffer), RAM_LINE);
+   CHECK(screen_is(d, lcd, 0));
+   lcd.reset_counters();
+   start = board.now;
+   for(step = 1; step <= RAM_LINE; step++) {
+      d.scroll();
+      mismatches += !screen_is(d, lcd, step);
+   }
+   board.advance(std::max(board.now, lcd.busy_until));
+   shift_bytes = lcd.bytes();
+   shift_time = board.now - start;
+   CHECK_EQ(mismatches, 0);
+   CHECK_EQ(shift_bytes, RAM_LINE);
+   CHECK_EQ(lcd.instructions, RAM_LINE);
+   CHECK_EQ(lcd.busy_writes, 0);
+
+   // Every visible line rewritten on every step
+   d.putc('\f');
+   lcd.reset_counters();
+   start = board.now;
+   for(step = 1; step <= RAM_LINE; step++) {
+      for(y = 1; y <= d.lines; y++) {
+         std::string line = window(d, y, step);
+         d.gotoxy(1, y);
+         for(i = 0; i < d.width; i++) {
+            d.putc(line[i]);
+         }
+      }
+      mismatches += !screen_is(d, lcd, step);
+   }
+   board.advance(std::max(board.now, lcd.busy_until));
+   rewrite_bytes = lcd.bytes();
+   rewrite_time = board.now - start;
+   CHECK_EQ(mismatches, 0);
+   CHECK_EQ(rewrite_bytes, RAM_LINE * d.lines * (d.width + 1));
+   CHECK_EQ(lcd.busy_writes, 0);
+
+   printf("test_marquee: %-9s %dx%d, bytes per step: shift %.0f, rewrite "
+          "%.0f; bus time per step: shift %.0f us, rewrite %.0f us\n",
+          d.name, d.lines, d.width, shift_bytes / (double)RAM_LINE,
+          rewrite_bytes / (double)RAM_LINE,
+          shift_time / (double)SIM_US / RAM_LINE,
+          rewrite_time / (double)SIM_US / RAM_LINE);
+}
+
+int main( void ) {
+   for(const Display &d : displays) {
+      check_display(d);
+   }
+   return check_result("test_marquee");
+}
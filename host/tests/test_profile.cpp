@@ -0,0 +1,189 @@
+// test_profile - Probe tables of PROFILE.c read from the POS link
+//
+// The POS slave built with PROFILE (units/pos_slave_profile.cpp) runs a
+// session driven by the master functions of POS_COMMUNICATION.c, also
+// built with PROFILE: the catalog download, a saved product and a client
+// message. The master then streams its table behind MasterProfile, as
+// the '0' key of POS_MASTER.c does, and asks the slave for its own with
+// DumpProfile. Both tables are decoded from the bytes on the link, the
+// master one from a tap on its TX line.
+//
+// The counts must match the calls of the session, min <= max and the
+// totals between count * min and count * max. The master totals of
+// receive_product() and of the link waits are checked against the
+// virtual time spent in them, one tick per section.
+
+#include "ccs.h"
+#include "check.h"
+#include "pos_rig.h"
+
+#include <math.h>
+
+#define PROFILE
+namespace master {
+#include "pos_communication.c"
+}
+
+namespace pos_slave_profile {
+void program_main( void );
+}
+
+using namespace master;
+
+#define PRODUCTS  12
+#define CLOCK     5000000
+
+struct Table {
+   int probes = 0, prescale = 0;
+   uint16_t count[PROF_PROBES], min[PROF_PROBES], max[PROF_PROBES];
+   uint32_t total[PROF_PROBES];
+};
+
+// Master TX line, copied on its way to the slave
+struct Tap : UartPeer {
+   Cpu *to = nullptr;
+   std::vector<uint8_t> bytes;
+   void receive(uint8_t c, SimTime at) override {
+      bytes.push_back(c);
+      to->receive(c, at);
+   }
+};
+
+// Decodes the prof_dump() format, multi-byte values LSB first
+static size_t decode(const uint8_t *p, Table &t) {
+   const uint8_t *start = p;
+
+   t.probes = *p++;
+   t.prescale = *p++;
+   for(int i = 0; i < t.probes && i < PROF_PROBES; i++) {
+      t.count[i] = p[0] | p[1] << 8;
+      t.min[i] = p[2] | p[3] << 8;
+      t.max[i] = p[4] | p[5] << 8;
+      t.total[i] = p[6] | p[7] << 8 | p[8] << 16 | (uint32_t)p[9] << 24;
+      p += PROF_PROBE_BYTES;
+   }
+   return p - start;
+}
+
+static void check_table(const Table &t) {
+   CHECK_EQ(t.probes, PROF_PROBES);
+   CHECK_EQ(t.prescale, PROF_PRESCALE);
+   for(int i = 0; i < PROF_PROBES; i++) {
+      if(t.count[i]) {
+         CHECK(t.min[i] <= t.max[i]);
+         CHECK((uint64_t)t.total[i] >= (uint64_t)t.count[i] * t.min[i]);
+         CHECK((uint64_t)t.total[i] <= (uint64_t)t.count[i] * t.max[i]);
+      }
+   }
+}
+
+// Timer 3 ticks of a virtual time
+static double ticks(SimTime ns) {
+   return ns / 1e9 * CLOCK / 4 / PROF_PRESCALE;
+}
+
+static double mean_us(const Table &t, int probe) {
+   return t.count[probe] ? t.total[probe] * 4.0 * PROF_PRESCALE * 1e6 / CLOCK
+                           / t.count[probe] : 0;
+}
+
+int main( void ) {
+   PosSlaveRig slave;
+   Cpu board;
+   Tap tap;
+   Table mine, theirs;
+   SimTime in_receive = 0;
+   uint64_t link_reads = 0;
+
+   board.name = "master";
+   board.clock = CLOCK;
+   slave.cpu.program = 2;
+   slave.seed(PRODUCTS);
+   tap.to = &slave.cpu;
+   board.uart.peer = &tap;
+   slave.cpu.uart.peer = &board;
+
+   Sim sim(60 * SIM_SEC);
+   sim.lookahead = board.uart.byte_ns;
+   sim.add(slave.cpu, pos_slave_profile::program_main);
+   sim.add(board, [&]() {
+      Product prod;
+      SimTime start;
+      size_t dump;
+      int num, i;
+
+      prof_init();
+      delay_ms(100);
+
+      // sync_Catalog()
+      send_command(CatalogGen);
+      link_getc();
+      send_command(ProdNum);
+      num = link_getc();
+      for(i = 0; i < num; i++) {
+         delay_ms(10);
+         send_command(SendProd);
+         link_putc(i);
+         start = cpu->now;
+         CHECK(receive_product(prod));
+         in_receive += cpu->now - start;
+      }
+
+      // A saved product and a client message
+      strcpy(prod.sku, "900000");
+      strcpy(prod.name, "NEWPRODUCT");
+      prod.price = 125;
+      send_command(SaveProd);
+      CHECK(send_product(prod));
+      delay_ms(200);                // Slave shows it before reading again
+      send_command(PrintMessage);
+      ccs_printf(link_putc," %02u %s\n $  %lu.00%c%c", 1, "ITEM000001", 38, 0, 13);
+      delay_ms(200);
+      link_reads = cpu->uart.rx_bytes;
+
+      // Table of the master, read from the tap
+      dump = tap.bytes.size();
+      send_command(MasterProfile);
+      prof_dump();
+      cpu->advance(cpu->uart.tx_done);
+      CHECK_EQ(tap.bytes[dump], MasterProfile);
+      CHECK_EQ(decode(&tap.bytes[dump + 1], mine), tap.bytes.size() - dump - 1);
+
+      // Table of the slave, the MasterProfile frame was skipped
+      send_command(DumpProfile);
+      std::vector<uint8_t> bytes(2 + PROF_PROBES * PROF_PROBE_BYTES);
+      for(uint8_t &b : bytes) {
+         b = link_getc();
+      }
+      CHECK_EQ(decode(bytes.data(), theirs), bytes.size());
+      delay_ms(10);
+      CHECK(!cpu->kbhit());
+      cpu->sim->end = cpu->now;
+   });
+   sim.run();
+
+   check_table(mine);
+   check_table(theirs);
+
+   // Master: one receive_product() per product, one send_product(), a
+   // link wait per byte read before the dump
+   CHECK_EQ(mine.count[ProbeReceiveProduct], PRODUCTS);
+   CHECK_EQ(mine.count[ProbeSendProduct], 1);
+   CHECK_EQ(mine.count[ProbeLinkWait], link_reads);
+   CHECK(fabs(mine.total[ProbeReceiveProduct] - ticks(in_receive)) <= PRODUCTS);
+   CHECK_EQ(mine.count[ProbeReadProduct], 0);
+
+   // Slave: the product shown at boot and every one sent, the saved one
+   // received and shown
+   CHECK_EQ(theirs.count[ProbeReadProduct], PRODUCTS + 1);
+   CHECK_EQ(theirs.count[ProbeReceiveProduct], 1);
+   CHECK_EQ(theirs.count[ProbeSendProduct], PRODUCTS);
+   CHECK_EQ(theirs.count[ProbeLcd], 1);
+   CHECK(theirs.count[ProbeLinkWait] > 0);
+
+   printf("test_profile: master receive_product %.0f us, link wait %.0f us; "
+          "slave read_product %.0f us, lcd %.0f us\n",
+          mean_us(mine, ProbeReceiveProduct), mean_us(mine, ProbeLinkWait),
+          mean_us(theirs, ProbeReadProduct), mean_us(theirs, ProbeLcd));
+   return check_result("test_profile");
+}
@@ -0,0 +1,121 @@
+// test_settings - SETTINGS.c on the battery backed RAM of the DS1307 model
+//
+// A store is formatted on a RAM that was never written, keeps int8,
+// int16, int32 and block values across a reload, resizes a value without
+// losing the others and refuses a value that does not fit. The power is
+// then cut after every bus transaction of a save: the next load finds
+// the old or the new value, never an invalid store.
+
+#include "ccs.h"
+#include "check.h"
+
+#include "rtc_communication.c"
+#include "ds1307.c"
+#include "settings.c"
+
+#define KEY_A      1
+#define KEY_B      2
+#define KEY_TABLE  3
+
+// DS1307 that loses the power after a number of transactions
+struct CutDs1307 : Ds1307 {
+   int transactions_left = -1;     // -1 never
+
+   bool write(Cpu &c, uint8_t data) override {
+      return transactions_left == 0 ? true : Ds1307::write(c, data);
+   }
+   void stop(Cpu &c) override {
+      Ds1307::stop(c);
+      if(transactions_left > 0) {
+         transactions_left--;
+      }
+   }
+};
+
+static Cpu board;
+static CutDs1307 rtc;
+
+// Power up: the RAM copy is lost, the DS1307 RAM is kept
+static bool reload( void ) {
+   memset(settings, 0, sizeof(settings));
+   return settings_load();
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   BYTE a = 0x5A, a_read = 0;
+   uint16_t b = 0x1234, b_read = 0;
+   uint32_t c = 0xDEADBEEF;
+   BYTE table[40], table_read[40];
+   int i;
+
+   board.i2c.devices.push_back(&rtc);
+   for(i = 0; i < 40; i++) {
+      table[i] = i * 7;
+   }
+
+   // Never written
+   CHECK(!reload());
+   CHECK_EQ(rtc.nvram[1], SETTINGS_MAGIC);
+   CHECK(reload());
+   CHECK(!settings_get8(KEY_A, a_read));
+
+   // Values survive a reload
+   CHECK(settings_set8(KEY_A, a));
+   CHECK(settings_set16(KEY_B, b));
+   CHECK(settings_set(KEY_TABLE, table, 40));
+   CHECK(reload());
+   CHECK(settings_get8(KEY_A, a_read));
+   CHECK(settings_get16(KEY_B, b_read));
+   CHECK(settings_get(KEY_TABLE, table_read, 40));
+   CHECK_EQ(a_read, a);
+   CHECK_EQ(b_read, b);
+   CHECK(!memcmp(table, table_read, 40));
+   CHECK(!settings_get(KEY_TABLE, table_read, 39));
+
+   // The time registers are left alone
+   CHECK_EQ(rtc.seconds(board.now), 0);
+   CHECK(!rtc.halted);
+
+   // An unchanged value is not written
+   uint64_t writes = rtc.nvram_writes;
+   CHECK(settings_set(KEY_TABLE, table, 40));
+   CHECK_EQ(rtc.nvram_writes, writes);
+
+   // B grows to 32 bits and moves after the table
+   CHECK(settings_set32(KEY_B, c));
+   CHECK(reload());
+   CHECK(!settings_get16(KEY_B, b_read));
+   uint32_t c_read = 0;
+   CHECK(settings_get32(KEY_B, c_read));
+   CHECK_EQ(c_read, c);
+   CHECK(settings_get8(KEY_A, a_read));
+   CHECK(settings_get(KEY_TABLE, table_read, 40));
+   CHECK(!memcmp(table, table_read, 40));
+
+   // 3 + 6 + 42 bytes used, 2 + 3 more do not fit
+   CHECK(!settings_set16(4, b));
+   CHECK(reload());
+   CHECK(settings_get32(KEY_B, c_read));
+
+   // Power cut after every transaction of a save
+   for(int cut = 0; cut < 4; cut++) {
+      table[0] ^= 0xFF;
+      table[39] ^= 0xFF;
+      rtc.transactions_left = cut;
+      settings_set(KEY_TABLE, table, 40);
+      rtc.transactions_left = -1;
+
+      CHECK(reload());
+      CHECK(settings_get(KEY_TABLE, table_read, 40));
+      CHECK_EQ(table_read[0], table_read[39] == table[39] ? table[0] :
+                                                             table[0] ^ 0xFF);
+      CHECK(settings_get32(KEY_B, c_read));
+      CHECK_EQ(c_read, c);
+
+      // Back to what the RAM holds
+      memcpy(table, table_read, 40);
+   }
+
+   return check_result("test_settings");
+}
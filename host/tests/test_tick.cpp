@@ -0,0 +1,178 @@
+// test_tick - Reload values, tick count and drift measure of TICK.c
+//
+// TICK.c is built for the 5 MHz clock of the boards, 20 and 48 MHz on
+// Timer 1 with TICK_DRIFT, and for 5 MHz on Timer 0 as TIMER 0/TMR0.c
+// uses it. The
+// prescaler and period must give exactly 10 ms with the smallest
+// prescaler that fits, and Timer 1 or Timer 0 must be set up with them.
+// Each build then runs 10 minutes with a skewed crystal: the ticks
+// counted must match the crystal, the cascaded counters the ticks, and
+// tick_drift_ppm() the skew against the DS1307 square wave on CCP2.
+
+#include "ccs.h"
+#include "check.h"
+
+#include <math.h>
+
+#define RUN     (600 * SIM_SEC)
+#define RTC_PPM 20
+
+// A build of TICK.c, its settings copied before the next one
+#define TICK_BUILD_END() \
+   const uint32_t clock = HOST_CLOCK; \
+   const uint32_t period = TICK_PERIOD; \
+   const uint32_t div = TICK_DIV; \
+   const int vector = TICK_INT; \
+   const int program = HOST_PROGRAM;
+
+#undef HOST_CLOCK
+#define HOST_CLOCK 5000000
+#define TICK_DRIFT
+namespace t1_5 {
+#include "tick.c"
+TICK_BUILD_END()
+}
+#undef TICK_DIV
+#undef TICK_T1_DIV
+#undef TICK_T0_DIV
+#undef TICK_PERIOD
+#undef TICK_CYCLES
+#undef TICK_INT
+
+#undef HOST_CLOCK
+#define HOST_CLOCK 20000000
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 1
+namespace t1_20 {
+#include "tick.c"
+TICK_BUILD_END()
+}
+#undef TICK_DIV
+#undef TICK_T1_DIV
+#undef TICK_T0_DIV
+#undef TICK_PERIOD
+#undef TICK_CYCLES
+#undef TICK_INT
+
+#undef HOST_CLOCK
+#define HOST_CLOCK 48000000
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 2
+namespace t1_48 {
+#include "tick.c"
+TICK_BUILD_END()
+}
+#undef TICK_DIV
+#undef TICK_T1_DIV
+#undef TICK_T0_DIV
+#undef TICK_PERIOD
+#undef TICK_CYCLES
+#undef TICK_INT
+
+#undef HOST_CLOCK
+#define HOST_CLOCK 5000000
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 3
+#undef TICK_DRIFT
+#define TICK_TIMER0
+namespace t0_5 {
+#include "tick.c"
+TICK_BUILD_END()
+}
+
+struct Build {
+   const char *name;
+   uint32_t clock, period, div;
+   int vector, program;
+   bool timer0;
+   void (*init)( void );
+   uint8_t *cs, *sec, *sec10, *min;
+   int32_t (*drift_ppm)( void );
+};
+
+#define BUILD(ns, t0, ppm) \
+   { #ns, ns::clock, ns::period, ns::div, ns::vector, ns::program, t0, \
+     ns::tick_init, &ns::tick_cs, &ns::tick_sec, &ns::tick_sec10, \
+     &ns::tick_min, ppm }
+
+static const Build builds[] = {
+   BUILD(t1_5, false, t1_5::tick_drift_ppm),
+   BUILD(t1_20, false, t1_20::tick_drift_ppm),
+   BUILD(t1_48, false, t1_48::tick_drift_ppm),
+   BUILD(t0_5, true, nullptr),
+};
+
+// Prescaler and period of a clock, worked out again
+static void check_reload(const Build &b) {
+   uint32_t counts = b.clock / 4 / 100;
+
+   CHECK_EQ(b.period * b.div, counts);
+   CHECK(b.period <= 65536);
+   CHECK(b.div == 1 || b.period * 2 > 65536);
+   CHECK(b.div == 1 || b.div == 2 || b.div == 4 || b.div == 8);
+   CHECK_EQ(b.vector, b.timer0 ? INT_TIMER0 : INT_CCP1);
+}
+
+// Runs a build with its crystal off by ppm
+static void check_run(const Build &b, double ppm) {
+   Cpu board;
+   CpuScope scope(board);
+   Ds1307 rtc;
+   uint64_t expected, ticks, elapsed;
+
+   board.program = b.program;
+   board.clock = (uint32_t)llround(b.clock * (1 + ppm * 1e-6));
+   rtc.ppm = RTC_PPM;
+   rtc.control = 0x10;
+   rtc.sqw = &board;
+   rtc.sqw_on_ccp2 = true;
+   rtc.start_sqw(board);
+
+   b.init();
+   CHECK(board.gie);
+   if(b.timer0) {
+      CHECK_EQ(board.t0_div, b.div);
+      CHECK(!board.t0_8bit);
+      CHECK_EQ(board.timer0(), (uint16_t)(0 - b.period));
+   } else {
+      CHECK_EQ(board.t1_div, b.div);
+      CHECK(board.ccp1_reset);
+      CHECK_EQ(board.ccp1, b.period - 1);
+   }
+
+   board.wait(RUN);
+
+   // Timer 0 also stops for the two cycles of every reload
+   ticks = board.isr_calls[b.vector];
+   elapsed = RUN * (board.clock / 4) / SIM_SEC;
+   expected = elapsed / (b.period * b.div + (b.timer0 ? 2 : 0));
+   CHECK(ticks >= expected - 1 && ticks <= expected + 1);
+   CHECK_EQ(*b.cs, ticks % 100);
+   CHECK_EQ(*b.sec, ticks / 100 % 10);
+   CHECK_EQ(*b.sec10, ticks / 1000 % 6);
+   CHECK_EQ(*b.min, ticks / 6000 % 60);
+
+   printf("test_tick: %-6s period %5u, prescaler 1:%u, %llu ticks in %llu s",
+          b.name, b.period, b.div, (unsigned long long)ticks,
+          (unsigned long long)(RUN / SIM_SEC));
+   if(b.drift_ppm) {
+      // Tick against the reference, both crystals off
+      double real = ((1 + ppm * 1e-6) / (1 + RTC_PPM * 1e-6) - 1) * 1e6;
+      int32_t measured = b.drift_ppm();
+      CHECK(fabs(measured - real) <= 1);
+      printf(", drift %d ppm (real %.1f)", measured, real);
+   } else {
+      printf(", reload stops %.0f ppm", 2e6 / (b.period * b.div));
+   }
+   printf("\n");
+}
+
+int main( void ) {
+   const double skews[] = { 100, -150, 0, 0 };
+
+   for(int i = 0; i < 4; i++) {
+      check_reload(builds[i]);
+      check_run(builds[i], skews[i]);
+   }
+   return check_result("test_tick");
+}
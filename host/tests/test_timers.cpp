@@ -0,0 +1,98 @@
+// test_timers - Timer wheel of TIMERS.c with 3000 timers
+//
+// 3000 timers, above the 254 of an int8 id, on a wheel of 512 slots.
+// Every timer starts with a random delay and period, one shot or
+// periodic, and every tick a few random ones are restarted or stopped.
+// After every tick the expired flag and the running state of each timer
+// are compared with a model that keeps the absolute tick each one is
+// due on.
+
+#include "ccs.h"
+#include "check.h"
+
+#define TIMER_COUNT  3000
+#define TIMER_SLOTS  512
+#include "timers.c"
+
+#define TICKS        20000
+#define MAX_DELAY    1500    // Up to three turns of the wheel
+
+struct Model {
+   bool running, fired;
+   uint32_t due;
+   uint16_t period;
+};
+
+static Cpu board;
+static Model model[TIMER_COUNT];
+static uint32_t now;
+static uint32_t seed = 7;
+
+static uint32_t random_below(uint32_t n) {
+   seed = seed * 1103515245 + 12345;
+   return (seed >> 8) % n;
+}
+
+static void start(TimerId id) {
+   uint16_t ticks = 1 + random_below(MAX_DELAY);
+   uint16_t period = random_below(2) ? 0 : 1 + random_below(MAX_DELAY);
+
+   timer_start(id, ticks, period);
+   model[id] = { true, false, now + ticks, period };
+}
+
+static void stop(TimerId id) {
+   timer_stop(id);
+   model[id].running = model[id].fired = false;
+}
+
+int main( void ) {
+   CpuScope scope(board);
+   uint64_t expiries = 0, mismatches = 0;
+   uint32_t i;
+
+   CHECK_EQ(sizeof(TimerId), 2);
+   CHECK_EQ(sizeof(TimerSlot), 2);
+
+   board.gie = true;
+   timer_init();
+   for(i = 0; i < TIMER_COUNT; i++) {
+      start(i);
+   }
+
+   for(now = 1; now <= TICKS; now++) {
+      timer_tick();
+      for(i = 0; i < TIMER_COUNT; i++) {
+         Model &m = model[i];
+         if(m.running && m.due == now) {
+            m.fired = true;
+            if(m.period) {
+               m.due += m.period;
+            } else {
+               m.running = false;
+            }
+         }
+      }
+
+      for(i = 0; i < TIMER_COUNT; i++) {
+         bool fired = timer_expired(i);
+         mismatches += fired != model[i].fired;
+         mismatches += timer_running(i) != model[i].running;
+         expiries += fired;
+         model[i].fired = false;
+      }
+
+      for(i = 0; i < 5; i++) {
+         start(random_below(TIMER_COUNT));
+      }
+      for(i = 0; i < 3; i++) {
+         stop(random_below(TIMER_COUNT));
+      }
+   }
+
+   CHECK_EQ(mismatches, 0);
+   CHECK(board.gie);
+   printf("test_timers: %llu expiries of %d timers in %d ticks\n",
+          (unsigned long long)expiries, TIMER_COUNT, TICKS);
+   return check_result("test_timers");
+}
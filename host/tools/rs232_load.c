@@ -0,0 +1,427 @@
+/* rs232_load - Load generator of the framed protocol of RS232/RS232.c
+ *
+ *    rs232_load DEVICE [SECONDS]
+ *    rs232_load --pty [SECONDS]
+ *
+ * Sends commands to the bridge for SECONDS (10 by default), each one
+ * waiting for its CmdAck, and prints the command throughput and the round
+ * trip latency from the first byte sent to the last byte of the
+ * acknowledge. A round is CmdSetLed, CmdSetRelay, CmdPulseRelay,
+ * CmdReadState and a CmdBatch of CmdSetLed, CmdSetRelay and CmdReadState;
+ * every CmdState must hold the color and relay set before it. CmdKeyEvent
+ * frames sent by the board are counted and skipped.
+ *
+ * DEVICE is the serial port of a board (9600 8N1). With --pty the load
+ * goes through a pseudo terminal to a stand-in of the bridge forked on
+ * its other end, which answers as RS232.c does and paces every byte at
+ * 9600 baud in both directions, so the numbers can be compared with a
+ * board when none is connected.
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Frames and commands of RS232.c */
+#define STX              0x02
+#define FRAME_MAX        16
+#define CMD_SET_LED      0x10
+#define CMD_SET_RELAY    0x11
+#define CMD_PULSE_RELAY  0x12
+#define CMD_READ_STATE   0x13
+#define CMD_BATCH        0x14
+#define CMD_KEY_EVENT    0x15
+#define CMD_STATE        0x20
+#define CMD_ACK          0x21
+#define ACK_OK           0
+#define ACK_CHECKSUM     1
+#define ACK_UNKNOWN      2
+#define ACK_LENGTH       3
+
+#define BYTE_NS          1041667   /* 10 bits at 9600 baud */
+#define MAX_SAMPLES      100000
+
+static int fd;
+
+static long long now_ns(void) {
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void sleep_until(long long ns) {
+   struct timespec t;
+   t.tv_sec = ns / 1000000000LL;
+   t.tv_nsec = ns % 1000000000LL;
+   while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR)
+      ;
+}
+
+static int raw_link(int f) {
+   struct termios tio;
+
+   if(tcgetattr(f, &tio) < 0) {
+      return -1;
+   }
+   cfmakeraw(&tio);
+   cfsetispeed(&tio, B9600);
+   cfsetospeed(&tio, B9600);
+   tio.c_cflag |= CLOCAL | CREAD;
+   tio.c_cflag &= ~(CSTOPB | PARENB);
+   tio.c_cc[VMIN] = 0;
+   tio.c_cc[VTIME] = 10;      /* read() gives up after 1 s */
+   tcflush(f, TCIOFLUSH);
+   return tcsetattr(f, TCSANOW, &tio);
+}
+
+static int open_link(const char *device) {
+   fd = open(device, O_RDWR | O_NOCTTY);
+   return fd < 0 ? -1 : raw_link(fd);
+}
+
+/* Next byte of the link, -1 after 1 s of silence */
+static int link_getc(void) {
+   unsigned char c;
+   return read(fd, &c, 1) == 1 ? c : -1;
+}
+
+/* Builds a frame in out, returns its length */
+static int frame(unsigned char *out, const unsigned char *body, int len) {
+   unsigned char sum = len;
+   int i;
+
+   out[0] = STX;
+   out[1] = len;
+   for(i = 0; i < len; i++) {
+      out[2 + i] = body[i];
+      sum += body[i];
+   }
+   out[2 + len] = -sum;
+   return len + 3;
+}
+
+/* Reads the next frame into body, returns its length or -1 */
+static int read_frame(unsigned char *body) {
+   unsigned char sum;
+   int c, len, i;
+
+   do {
+      if((c = link_getc()) < 0) {
+         return -1;
+      }
+   } while(c != STX);
+   if((len = link_getc()) <= 0 || len > FRAME_MAX) {
+      return -1;
+   }
+   sum = len;
+   for(i = 0; i < len; i++) {
+      if((c = link_getc()) < 0) {
+         return -1;
+      }
+      body[i] = c;
+      sum += c;
+   }
+   if((c = link_getc()) < 0 || (unsigned char)(sum + c) != 0) {
+      return -1;
+   }
+   return len;
+}
+
+/*******          Stand-in of the bridge         *******/
+
+/* Sends a frame a byte at a time at the speed of the wire */
+static void standin_send(int f, long long *tx_done, unsigned char cmd,
+                         const unsigned char *data, int len) {
+   unsigned char body[FRAME_MAX], out[FRAME_MAX + 3];
+   int n, i;
+
+   body[0] = cmd;
+   memcpy(body + 1, data, len);
+   n = frame(out, body, len + 1);
+   for(i = 0; i < n; i++) {
+      long long t = now_ns();
+      *tx_done = (*tx_done > t ? *tx_done : t) + BYTE_NS;
+      sleep_until(*tx_done);
+      if(write(f, &out[i], 1) != 1) {
+         exit(0);
+      }
+   }
+}
+
+/* Runs one command as run_command() of RS232.c, returns its length or
+ * -1 with the acknowledge status in *status */
+static int standin_command(int f, long long *tx_done, unsigned char *state,
+                           const unsigned char *cmd, int len, int *status) {
+   int need;
+
+   switch(cmd[0]) {
+      case CMD_SET_LED:
+      case CMD_SET_RELAY:
+      case CMD_PULSE_RELAY:  need = 2; break;
+      case CMD_READ_STATE:   need = 1; break;
+      case CMD_KEY_EVENT:    need = 4; break;
+      default:
+         *status = ACK_UNKNOWN;
+         return -1;
+   }
+   if(len < need) {
+      *status = ACK_LENGTH;
+      return -1;
+   }
+   if(cmd[0] == CMD_SET_LED) {
+      state[0] = cmd[1] & 0x07;
+   } else if(cmd[0] == CMD_SET_RELAY) {
+      state[1] = cmd[1] != 0;
+   } else if(cmd[0] == CMD_PULSE_RELAY) {
+      state[1] = 1;
+   } else if(cmd[0] == CMD_KEY_EVENT) {
+      if(cmd[1] < 8) {
+         state[0] = cmd[1];
+      } else if(cmd[1] == 0xA) {
+         state[1] = !state[1];
+      }
+   } else {
+      standin_send(f, tx_done, CMD_STATE, state, 2);
+   }
+   return need;
+}
+
+static void standin(int f) {
+   unsigned char body[FRAME_MAX], state[2] = { 0, 0 }, c;
+   unsigned char status;
+   long long arrival = 0, tx_done = 0;
+   int len, pos, used, st;
+
+   for(;;) {
+      /* Frames as receive_frame() builds them, each byte once it would
+       * have crossed the wire */
+      int got = 0;
+      unsigned char sum = 0;
+
+      len = pos = 0;
+      while(got >= 0) {
+         long long t;
+         if(read(f, &c, 1) != 1) {
+            exit(0);
+         }
+         t = now_ns();
+         arrival = (arrival > t ? arrival : t) + BYTE_NS;
+         sleep_until(arrival);
+
+         if(got == 0) {
+            got = c == STX;
+         } else if(got == 1) {
+            if(c == 0 || c > FRAME_MAX) {
+               status = ACK_LENGTH;
+               standin_send(f, &tx_done, CMD_ACK, &status, 1);
+               got = 0;
+               continue;
+            }
+            len = c;
+            sum = c;
+            got = 2;
+         } else if(pos < len) {
+            body[pos++] = c;
+            sum += c;
+         } else {
+            sum += c;
+            got = -1;
+         }
+      }
+      if(body[0] == CMD_ACK || body[0] == CMD_STATE) {
+         continue;
+      }
+
+      st = ACK_OK;
+      if(sum != 0) {
+         st = ACK_CHECKSUM;
+      } else if(body[0] != CMD_BATCH) {
+         used = standin_command(f, &tx_done, state, body, len, &st);
+         if(used >= 0 && used != len) {
+            st = ACK_LENGTH;
+         }
+      } else {
+         for(pos = 1; pos < len && st == ACK_OK; pos += used) {
+            used = standin_command(f, &tx_done, state, body + pos, len - pos,
+                                   &st);
+         }
+      }
+      status = st;
+      standin_send(f, &tx_done, CMD_ACK, &status, 1);
+   }
+}
+
+/* Forks the stand-in on a pseudo terminal, returns the name of its
+ * terminal side */
+static const char *open_standin(pid_t *pid) {
+   struct termios tio;
+   int master = posix_openpt(O_RDWR | O_NOCTTY);
+   const char *name;
+
+   if(master < 0 || grantpt(master) < 0 || unlockpt(master) < 0 ||
+      (name = ptsname(master)) == NULL) {
+      return NULL;
+   }
+   if(tcgetattr(master, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(master, TCSANOW, &tio);
+   }
+   if((*pid = fork()) == 0) {
+      standin(master);
+   }
+   return name;
+}
+
+/*******              Load generator             *******/
+
+static long long samples[MAX_SAMPLES];
+static int count;
+static long commands, errors, key_events;
+static unsigned char color, relay;
+
+/* Sends a frame and waits for its CmdAck, checking the CmdState frames
+ * before it */
+static void transact(const unsigned char *body, int len, int n_commands) {
+   unsigned char out[FRAME_MAX + 3], in[FRAME_MAX];
+   long long start;
+   int n, m;
+
+   n = frame(out, body, len);
+   start = now_ns();
+   if(write(fd, out, n) != n) {
+      errors++;
+      return;
+   }
+   for(;;) {
+      if((m = read_frame(in)) < 0) {
+         errors++;
+         return;
+      }
+      if(in[0] == CMD_KEY_EVENT) {
+         key_events++;
+      } else if(in[0] == CMD_STATE) {
+         if(m != 3 || in[1] != color || in[2] != relay) {
+            errors++;
+         }
+      } else if(in[0] == CMD_ACK) {
+         break;
+      }
+   }
+   if(m != 2 || in[1] != ACK_OK) {
+      errors++;
+      return;
+   }
+   if(count < MAX_SAMPLES) {
+      samples[count++] = now_ns() - start;
+   }
+   commands += n_commands;
+}
+
+static void round_of_commands(void) {
+   unsigned char body[FRAME_MAX];
+
+   color = (color + 1) & 0x07;
+   body[0] = CMD_SET_LED;
+   body[1] = color;
+   transact(body, 2, 1);
+
+   relay = !relay;
+   body[0] = CMD_SET_RELAY;
+   body[1] = relay;
+   transact(body, 2, 1);
+
+   /* 0.5 s, set again by the next round before it ends */
+   body[0] = CMD_PULSE_RELAY;
+   body[1] = 50;
+   transact(body, 2, 1);
+   relay = 1;
+
+   body[0] = CMD_READ_STATE;
+   transact(body, 1, 1);
+
+   color = (color + 1) & 0x07;
+   relay = 0;
+   body[0] = CMD_BATCH;
+   body[1] = CMD_SET_LED;
+   body[2] = color;
+   body[3] = CMD_SET_RELAY;
+   body[4] = relay;
+   body[5] = CMD_READ_STATE;
+   transact(body, 6, 3);
+}
+
+static int compare(const void *a, const void *b) {
+   long long x = *(const long long *)a, y = *(const long long *)b;
+   return x < y ? -1 : x > y;
+}
+
+static double percentile(double p) {
+   int i = (int)(p * (count - 1) + 0.5);
+   return samples[i] / 1000.0;
+}
+
+static void usage(void) {
+   fprintf(stderr, "usage: rs232_load DEVICE [SECONDS]\n"
+                   "       rs232_load --pty [SECONDS]\n");
+   exit(2);
+}
+
+int main(int argc, char **argv) {
+   const char *device = argv[1];
+   pid_t pid = 0;
+   long long start, end;
+   double seconds = 10, elapsed;
+   long frames;
+
+   if(argc < 2 || argc > 3) {
+      usage();
+   }
+   if(argc == 3 && (seconds = atof(argv[2])) <= 0) {
+      usage();
+   }
+   if(!strcmp(device, "--pty") && (device = open_standin(&pid)) == NULL) {
+      fprintf(stderr, "rs232_load: no pseudo terminal: %s\n", strerror(errno));
+      return 1;
+   }
+   if(open_link(device) < 0) {
+      fprintf(stderr, "rs232_load: %s: %s\n", device, strerror(errno));
+      return 1;
+   }
+
+   start = now_ns();
+   end = start + (long long)(seconds * 1e9);
+   while(now_ns() < end && errors == 0) {
+      round_of_commands();
+   }
+   elapsed = (now_ns() - start) / 1e9;
+   frames = count;
+
+   if(pid > 0) {
+      kill(pid, SIGTERM);
+      waitpid(pid, NULL, 0);
+   }
+   if(count == 0) {
+      fprintf(stderr, "rs232_load: no answer from the bridge\n");
+      return 1;
+   }
+
+   qsort(samples, count, sizeof(samples[0]), compare);
+   printf("%ld commands in %ld frames, %.1f s\n", commands, frames, elapsed);
+   printf("throughput   %.1f commands/s, %.1f frames/s\n",
+          commands / elapsed, frames / elapsed);
+   printf("round trip   p50 %.0f us, p90 %.0f us, p99 %.0f us, max %.0f us\n",
+          percentile(0.5), percentile(0.9), percentile(0.99),
+          percentile(1.0));
+   printf("errors       %ld, key events %ld\n", errors, key_events);
+   return errors ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/* rtc_alarm - Lists and edits the alarm table of the RTC slave
+ *
+ *    rtc_alarm DEVICE list
+ *    rtc_alarm DEVICE set INDEX HH:MM:SS DURATION DAYS
+ *    rtc_alarm DEVICE clear INDEX
+ *
+ * Takes the place of the master on the link (9600 8N1, see
+ * RTC_COMMUNICATION.c). list sends PushAll and prints the AlarmEntryEvent
+ * frames pushed back; set and clear send ReceiveAlarmEntry and wait for
+ * the acknowledge and the entry echoed by the slave. DAYS is the bit mask
+ * of the days the alarm rings, bit 0 Sunday, as 127 or 0x7F.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Commands and pushed frames of RTC_COMMUNICATION.c */
+#define PUSH_ALL            9
+#define RECEIVE_ALARM_ENTRY 12
+#define TIME_EVENT          0x80
+#define DATE_EVENT          0x81
+#define ALARM_EVENT         0x82
+#define ALARM_ENTRY_EVENT   0x83
+#define ALARM_EMPTY         0xFF
+
+static int fd;
+
+static int open_link(const char *device) {
+   struct termios tio;
+
+   fd = open(device, O_RDWR | O_NOCTTY);
+   if(fd < 0 || tcgetattr(fd, &tio) < 0) {
+      return -1;
+   }
+   cfmakeraw(&tio);
+   cfsetispeed(&tio, B9600);
+   cfsetospeed(&tio, B9600);
+   tio.c_cflag |= CLOCAL | CREAD;
+   tio.c_cflag &= ~(CSTOPB | PARENB);
+   tio.c_cc[VMIN] = 0;
+   tio.c_cc[VTIME] = 10;      /* read() gives up after 1 s */
+   tcflush(fd, TCIOFLUSH);
+   return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/* Next byte of the link, -1 after 1 s of silence */
+static int link_getc(void) {
+   unsigned char c;
+   return read(fd, &c, 1) == 1 ? c : -1;
+}
+
+static int link_write(const unsigned char *data, int len) {
+   return write(fd, data, len) == len ? 0 : -1;
+}
+
+/* Reads the rest of a frame started by a pushed event byte. Returns the
+ * event, or -1 if the frame was cut short. */
+static int read_push(int event, unsigned char *frame) {
+   int len = 0, c, i;
+
+   switch(event) {
+      case TIME_EVENT:        len = 3; break;
+      case DATE_EVENT:        len = 4; break;
+      case ALARM_EVENT:       len = 3; break;
+      case ALARM_ENTRY_EVENT: len = 6; break;
+   }
+   for(i = 0; i < len; i++) {
+      if((c = link_getc()) < 0) {
+         return -1;
+      }
+      frame[i] = c;
+   }
+   return event;
+}
+
+static void print_entry(const unsigned char *frame) {
+   static const char days[] = "SMTWTFS";
+   int i;
+
+   printf("%2u  ", frame[0]);
+   if(frame[1] == ALARM_EMPTY) {
+      printf("empty\n");
+      return;
+   }
+   printf("%02u:%02u:%02u  %3us  ", frame[1], frame[2], frame[3], frame[4]);
+   for(i = 0; i < 7; i++) {
+      putchar((frame[5] >> i) & 1 ? days[i] : '-');
+   }
+   printf("  0x%02X\n", frame[5]);
+}
+
+static int list(void) {
+   unsigned char cmd = PUSH_ALL, frame[6];
+   int c, entries = 0;
+
+   if(link_write(&cmd, 1) < 0) {
+      return -1;
+   }
+   /* The table is pushed last, the link goes quiet after it */
+   while((c = link_getc()) >= 0) {
+      if(c >= TIME_EVENT && read_push(c, frame) == ALARM_ENTRY_EVENT) {
+         print_entry(frame);
+         entries++;
+      }
+   }
+   return entries ? 0 : -1;
+}
+
+static int set(unsigned char *entry) {
+   unsigned char cmd[7], frame[6];
+   int c, acked = 0;
+
+   cmd[0] = RECEIVE_ALARM_ENTRY;
+   memcpy(cmd + 1, entry, 6);
+   if(link_write(cmd, 7) < 0) {
+      return -1;
+   }
+   while((c = link_getc()) >= 0) {
+      if(c < TIME_EVENT) {
+         acked = 1;
+      } else if(read_push(c, frame) == ALARM_ENTRY_EVENT && acked &&
+                frame[0] == entry[0]) {
+         print_entry(frame);
+         return memcmp(frame, entry, 6) ? -1 : 0;
+      }
+   }
+   return -1;
+}
+
+static void usage(void) {
+   fprintf(stderr, "usage: rtc_alarm DEVICE list\n"
+                   "       rtc_alarm DEVICE set INDEX HH:MM:SS DURATION DAYS\n"
+                   "       rtc_alarm DEVICE clear INDEX\n");
+   exit(2);
+}
+
+int main(int argc, char **argv) {
+   unsigned char entry[6];
+   unsigned h, m, s;
+   int result;
+
+   if(argc < 3) {
+      usage();
+   }
+   if(open_link(argv[1]) < 0) {
+      fprintf(stderr, "rtc_alarm: %s: %s\n", argv[1], strerror(errno));
+      return 1;
+   }
+
+   if(!strcmp(argv[2], "list") && argc == 3) {
+      result = list();
+   } else if(!strcmp(argv[2], "set") && argc == 7) {
+      if(sscanf(argv[4], "%u:%u:%u", &h, &m, &s) != 3 ||
+         h > 23 || m > 59 || s > 59) {
+         usage();
+      }
+      entry[0] = strtoul(argv[3], NULL, 0);
+      entry[1] = h;
+      entry[2] = m;
+      entry[3] = s;
+      entry[4] = strtoul(argv[5], NULL, 0);
+      entry[5] = strtoul(argv[6], NULL, 0) & 0x7F;
+      result = set(entry);
+   } else if(!strcmp(argv[2], "clear") && argc == 4) {
+      memset(entry, 0, sizeof(entry));
+      entry[0] = strtoul(argv[3], NULL, 0);
+      entry[1] = ALARM_EMPTY;
+      result = set(entry);
+   } else {
+      usage();
+   }
+
+   if(result < 0) {
+      fprintf(stderr, "rtc_alarm: no answer from the slave\n");
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,8 @@
+// KP4X4 without KP_ISR, the polled scanner the interrupt one replaced
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 1
+
+namespace kp_polled {
+#include "kp4x4.c"
+}
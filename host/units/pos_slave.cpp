@@ -0,0 +1,8 @@
+// POS slave, for the benchmarks that drive it as the master
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 1
+
+namespace pos_slave {
+#include "pos_slave.c"
+}
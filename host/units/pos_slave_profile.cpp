@@ -0,0 +1,9 @@
+// POS slave built with PROFILE, for the test that reads its probe table
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 2
+
+#define PROFILE
+namespace pos_slave_profile {
+#include "pos_slave.c"
+}
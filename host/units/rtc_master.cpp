@@ -0,0 +1,8 @@
+// RTC master, for the benchmarks that run it next to the slave
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 0
+
+namespace rtc_master {
+#include "rtc_master.c"
+}
@@ -0,0 +1,8 @@
+// RTC master of the base revision (gen-base), polling the slave
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 2
+
+namespace rtc_master_base {
+#include "../gen-base/rtc_master.c"
+}
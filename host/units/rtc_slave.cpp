@@ -0,0 +1,8 @@
+// RTC slave, for the benchmarks that run it next to the master
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 1
+
+namespace rtc_slave {
+#include "rtc_slave.c"
+}
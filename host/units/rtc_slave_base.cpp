@@ -0,0 +1,8 @@
+// RTC slave of the base revision (gen-base), answering the polls
+#include "ccs.h"
+#undef HOST_PROGRAM
+#define HOST_PROGRAM 3
+
+namespace rtc_slave_base {
+#include "../gen-base/rtc_slave.c"
+}